@@ -0,0 +1,106 @@
+//
+// OMDeferredStream.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "OMStream.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** An OMDeferredStream controls the values produced by an aligned OMStream, similar
+ to the way an OMDeferred controls its promise.
+
+ Values are pushed one by one, followed by a final call to either complete or fail:.
+ A value is accepted only if the consumer requested it, or if there is room left in
+ the buffer of the stream. Register a block using requested: to get notified once
+ the consumer signals further demand, and to continue producing by then.
+ */
+@interface OMDeferredStream<ValueType> : NSObject
+
+///---------------------------------------------------------------------------------------
+/// @name Creation
+///---------------------------------------------------------------------------------------
+
+/** Create a deferred stream buffering a limited number of values.
+
+ @param capacity Maximum number of values kept ahead of the demand of the consumer.
+ @return A new deferred stream.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER;
+
+/** Create a deferred stream buffering up to 16 values.
+ */
+- (instancetype)init;
+
+///---------------------------------------------------------------------------------------
+/// @name Accessing the underlying stream
+///---------------------------------------------------------------------------------------
+
+/** Returns the associated stream.
+ */
+@property(readonly, nonatomic) OMStream<ValueType> *stream;
+
+/** The number of values accepted right now, either requested by the consumer or
+ fitting into the buffer.
+ */
+@property(readonly, nonatomic) NSUInteger demand;
+
+///---------------------------------------------------------------------------------------
+/// @name Producing values
+///---------------------------------------------------------------------------------------
+
+/** Push the next value.
+
+ @param value The value to deliver.
+ @return Whether the value got accepted, NO if the buffer is full or the stream
+         has been terminated already.
+ */
+- (BOOL)push:(nullable ValueType)value;
+
+/** Terminate the stream regularly, once the buffered values got delivered.
+ */
+- (void)complete;
+
+/** Terminate the stream due to a failure, dropping buffered values.
+
+ @param error Reason why the stream failed.
+ */
+- (void)fail:(nullable NSError *)error;
+
+/** Add a handler to be called whenever the consumer requests further values.
+
+ @param requestHandler The block to call with the number of requested values.
+ */
+- (void)requested:(void (^)(NSUInteger count))requestHandler;
+
+/** Add a handler to be called once the consumer cancelled the stream.
+
+ @param cancelHandler The block to call.
+ */
+- (void)cancelled:(void (^)(void))cancelHandler;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,76 @@
+//
+// OMDeferredStream.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMDeferredStream.h"
+
+#import "OMStream+Internal.h"
+
+/** Number of values buffered by default.
+ */
+static const NSUInteger kDefaultStreamCapacity = 16;
+
+@implementation OMDeferredStream
+
+#pragma mark - Init
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _stream = [[OMStream alloc] initWithCapacity:capacity];
+    }
+    return self;
+}
+
+- (instancetype)init {
+    return [self initWithCapacity:kDefaultStreamCapacity];
+}
+
+#pragma mark - Public Methods
+
+- (NSUInteger)demand {
+    return self.stream.demand;
+}
+
+- (BOOL)push:(id)value {
+    return [self.stream push:value];
+}
+
+- (void)complete {
+    [self.stream complete];
+}
+
+- (void)fail:(NSError *)error {
+    [self.stream fail:error];
+}
+
+- (void)requested:(void (^)(NSUInteger count))requestHandler {
+    [self.stream requested:requestHandler];
+}
+
+- (void)cancelled:(void (^)(void))cancelHandler {
+    [self.stream cancelled:cancelHandler];
+}
+
+@end
@@ -0,0 +1,47 @@
+//
+// OMExecutor.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** Runs work on behalf of a dispatch queue.
+
+ An executor is plugged in everywhere a dispatch queue is accepted, using the queue
+ returned by [OMPromise queueWithExecutor:]. Blocks and handlers targeting that
+ queue are handed to the executor instead of being dispatched by GCD.
+ */
+@protocol OMExecutor <NSObject>
+
+/** Run the function asynchronously, passing the context.
+
+ @param function The function to call.
+ @param context The only argument passed to the function.
+ */
+- (void)execute:(dispatch_function_t)function context:(nullable void *)context;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -31,6 +31,10 @@ NS_ASSUME_NONNULL_BEGIN
 
  In order to start the underlying work, one must register at least one callback
  block (i.e., fulfilled:, failed:, progressed:, always:) or any chaining method.
+
+ Lazy promises are cancellable until they get started, the underlying work is never
+ started at all then. Once running, they are only cancellable if the task registered
+ a cancellation handler at its deferred, see OMDeferred.
  */
 @interface OMLazyPromise<__covariant ResultType> : OMPromise<ResultType>
 
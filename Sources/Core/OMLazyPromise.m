@@ -50,7 +50,7 @@
 }
 
 + (OMLazyPromise *)promiseWithTask:(id (^)())task {
-    return [OMLazyPromise promiseWithTask:task on:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
+    return [OMLazyPromise promiseWithTask:task on:[OMPromise globalTaskQueue]];
 }
 
 + (OMLazyPromise *)promiseWithTask:(id (^)())task on:(dispatch_queue_t)queue {
@@ -58,15 +58,15 @@
         id result = task();
 
         if ([result isKindOfClass:NSError.class]) {
-            [deferred fail:result];
+            [deferred tryFail:result];
         } else {
-            [deferred fulfil:result];
+            [deferred tryFulfil:result];
         }
     } on:queue];
 }
 
 + (OMLazyPromise *)promiseWithDetailedTask:(void (^)(OMDeferred *))task {
-    return [OMLazyPromise promiseWithDetailedTask:task on:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
+    return [OMLazyPromise promiseWithDetailedTask:task on:[OMPromise globalTaskQueue]];
 }
 
 + (OMLazyPromise *)promiseWithDetailedTask:(void (^)(OMDeferred *))task on:(dispatch_queue_t)queue {
@@ -81,26 +81,16 @@
     }
     
     if (queue == nil) {
-        queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        queue = [OMPromise globalTaskQueue];
     }
 
-    const NSUInteger current = self.depth;
-    const NSUInteger next = self.depth + 1;
-
     OMLazyPromise *promise = [OMLazyPromise promiseWithDetailedTask:^(OMDeferred *deferred) {
-        [[[self
-                progressed:^(float progress) {
-                    [deferred progress:progress * ((float)current/next)];
-                }]
-                failed:^(NSError *error) {
-                    [deferred fail:error];
-                }]
-                fulfilled:^(id result) {
-                    [OMPromise bind:deferred with:thenHandler using:result bias:(float)current/next fraction:1.f/next];
-                } on:queue];
+        [self link:deferred then:thenHandler on:queue];
     } on:queue];
 
-    promise.depth = next;
+    promise.depth = self.depth + 1;
+    [promise inheritFrom:self];
+    [promise consume:self];
 
     return promise;
 }
@@ -111,43 +101,32 @@
     }
     
     if (queue == nil) {
-        queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        queue = [OMPromise globalTaskQueue];
     }
 
     OMLazyPromise *promise = [OMLazyPromise promiseWithDetailedTask:^(OMDeferred *deferred) {
-        [[[self
-                progressed:^(float progress) {
-                    [deferred progress:progress];
-                }]
-                fulfilled:^(id result) {
-                    [deferred fulfil:result];
-                }]
-                failed:^(NSError *error) {
-                    [OMPromise bind:deferred with:rescueHandler using:error bias:self.progress fraction:1.f - self.progress];
-                } on:queue];
+        [self link:deferred rescue:rescueHandler on:queue];
     } on:queue];
 
     promise.depth = self.depth;
+    [promise inheritFrom:self];
+    [promise consume:self];
 
     return promise;
 }
 
-- (instancetype)fulfilled:(void (^)(id))fulfilHandler on:(dispatch_queue_t)queue {
-    [self start];
-
-    return [super fulfilled:fulfilHandler on:queue];
+- (BOOL)cancellable {
+    // the task is simply never run if cancelled prior to being started, afterwards
+    // it has to support cancellation itself
+    @synchronized (self) {
+        return !self.started || [super cancellable];
+    }
 }
 
-- (instancetype)failed:(void (^)(NSError *))failHandler on:(dispatch_queue_t)queue {
-    [self start];
-
-    return [super failed:failHandler on:queue];
-}
+- (void)willAddContinuation {
+    [super willAddContinuation];
 
-- (instancetype)progressed:(void (^)(float))progressHandler on:(dispatch_queue_t)queue {
     [self start];
-
-    return [super progressed:progressHandler on:queue];
 }
 
 - (id)waitForResultWithin:(NSTimeInterval)seconds {
@@ -182,18 +161,18 @@
 
 - (BOOL)start {
     @synchronized (self) {
-        if (self.started) {
+        if (self.started || self.state != OMPromiseStateUnfulfilled) {
             return NO;
         } else {
             self.started = YES;
         }
     }
 
-    dispatch_async(self.queue, ^{
+    [OMPromise dispatch:^{
         OMDeferred *deferred = [[OMDeferred alloc] initWithPromise:self];
 
         self.task(deferred);
-    });
+    } on:self.queue];
 
     return YES;
 }
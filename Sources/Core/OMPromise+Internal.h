@@ -43,8 +43,48 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (void)cancelled:(void (^)())cancelHandler;
 
+/** Count another promise derived from the receiver.
+ */
+- (void)addConsumer;
+
+/** One of the derived promises got cancelled. Once all of them are, the receiver
+ is cancelled as well, given it supports cancellation.
+ */
+- (void)cancelConsumer;
+
+/** Register the receiver as consumer of the promise it is derived from, such that
+ cancelling the receiver propagates upstream once all consumers got cancelled.
+ */
+- (void)consume:(OMPromise *)promise;
+
+/** Register the receiver as consumer of each of the combined promises.
+ */
+- (void)consumeAll:(NSArray *)promises;
+
+/** Let the deferred follow the outcome of the receiver, using the handler in case
+ of fulfilment. Registers a single continuation only.
+ */
+- (void)link:(OMDeferred *)deferred then:(id (^)(id))thenHandler on:(nullable dispatch_queue_t)queue;
+
+/** Let the deferred follow the outcome of the receiver, using the handler in case
+ of failure. Registers a single continuation only.
+ */
+- (void)link:(OMDeferred *)deferred rescue:(id (^)(NSError *))rescueHandler on:(nullable dispatch_queue_t)queue;
+
+/** Called before any handler gets registered, except for cancel handlers.
+ */
+- (void)willAddContinuation;
+
 - (void)cleanup;
 
+/** Copies the settings a derived promise shares with the one it originates from.
+ */
+- (void)inheritFrom:(OMPromise *)promise;
+
+/** Dispatch the block asynchronously, respecting the executor behind the queue.
+ */
++ (void)dispatch:(dispatch_block_t)block on:(dispatch_queue_t)queue;
+
 + (OMPromise *)bind:(OMDeferred *)deferred
                with:(id (^)(id))handler
               using:(id)parameter
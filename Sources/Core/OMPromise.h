@@ -25,6 +25,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import "OMExecutor.h"
+
 @class OMDeferred<ResultType>;
 @class OMLazyPromise<__covariant ResultType>;
 
@@ -46,7 +48,13 @@ typedef NS_ENUM(NSInteger, OMPromisesErrorCodes) {
     /** Indicates that the promise has been cancelled. */
     OMPromisesCancelledError,
     /** Indicates that no promise passed to the any: combinator got fulfilled. */
-    OMPromisesCombinatorAnyNonFulfilledError
+    OMPromisesCombinatorAnyNonFulfilledError,
+    /** Indicates that too few promises passed to the some:count: combinator got fulfilled. */
+    OMPromisesCombinatorSomeNotEnoughFulfilledError,
+    /** Indicates that the promise didn't settle in time, see timeout:. */
+    OMPromisesTimeoutError,
+    /** Indicates that no promise has been passed to the race: combinator. */
+    OMPromisesCombinatorRaceEmptyError
 };
 
 /** The error domain used within NSError to distinguish errors specific
@@ -77,8 +85,8 @@ extern NSString *const OMPromisesErrorDomain;
  similar to then:, but the supplied block is called in case the promise fails.
  
  To build more complex structures you might use one combinator of join:, chain:initial:,
- all:, any:, collect: or relay:. See the corresponding method documentation for more
- information.
+ all:, any:, collect:, map:concurrency:task: or relay:. See the corresponding method
+ documentation for more information.
  
  We have two blocking methods which are designed for testing purposes and should only
  be used in testing scenarios and not in production code. The methods
@@ -122,7 +130,8 @@ extern NSString *const OMPromisesErrorDomain;
 
 /** Whether the underlying operation supports cancellation or not.
  
- In case cancellable is `YES`, it's safe to call cancel.
+ In case cancellable is `YES`, it's safe to call cancel. Promises derived using
+ then:, rescue: or any of the combinators are always cancellable.
  */
 @property(readonly, nonatomic) BOOL cancellable;
 
@@ -148,6 +157,49 @@ extern NSString *const OMPromisesErrorDomain;
  */
 + (void)setGlobalDefaultQueue:(dispatch_queue_t)queue;
 
+/** Returns the queue tasks are run on if not specified otherwise.
+
+ Used by promiseWithTask: and the task based methods of OMLazyPromise. It defaults
+ to the global queue of default priority.
+
+ @return The global task queue.
+ @see setGlobalTaskQueue:
+ */
++ (dispatch_queue_t)globalTaskQueue;
+
+/** Override the global task queue.
+
+ @param queue The new global task queue, nil to restore the default.
+ @see globalTaskQueue
+ */
++ (void)setGlobalTaskQueue:(nullable dispatch_queue_t)queue;
+
+/** Create a queue which hands everything targeting it to the executor.
+
+ The returned queue is accepted wherever a queue is accepted, e.g., as defaultQueue,
+ globalDefaultQueue or as argument of then:on:. Blocks dispatched to it by other means
+ than OMPromises run on GCD as usual. The queue keeps the executor alive.
+
+ @param executor The executor to run blocks and handlers.
+ @return A new queue representing the executor.
+ @see OMWorkStealingPool
+ */
++ (dispatch_queue_t)queueWithExecutor:(id<OMExecutor>)executor;
+
+/** A pseudo queue which runs blocks on the thread settling the promise.
+
+ In contrast to passing nil, blocks are not called recursively. Blocks becoming
+ ready while another one is running on the same thread are queued and called once
+ the current one returned, such that arbitrarily long chains are settled without
+ any dispatch and using constant stack depth.
+
+ Independent of this, blocks targeting the queue whose blocks are currently being
+ called on the settling thread run right away as well.
+
+ @return The immediate queue.
+ */
++ (dispatch_queue_t)immediateQueue;
+
 /** Blocks are dispatched to this queue if not specified otherwise.
 
  This property inherits the globalDefaultQueue property during instantiation.
@@ -167,6 +219,57 @@ extern NSString *const OMPromisesErrorDomain;
  */
 - (instancetype)on:(dispatch_queue_t)queue;
 
+///---------------------------------------------------------------------------------------
+/// @name Progress Propagation
+///---------------------------------------------------------------------------------------
+
+/** Whether progress is propagated to handlers and derived promises at all.
+
+ If set to `NO`, progressed: blocks are never called and promises created by then:
+ or rescue: don't follow the progress of the receiver, which saves some work along
+ chains that never consult their progress. Derived promises inherit the value, it
+ defaults to globalTracksProgress.
+
+ @see globalTracksProgress
+ */
+@property(nonatomic) BOOL tracksProgress;
+
+/** Returns the tracksProgress value set for each promise on creation.
+
+ Defaults to `YES`.
+
+ @return Whether new promises track their progress.
+ @see setGlobalTracksProgress:
+ */
++ (BOOL)globalTracksProgress;
+
+/** Override the global tracksProgress default.
+
+ @param tracksProgress Whether new promises track their progress.
+ @see globalTracksProgress
+ */
++ (void)setGlobalTracksProgress:(BOOL)tracksProgress;
+
+/** Minimum interval in seconds between two progress updates delivered to handlers.
+
+ Updates occurring in between are coalesced and the most recent one is delivered
+ once the interval elapsed. The final progress of 1 is always delivered right away.
+ Promises created by then: or rescue: inherit the value, thus the whole chain shares
+ the same policy. Defaults to 0, i.e., every update is delivered.
+
+ @see progressGranularity
+ */
+@property(nonatomic) NSTimeInterval progressInterval;
+
+/** Minimum increase of progress before handlers get informed again.
+
+ Smaller increases are skipped, the final progress of 1 is always delivered.
+ Promises created by then: or rescue: inherit the value. Defaults to 0.
+
+ @see progressInterval
+ */
+@property(nonatomic) float progressGranularity;
+
 ///---------------------------------------------------------------------------------------
 /// @name Creation
 ///---------------------------------------------------------------------------------------
@@ -175,7 +278,7 @@ extern NSString *const OMPromisesErrorDomain;
  
  The promise completed with the result of the block. If anything within the block
  raises an exception, the promise fails with the OMPromiseExceptionError code.
- The block is executed asynchronously in a background queue. If you need more control
+ The block is executed asynchronously on the globalTaskQueue. If you need more control
  where the block is executed, have a look at promiseWithTask:on:.
  
  @param task The task describing the outcome of the promise.
@@ -206,6 +309,7 @@ extern NSString *const OMPromisesErrorDomain;
 /** Create a promise which gets fulfilled after a certain delay.
 
  After a certain amount of time the promise gets fulfilled using the supplied value.
+ The delay is kept by a shared timer, thus it doesn't rely on a run loop.
  
  @param result The value to fulfil the promise.
  @param delay Time span to wait before fulfilling the promise.
@@ -224,6 +328,7 @@ extern NSString *const OMPromisesErrorDomain;
 /** Create a promise which fails after a certain delay.
 
  After a certain amount of time the promise fails using the supplied error.
+ The delay is kept by a shared timer, thus it doesn't rely on a run loop.
  
  @param error Reason why the promise failed.
  @param delay Time span to wait before the promise fails.
@@ -380,6 +485,12 @@ extern NSString *const OMPromisesErrorDomain;
  If the deferred supports cancellation, it should try to stop/abort the corresponding
  task. By default a deferred _does not_ support cancellation, in which case a call
  to cancel would throw an exception.
+ 
+ Cancelling a derived promise propagates upstream: the promise it originates from
+ gets cancelled as well, as soon as all promises derived from it got cancelled and
+ given it supports cancellation. A shared promise therefore keeps going as long as
+ a single consumer is still interested in its outcome. The same holds for promises
+ which combinators like race: cancel on their own.
  */
 - (void)cancel;
 
@@ -418,6 +529,48 @@ extern NSString *const OMPromisesErrorDomain;
  */
 + (OMPromise *)any:(NSArray<OMPromise *> *)promises;
 
+/** Similar to any:, but cancels all other promises once one got fulfilled.
+
+ Promises which are still unfulfilled get cancelled as soon as the outcome is
+ decided, see cancel. Handlers registered at the ones left running no longer refer
+ to the new promise.
+
+ @param promises A sequence of promises.
+ @return A new promise.
+ @see any:
+ */
++ (OMPromise *)anyCancellingOthers:(NSArray<OMPromise *> *)promises;
+
+/** Race for the first promise to either get fulfilled or fail.
+
+ The new returned promise takes over the outcome of the first supplied promise that
+ settles. Afterwards, all other promises which are still unfulfilled get cancelled,
+ see cancel.
+
+ The progress aligns to the mostly progressed promise. Without any promise, the
+ returned one fails using OMPromisesCombinatorRaceEmptyError.
+
+ @param promises A non-empty sequence of promises.
+ @return A new promise.
+ */
++ (OMPromise *)race:(NSArray<OMPromise *> *)promises;
+
+/** Wait for the first count promises to get fulfilled.
+
+ The new returned promise gets fulfilled with an array containing the results of the
+ first count fulfilled promises in order of their fulfilment. `nil` has been replaced
+ by `[NSNull null]`. It fails as soon as too many promises failed for count of them
+ to get fulfilled. In both cases, all other promises which are still unfulfilled
+ get cancelled, see cancel.
+
+ The progress aligns to the mostly progressed promise.
+
+ @param promises A sequence of promises.
+ @param count The number of promises required to get fulfilled.
+ @return A new promise.
+ */
++ (OMPromise<NSArray *> *)some:(NSArray<OMPromise *> *)promises count:(NSUInteger)count;
+
 /** Wait for all promises to get fulfilled.
 
  In case that all supplied promises get fulfilled, the promise itself returns
@@ -446,6 +599,45 @@ extern NSString *const OMPromisesErrorDomain;
  */
 + (OMPromise<NSArray *> *)collect:(NSArray<OMPromise *> *)promises;
 
+/** Map each item of a collection to a promise, while keeping at most a limited
+ number of them in flight.
+
+ The task is called for the next item as soon as one of the promises in flight
+ settles, thus the items are pulled from the collection one at a time. Supply an
+ NSEnumerator to lazily produce huge numbers of items. The new promise gets
+ fulfilled with an array containing all results in order of the items, `nil`
+ replaced by `NSNull.null`. If any promise fails, the returned promise fails also,
+ no further tasks are started and the promises still in flight get cancelled, see
+ cancel.
+
+ If the collection knows its count, the progress is determined by the number of
+ settled promises.
+
+ @param collection Any collection or enumerator, e.g., NSArray or NSEnumerator.
+ @param concurrency Maximum number of promises in flight, at least one.
+ @param task Block creating the promise for a single item.
+ @return A new promise yielding an array containing all results in order.
+ @see forEach:concurrency:task:
+ */
++ (OMPromise<NSArray *> *)map:(id<NSFastEnumeration>)collection
+                  concurrency:(NSUInteger)concurrency
+                         task:(OMPromise *(^)(id item))task;
+
+/** Similar to map:concurrency:task:, but doesn't keep any results.
+
+ The new promise gets fulfilled with `nil` once all promises got fulfilled, such
+ that memory stays bounded independent of the size of the collection.
+
+ @param collection Any collection or enumerator, e.g., NSArray or NSEnumerator.
+ @param concurrency Maximum number of promises in flight, at least one.
+ @param task Block creating the promise for a single item.
+ @return A new promise.
+ @see map:concurrency:task:
+ */
++ (OMPromise *)forEach:(id<NSFastEnumeration>)collection
+           concurrency:(NSUInteger)concurrency
+                  task:(OMPromise *(^)(id item))task;
+
 /** Relays all promise events to a deferred.
 
   Relays state transitions as well as progress notifications to the supplied
@@ -456,6 +648,64 @@ extern NSString *const OMPromisesErrorDomain;
  */
 - (instancetype)relay:(OMDeferred<ResultType> *)deferred;
 
+/** Fail if the promise doesn't settle in time.
+
+ The new promise follows the receiver, but fails with OMPromisesTimeoutError if
+ the receiver is still unfulfilled once the time elapsed. In that case the
+ receiver is cancelled, see cancel.
+
+ Deadlines are kept by a shared timer wheel, thus each costs constant time and
+ doesn't require a run loop. They are rounded up to a resolution of 10 ms.
+
+ @param seconds Time span the receiver has to settle in.
+ @return A new promise.
+ */
+- (OMPromise<ResultType> *)timeout:(NSTimeInterval)seconds;
+
+/** Postpone the outcome of the promise.
+
+ The new promise takes over the outcome of the receiver, once the time elapsed
+ after the receiver settled. Progress is passed along right away.
+
+ @param seconds Time span to wait after the receiver settled.
+ @return A new promise.
+ */
+- (OMPromise<ResultType> *)delay:(NSTimeInterval)seconds;
+
+///---------------------------------------------------------------------------------------
+/// @name Awaiting
+///---------------------------------------------------------------------------------------
+
+/** Block the calling thread until the promise settled.
+
+ The thread is parked until the settling thread wakes it up, without any polling.
+ Called on the main thread, the run loop keeps running meanwhile. Don't await a
+ promise on the very queue it needs to get settled, as that would dead-lock.
+
+ @param error Set to the error of the promise if it failed.
+ @return The result of the promise, nil if it failed.
+ @see awaitWithin:error:
+ */
+- (nullable ResultType)await:(NSError *_Nullable *_Nullable)error;
+
+/** Similar to await:, but gives up once the time is up.
+
+ @param seconds The waiting interval, -1. for infinity.
+ @param error Set to the error of the promise if it failed, or to an error with
+        code OMPromisesTimeoutError if it didn't settle in time.
+ @return The result of the promise, nil if it failed or didn't settle in time.
+ */
+- (nullable ResultType)awaitWithin:(NSTimeInterval)seconds error:(NSError *_Nullable *_Nullable)error;
+
+/** Block the calling thread until all promises got fulfilled or any failed.
+
+ @param promises A sequence of promises.
+ @param error Set to the error of the first failed promise.
+ @return All results in order, nil if any promise failed.
+ @see all:
+ */
++ (nullable NSArray *)awaitAll:(NSArray<OMPromise *> *)promises error:(NSError *_Nullable *_Nullable)error;
+
 ///---------------------------------------------------------------------------------------
 /// @name Testing
 ///---------------------------------------------------------------------------------------
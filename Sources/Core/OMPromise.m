@@ -25,8 +25,12 @@
 
 #import "OMPromise.h"
 
+#import <pthread.h>
+#import <stdatomic.h>
+
 #import "CTBlockDescription.h"
 #import "OMDeferred.h"
+#import "OMTimerWheel.h"
 
 NSString *const OMPromisesErrorDomain = @"de.reaktor42.OMPromises";
 
@@ -36,385 +40,1183 @@ typedef NS_ENUM(NSInteger, OMPromiseHandler) {
     OMPromiseHandlerFailed,
     OMPromiseHandlerProgressed,
     OMPromiseHandlerThen,
-    OMPromiseHandlerRescue
+    OMPromiseHandlerRescue,
+    OMPromiseHandlerAlways,
+    OMPromiseHandlerForward,
+    OMPromiseHandlerCancelled
 };
 
-static const NSTimeInterval kTestingIntervalPrecision = .01;
+/** A handler registered at an unfulfilled promise.
+
+ A single record type describes every kind of handler. The links created by then:
+ and rescue: observe all events using one record, which forwards to the deferred of
+ the derived promise and calls the user supplied block on its queue.
+
+ Continuations form an intrusive stack which is pushed and stolen using atomic
+ operations only. Once the promise changes its state, the stack is sealed and
+ each further handler is called immediately instead.
+ */
+typedef struct OMContinuation {
+    struct OMContinuation *next;
+    OMPromiseHandler type;
+    /** Whether the record is stored inside of the promise instead of the heap. */
+    BOOL inlined;
+    /** The block to call, or a weak OMPromiseReference in case of a forward. */
+    void *handler;
+    void *queue;
+    void *deferred;
+    /** Offset and scale of the progress of the promise created by a then: link. */
+    float bias;
+    float fraction;
+    /** Maps the progress of the promise to the progress observed by the handler,
+     which differs for handlers taken over from an adopting promise.
+     */
+    float offset;
+    float scale;
+    /** The OMPromiseReference of the adopting promise the handler has been taken over
+     from, if any.
+     */
+    void *origin;
+} OMContinuation;
+
+/** The number of continuations stored inline, before records are allocated.
+ */
+enum { kInlineContinuations = 2 };
+
+/** A single handler call, scheduled as part of a batch.
+ */
+typedef struct OMDelivery {
+    OMPromiseHandler type;
+    void *handler;
+    void *deferred;
+    float bias;
+    float fraction;
+    float progress;
+} OMDelivery;
+
+/** All handler calls of a single event targeting the same queue.
+
+ Batches are submitted using a single dispatch_async_f and call their handlers in
+ registration order.
+ */
+typedef struct OMDeliveryBatch {
+    struct OMDeliveryBatch *next;
+    /** The queue the batch targets, only used for identification. */
+    void *queue;
+    void *value;
+    OMPromiseHandler event;
+    size_t count;
+    OMDelivery deliveries[];
+} OMDeliveryBatch;
+
+/** Batches run on the current thread, instead of being dispatched.
+
+ While a batch is running, further ones are queued and run once it returned.
+ */
+typedef struct OMTrampoline {
+    /** The queue whose batch is currently being run by this thread, if any. */
+    void *queue;
+    BOOL running;
+    OMDeliveryBatch *head;
+    OMDeliveryBatch *tail;
+} OMTrampoline;
+
+/** Collects the batch of a queue while delivering an event.
+ */
+typedef struct OMDeliveryGroup {
+    void *queue;
+    size_t size;
+    OMDeliveryBatch *batch;
+} OMDeliveryGroup;
+
+/** Continuations which got stolen while someone was still walking them.
+ */
+typedef struct OMRetiredContinuations {
+    struct OMRetiredContinuations *next;
+    OMContinuation *continuations;
+} OMRetiredContinuations;
+
+/** Transient state while the result or error is being published, never visible
+ to the outside.
+ */
+static const OMPromiseState OMPromiseStateResolving = -1;
+
+/** Terminates the continuation stack of a promise that left the unfulfilled state.
+ */
+static OMContinuation *const kSealedContinuations = (OMContinuation *)1;
+
+/** Terminates the continuation stack of a promise that adopted another one, each
+ further handler is registered at the adopted promise instead.
+ */
+static OMContinuation *const kAdoptedContinuations = (OMContinuation *)2;
+
+/** Longest time the main thread runs its run loop without checking the promise, while
+ waiting for it.
+ */
+static const NSTimeInterval kAwaitRunLoopInterval = .1;
+
+static const size_t kContinuationBufferSize = 16;
+
+static OMContinuation OMContinuationMake(OMPromiseHandler type, id handler, dispatch_queue_t queue, OMDeferred *deferred) {
+    return (OMContinuation) {
+        .next = NULL,
+        .type = type,
+        .inlined = NO,
+        .handler = (__bridge_retained void *)[handler copy],
+        .queue = (__bridge_retained void *)queue,
+        .deferred = (__bridge_retained void *)deferred,
+        .bias = 0.f,
+        .fraction = 1.f,
+        .offset = 0.f,
+        .scale = 1.f,
+        .origin = NULL
+    };
+}
 
-static dispatch_queue_t globalDefaultQueue = nil;
+/** Copies a record with its own references, for registration at another promise.
+ */
+static OMContinuation OMContinuationCopy(OMContinuation *continuation) {
+    OMContinuation copy = *continuation;
+    copy.next = NULL;
+    copy.inlined = NO;
+    copy.handler = (__bridge_retained void *)(__bridge id)continuation->handler;
+    copy.queue = (__bridge_retained void *)(__bridge id)continuation->queue;
+    copy.deferred = (__bridge_retained void *)(__bridge id)continuation->deferred;
+    copy.origin = (__bridge_retained void *)(__bridge id)continuation->origin;
+    return copy;
+}
 
-@interface OMPromise ()
+/** Copies the handlers registered at the promise itself, skipping the ones it took
+ over from promises adopting it. The order of the stack is retained.
+ */
+static OMContinuation *OMContinuationsCopyOwn(OMContinuation *head) {
+    OMContinuation *copies = NULL;
+    OMContinuation **tail = &copies;
 
-@property(nonatomic) OMPromiseState state;
-@property(nonatomic) NSError *error;
-@property(nonatomic) id result;
-@property(nonatomic) float progress;
-@property(nonatomic) BOOL cancellable;
+    for (OMContinuation *continuation = head; continuation != NULL; continuation = continuation->next) {
+        if (continuation->origin != NULL) {
+            continue;
+        }
 
-@property(nonatomic) NSMutableArray *fulfilHandlers;
-@property(nonatomic) NSMutableArray *failHandlers;
-@property(nonatomic) NSMutableArray *progressHandlers;
-@property(nonatomic) NSMutableArray *cancelHandlers;
+        OMContinuation *copy = malloc(sizeof(OMContinuation));
+        *copy = OMContinuationCopy(continuation);
+        *tail = copy;
+        tail = &copy->next;
+    }
 
-@property(nonatomic) NSUInteger depth;
+    return copies;
+}
 
-@end
+/** Lets the record observe the progress of a promise the original one adopted.
+ */
+static void OMContinuationCompose(OMContinuation *continuation, float offset, float scale) {
+    continuation->offset += offset * continuation->scale;
+    continuation->scale *= scale;
+}
 
-@implementation OMPromise
+static void OMContinuationRelease(OMContinuation *continuation) {
+    (void)(__bridge_transfer id)continuation->handler;
+    (void)(__bridge_transfer id)continuation->queue;
+    (void)(__bridge_transfer id)continuation->deferred;
+    (void)(__bridge_transfer id)continuation->origin;
+}
 
-#pragma mark - Init
+static void OMContinuationFree(OMContinuation *continuation) {
+    while (continuation != NULL) {
+        OMContinuation *next = continuation->next;
+        OMContinuationRelease(continuation);
+        if (!continuation->inlined) {
+            free(continuation);
+        }
+        continuation = next;
+    }
+}
 
-- (id)init {
-    self = [super init];
-    if (self) {
-        _depth = 1;
-        _defaultQueue = [OMPromise globalDefaultQueue];
-        _progress = 0.f;
+static BOOL OMContinuationObserves(OMContinuation *continuation, OMPromiseHandler event) {
+    switch (continuation->type) {
+        case OMPromiseHandlerThen:
+        case OMPromiseHandlerRescue:
+        case OMPromiseHandlerForward:
+            return event != OMPromiseHandlerCancelled;
+        case OMPromiseHandlerAlways:
+            return event == OMPromiseHandlerFulfilled || event == OMPromiseHandlerFailed;
+        default:
+            return continuation->type == event;
     }
-    return self;
 }
 
-#pragma mark - Queue
+/** Whether the event is handled on the queue of the continuation.
 
-+ (dispatch_queue_t)globalDefaultQueue {
-    return globalDefaultQueue;
-}
+ Links only dispatch the call of the user supplied block, forwarding any other event
+ to the derived promise happens immediately. Without a queue, handlers are called
+ right away on the settling thread.
+ */
+static BOOL OMContinuationDispatches(OMContinuation *continuation, OMPromiseHandler event) {
+    if (continuation->queue == NULL) {
+        return NO;
+    }
 
-+ (void)setGlobalDefaultQueue:(dispatch_queue_t)queue {
-    globalDefaultQueue = queue;
+    switch (continuation->type) {
+        case OMPromiseHandlerThen:
+            return event == OMPromiseHandlerFulfilled;
+        case OMPromiseHandlerRescue:
+            return event == OMPromiseHandlerFailed;
+        case OMPromiseHandlerForward:
+        case OMPromiseHandlerCancelled:
+            return NO;
+        default:
+            return YES;
+    }
 }
 
-- (OMPromise *)on:(dispatch_queue_t)queue {
-    self.defaultQueue = queue;
-    return self;
-}
+/** Lists the continuations of a stack in the order they have been pushed.
 
-#pragma mark - Return
+ The supplied buffer is used if it provides enough space, otherwise the caller is
+ responsible to free the returned array.
+ */
+static OMContinuation **OMContinuationsInOrder(OMContinuation *head, OMContinuation **buffer, size_t *count) {
+    size_t n = 0;
+    for (OMContinuation *continuation = head; continuation != NULL; continuation = continuation->next) {
+        n += 1;
+    }
 
-+ (OMPromise *)promiseWithTask:(id (^)())task {
-    return [OMPromise promiseWithTask:task on:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)];
-}
+    OMContinuation **ordered = n <= kContinuationBufferSize ? buffer : malloc(n * sizeof(OMContinuation *));
 
-+ (OMPromise *)promiseWithTask:(id (^)())task on:(dispatch_queue_t)queue {
-    return [[OMPromise promiseWithResult:nil]
-        then:^(id _) {
-            return task();
-        } on:queue];
+    size_t i = n;
+    for (OMContinuation *continuation = head; continuation != NULL; continuation = continuation->next) {
+        ordered[--i] = continuation;
+    }
+
+    *count = n;
+    return ordered;
 }
 
-+ (OMPromise *)promiseWithResult:(id)result {
-    OMDeferred *deferred = [OMDeferred new];
-    [deferred fulfil:result];
-    return deferred.promise;
+static dispatch_queue_t globalDefaultQueue = nil;
+
+static BOOL globalTracksProgress = YES;
+
+static dispatch_queue_t globalTaskQueue = nil;
+
+static dispatch_queue_t immediateQueue = nil;
+static pthread_key_t trampolineKey;
+
+/** Tags the queues representing an executor, the value is the executor.
+ */
+static const void *const kExecutorKey = &kExecutorKey;
+
+static void OMReleaseExecutor(void *executor) {
+    CFRelease(executor);
 }
 
-+ (OMPromise *)promiseWithResult:(id)result after:(NSTimeInterval)delay {
-    OMDeferred *deferred = [OMDeferred new];
-    [deferred performSelector:@selector(fulfil:) withObject:result afterDelay:delay];
-    return deferred.promise;
+/** Submits the function to the executor behind the queue, or to the queue itself.
+ */
+static void OMDispatch(dispatch_queue_t queue, void *context, dispatch_function_t function) {
+    id<OMExecutor> executor = (__bridge id<OMExecutor>)dispatch_queue_get_specific(queue, kExecutorKey);
+
+    if (executor != nil) {
+        [executor execute:function context:context];
+    } else {
+        dispatch_async_f(queue, context, function);
+    }
 }
 
-+ (OMPromise *)promiseWithError:(NSError *)error {
-    OMDeferred *deferred = [OMDeferred new];
-    [deferred fail:error];
-    return deferred.promise;
+static void OMCallBlock(void *context) {
+    dispatch_block_t block = (__bridge_transfer dispatch_block_t)context;
+    block();
 }
 
-+ (OMPromise *)promiseWithError:(NSError *)error after:(NSTimeInterval)delay {
-    OMDeferred *deferred = [OMDeferred new];
-    [deferred performSelector:@selector(fail:) withObject:error afterDelay:delay];
-    return deferred.promise;
+/** Who settles the handlers an adopting promise moved over to the adopted one.
+ */
+typedef NS_ENUM(int, OMAdoptionState) {
+    OMAdoptionStateFollowing,
+    OMAdoptionStateClaimed,
+    OMAdoptionStateDetached
+};
+
+/** Refers to a promise without keeping it alive.
+
+ The reference of an adopting promise also arbitrates its moved handlers: either the
+ adopted promise claims them while settling, or the adopting promise detaches them
+ by leaving the unfulfilled state on its own first, e.g., by getting cancelled.
+ */
+@interface OMPromiseReference : NSObject
+
+@property(nonatomic, weak) OMPromise *promise;
+
+/** Returns whether the adopted promise may settle the handlers. */
+- (BOOL)claim;
+
+/** Returns whether the adopting promise took the handlers back. */
+- (BOOL)detach;
+
+@property(nonatomic, readonly, getter=isDetached) BOOL detached;
+
+@end
+
+@implementation OMPromiseReference {
+    _Atomic(OMAdoptionState) _state;
 }
 
-#pragma mark - Bind
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        atomic_init(&_state, OMAdoptionStateFollowing);
+    }
+    return self;
+}
 
-- (instancetype)then:(id (^)(id result))thenHandler {
-    return [self then:thenHandler on:self.defaultQueue];
+- (BOOL)claim {
+    OMAdoptionState expected = OMAdoptionStateFollowing;
+    return atomic_compare_exchange_strong(&_state, &expected, OMAdoptionStateClaimed) ||
+        expected == OMAdoptionStateClaimed;
 }
 
-- (instancetype)then:(id (^)(id result))thenHandler on:(dispatch_queue_t)queue {
-    OMDeferred *deferred = [OMDeferred new];
-    
-    NSUInteger current = self.depth;
-    NSUInteger next = self.depth + 1;
-    
-    deferred.promise.depth = next;
-    
-    [[[self
-        progressed:^(float progress) {
-            [deferred progress:progress * ((float)current/next)];
-        }]
-        failed:^(NSError *error) {
-            [deferred fail:error];
-        }]
-        fulfilled:^(id result) {
-            [OMPromise bind:deferred with:thenHandler using:result bias:(float)current/next fraction:1.f/next];
-        } on:queue];
-    
-    return deferred.promise;
+- (BOOL)detach {
+    OMAdoptionState expected = OMAdoptionStateFollowing;
+    return atomic_compare_exchange_strong(&_state, &expected, OMAdoptionStateDetached);
 }
 
-- (instancetype)rescue:(id (^)(NSError *error))rescueHandler {
-    return [self rescue:rescueHandler on:self.defaultQueue];
+- (BOOL)isDetached {
+    return atomic_load(&_state) == OMAdoptionStateDetached;
 }
 
-- (instancetype)rescue:(id (^)(NSError *error))rescueHandler on:(dispatch_queue_t)queue {
-    OMDeferred *deferred = [OMDeferred new];
-    deferred.promise.depth = self.depth;
-    
-    [[[self
-        progressed:^(float progress) {
-            [deferred progress:progress];
-        }]
-        fulfilled:^(id result) {
-            [deferred fulfil:result];
-        }]
-        failed:^(NSError *error) {
-            [OMPromise bind:deferred with:rescueHandler using:error bias:self.progress fraction:1.f - self.progress];
-        } on:queue];
-    
-    return deferred.promise;
+@end
+
+/** Whether the promise the continuation is registered at may call it.
+
+ Handlers taken over from an adopting promise are left to that promise, once it got
+ settled on its own. Progress is no outcome, it only needs to be suppressed then.
+ */
+static BOOL OMContinuationClaims(OMContinuation *continuation, OMPromiseHandler event) {
+    OMPromiseReference *origin = (__bridge OMPromiseReference *)continuation->origin;
+
+    if (origin == nil) {
+        return YES;
+    }
+
+    return event == OMPromiseHandlerProgressed ? !origin.detached : [origin claim];
 }
 
-#pragma mark - Callbacks
+/** Fixed-point scale of the progress of a single promise combined by all: or collect:.
+ */
+static const int32_t kAggregateProgressScale = 1 << 20;
 
-- (instancetype)fulfilled:(void (^)(id result))fulfilHandler {
-    return [self fulfilled:fulfilHandler on:self.defaultQueue];
+/** Shared state of the promises combined by all: and collect:.
+
+ The overall progress is kept as a running sum, which each promise updates by the
+ delta of its own progress. Outcomes are stored in a preallocated buffer.
+ */
+@interface OMAggregate : NSObject
+
+- (instancetype)initWithCount:(NSUInteger)count;
+
+/** Updates the progress of the promise at the index and returns the overall progress.
+ */
+- (float)progress:(float)progress at:(NSUInteger)index;
+
+/** Stores the outcome of the promise at the index and returns whether it was the last one.
+ */
+- (BOOL)collect:(id)outcome at:(NSUInteger)index;
+
+/** All outcomes, nil values replaced by NSNull.
+ */
+- (NSArray *)outcomes;
+
+@end
+
+@class OMQuorum;
+
+/** Detachable reference to an OMQuorum held by the handlers registered at its promises.
+ */
+@interface OMQuorumReference : NSObject
+
+/** The quorum, nil once the outcome is decided. */
+@property(atomic, strong) OMQuorum *quorum;
+
+@end
+
+/** Shared state of the promises combined by race:, some:count: and anyCancellingOthers:.
+
+ Once the outcome is decided, the remaining promises get cancelled and the handlers
+ registered at them get detached, as not all of them can be cancelled. Those only
+ keep the empty OMQuorumReference alive, instead of the quorum and its promise.
+ */
+@interface OMQuorum : NSObject
+
+/** @param required Number of promises required to get fulfilled.
+    @param error Reason if too many promises failed, nil to use the error of the
+           failed promise instead.
+ */
+- (instancetype)initWithPromises:(NSArray *)promises
+                        deferred:(OMDeferred *)deferred
+                        required:(NSUInteger)required
+                       tolerated:(NSUInteger)tolerated
+                           error:(NSError *)error
+                          single:(BOOL)single;
+
+- (void)fulfilled:(id)result;
+- (void)failed:(NSError *)error;
+- (void)progressed:(float)progress;
+
+/** The record the handlers registered at the promises refer to the quorum through. */
+@property(nonatomic, readonly) OMQuorumReference *reference;
+
+@end
+
+@implementation OMQuorumReference
+@end
+
+@implementation OMQuorum {
+    NSArray *_promises;
+    OMDeferred *_deferred;
+    NSUInteger _required;
+    NSUInteger _tolerated;
+    NSError *_error;
+    BOOL _single;
+
+    __strong id *_results;
+    _Atomic(NSUInteger) _fulfilled;
+    _Atomic(NSUInteger) _stored;
+    _Atomic(NSUInteger) _failed;
+    atomic_bool _decided;
 }
 
-- (instancetype)fulfilled:(void (^)(id result))fulfilHandler on:(dispatch_queue_t)queue {
-    if (queue != nil) {
-        fulfilHandler = ^(id result) {
-            dispatch_async(queue, ^{
-                fulfilHandler(result);
-            });
-        };
-    }
-    
-    OMPromiseState state;
-    
-    @synchronized (self) {
-        state = self.state;
-        
-        if (state == OMPromiseStateUnfulfilled) {
-            if (self.fulfilHandlers == nil) {
-                self.fulfilHandlers = [NSMutableArray arrayWithCapacity:1];
-            }
-            [self.fulfilHandlers addObject:fulfilHandler];
-        }
-    }
-    
-    if (state == OMPromiseStateFulfilled) {
-        fulfilHandler(self.result);
+- (instancetype)initWithPromises:(NSArray *)promises
+                        deferred:(OMDeferred *)deferred
+                        required:(NSUInteger)required
+                       tolerated:(NSUInteger)tolerated
+                           error:(NSError *)error
+                          single:(BOOL)single
+{
+    self = [super init];
+    if (self) {
+        _promises = promises;
+        _deferred = deferred;
+        _required = required;
+        _tolerated = tolerated;
+        _error = error;
+        _single = single;
+        _reference = [OMQuorumReference new];
+        _reference.quorum = self;
+        _results = (__strong id *)calloc(required, sizeof(id));
+        atomic_init(&_fulfilled, 0);
+        atomic_init(&_stored, 0);
+        atomic_init(&_failed, 0);
+        atomic_init(&_decided, NO);
     }
-    
     return self;
 }
 
-- (instancetype)failed:(void (^)(NSError *error))failHandler {
-    return [self failed:failHandler on:self.defaultQueue];
+- (void)dealloc {
+    [self releaseResults];
+    free(_results);
 }
 
-- (instancetype)failed:(void (^)(NSError *error))failHandler on:(dispatch_queue_t)queue {
-    if (queue != nil) {
-        failHandler = ^(NSError *error) {
-            dispatch_async(queue, ^{
-                failHandler(error);
-            });
-        };
+- (void)fulfilled:(id)result {
+    NSUInteger slot = atomic_fetch_add(&_fulfilled, 1);
+    if (slot >= _required || atomic_load(&_decided)) {
+        return;
     }
-    
-    OMPromiseState state;
-    
-    @synchronized (self) {
-        state = self.state;
-        
-        if (state == OMPromiseStateUnfulfilled) {
-            if (self.failHandlers == nil) {
-                self.failHandlers = [NSMutableArray arrayWithCapacity:1];
-            }
-            [self.failHandlers addObject:failHandler];
-        }
+
+    _results[slot] = result ?: [NSNull null];
+
+    // the last slot might be taken before the others are stored, wait for all of them
+    if (atomic_fetch_add(&_stored, 1) + 1 == _required && !atomic_exchange(&_decided, YES)) {
+        id outcome = _single ? _results[0] : [NSArray arrayWithObjects:_results count:_required];
+        [self releaseResults];
+
+        [_deferred tryFulfil:outcome];
+        [self cancelRemaining];
     }
-    
-    if (self.state == OMPromiseStateFailed) {
-        failHandler(self.error);
+}
+
+- (void)failed:(NSError *)error {
+    if (atomic_fetch_add(&_failed, 1) + 1 > _tolerated && !atomic_exchange(&_decided, YES)) {
+        [_deferred tryFail:_error ?: error];
+        [self cancelRemaining];
     }
-    
-    return self;
 }
 
-- (instancetype)progressed:(void (^)(float progress))progressHandler {
-    return [self progressed:progressHandler on:self.defaultQueue];
+- (void)progressed:(float)progress {
+    if (!atomic_load(&_decided)) {
+        [_deferred tryProgress:progress];
+    }
 }
 
-- (instancetype)progressed:(void (^)(float progress))progressHandler on:(dispatch_queue_t)queue {
-    if (queue != nil) {
-        progressHandler = ^(float progress) {
-            dispatch_async(queue, ^{
-                progressHandler(progress);
-            });
-        };
+- (void)releaseResults {
+    for (NSUInteger i = 0; i < _required; ++i) {
+        _results[i] = nil;
     }
-    
-    if (self.progress > FLT_EPSILON) {
-        progressHandler(self.progress);
+}
+
+- (void)cancelRemaining {
+    NSArray *promises = _promises;
+    _promises = nil;
+
+    // the handlers stay registered at promises which can't be cancelled or are shared
+    _reference.quorum = nil;
+
+    for (OMPromise *promise in promises) {
+        [promise cancelConsumer];
     }
-    
-    @synchronized (self) {
-        if (self.state == OMPromiseStateUnfulfilled) {
-            if (self.progressHandlers == nil) {
-                self.progressHandlers = [NSMutableArray arrayWithCapacity:1];
-            }
-            @synchronized (self.progressHandlers) {
-                [self.progressHandlers addObject:progressHandler];
-            }
-        }
+}
+
+@end
+
+@implementation OMAggregate {
+    NSUInteger _count;
+    __strong id *_outcomes;
+    _Atomic(int32_t) *_progress;
+    _Atomic(int64_t) _progressSum;
+    _Atomic(NSUInteger) _pending;
+}
+
+- (instancetype)initWithCount:(NSUInteger)count {
+    self = [super init];
+    if (self) {
+        _count = count;
+        _outcomes = (__strong id *)calloc(count, sizeof(id));
+        _progress = calloc(count, sizeof(_Atomic(int32_t)));
+        atomic_init(&_progressSum, 0);
+        atomic_init(&_pending, count);
     }
-    
     return self;
 }
 
-- (instancetype)always:(void (^)(OMPromiseState state, id result, NSError *error))alwaysHandler {
-    return [self always:alwaysHandler on:self.defaultQueue];
+- (void)dealloc {
+    for (NSUInteger i = 0; i < _count; ++i) {
+        _outcomes[i] = nil;
+    }
+    free(_outcomes);
+    free(_progress);
 }
 
-- (instancetype)always:(void (^)(OMPromiseState state, id result, NSError *error))alwaysHandler
-                   on:(dispatch_queue_t)queue
-{
-    return [[self fulfilled:^(id result) {
-        alwaysHandler(OMPromiseStateFulfilled, result, nil);
-    } on:queue] failed:^(NSError *error) {
-        alwaysHandler(OMPromiseStateFailed, nil, error);
-    } on:queue];
+- (float)progress:(float)progress at:(NSUInteger)index {
+    int32_t scaled = (int32_t)(MIN(1.f, progress) * kAggregateProgressScale);
+    int32_t current = atomic_load_explicit(&_progress[index], memory_order_relaxed);
+
+    while (current < scaled) {
+        if (atomic_compare_exchange_weak_explicit(&_progress[index], &current, scaled,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            int64_t sum = atomic_fetch_add(&_progressSum, scaled - current) + (scaled - current);
+            return (float)((double)sum / ((double)_count * kAggregateProgressScale));
+        }
+    }
+
+    return (float)((double)atomic_load(&_progressSum) / ((double)_count * kAggregateProgressScale));
 }
 
-#pragma mark - Cancellation
+- (BOOL)collect:(id)outcome at:(NSUInteger)index {
+    _outcomes[index] = outcome;
 
-- (void)cancel {
-    @synchronized (self) {
-        NSAssert(self.cancellable, @"Promise does not support cancellation!");
-        
-        self.state = OMPromiseStateFailed;
-        self.error = [NSError errorWithDomain:OMPromisesErrorDomain
-                                         code:OMPromisesCancelledError
-                                     userInfo:@{
-                                         NSLocalizedDescriptionKey: @"The promise has been cancelled."
-                                     }];
-    }
+    return atomic_fetch_sub_explicit(&_pending, 1, memory_order_acq_rel) == 1;
+}
 
-    for (void (^cancelHandler)() in self.cancelHandlers) {
-        cancelHandler();
-    }
-    
-    for (void (^failHandler)(NSError *) in self.failHandlers) {
-        failHandler(self.error);
+- (NSArray *)outcomes {
+    for (NSUInteger i = 0; i < _count; ++i) {
+        if (_outcomes[i] == nil) {
+            _outcomes[i] = [NSNull null];
+        }
     }
 
-    [self cleanup];
+    return [NSArray arrayWithObjects:_outcomes count:_count];
 }
 
-#pragma mark - Internal Methods
+@end
 
-- (void)fulfil:(id)result {
-    [self progress:1.f];
+/** Number of items pulled from a collection at once by map:concurrency:task:.
+ */
+enum { kBoundedMapBufferSize = 16 };
 
-    @synchronized (self) {
-        NSAssert(self.state == OMPromiseStateUnfulfilled, @"Can only get fulfilled while being Unfulfilled");
+/** Shared state of map:concurrency:task: and forEach:concurrency:task:.
 
-        self.result = result;
-        self.state = OMPromiseStateFulfilled;
-    }
+ Items are pulled from the collection one at a time, using fast enumeration, and
+ the promise created for an item is started only if less than the allowed number
+ of promises are still in flight.
+ */
+@interface OMBoundedMap : NSObject
 
-    for (void (^fulfilHandler)(id) in self.fulfilHandlers) {
-        fulfilHandler(result);
-    }
+/** @param collect Whether to keep the results of the promises in order.
+ */
+- (instancetype)initWithCollection:(id<NSFastEnumeration>)collection
+                       concurrency:(NSUInteger)concurrency
+                              task:(OMPromise *(^)(id item))task
+                          deferred:(OMDeferred *)deferred
+                           collect:(BOOL)collect;
 
-    [self cleanup];
+/** Starts promises until the limit is reached, or settles the deferred once the
+ collection got exhausted.
+ */
+- (void)pump;
+
+/** Stops starting further promises and cancels the ones still in flight.
+ */
+- (void)cancel;
+
+@end
+
+@implementation OMBoundedMap {
+    id<NSFastEnumeration> _collection;
+    NSFastEnumerationState _enumeration;
+    __unsafe_unretained id _buffer[kBoundedMapBufferSize];
+    NSUInteger _available;
+    NSUInteger _position;
+    BOOL _exhausted;
+
+    NSUInteger _concurrency;
+    OMPromise *(^_task)(id);
+    OMDeferred *_deferred;
+    NSUInteger _total;
+
+    NSMutableArray *_results;
+    NSMutableArray *_running;
+    NSUInteger _started;
+    NSUInteger _inFlight;
+    NSUInteger _settled;
+    BOOL _pumping;
+    BOOL _finished;
 }
 
-- (void)fail:(NSError *)error {
-    @synchronized (self) {
-        NSAssert(self.state == OMPromiseStateUnfulfilled, @"Can only fail while being Unfulfilled");
+- (instancetype)initWithCollection:(id<NSFastEnumeration>)collection
+                       concurrency:(NSUInteger)concurrency
+                              task:(OMPromise *(^)(id item))task
+                          deferred:(OMDeferred *)deferred
+                           collect:(BOOL)collect
+{
+    self = [super init];
+    if (self) {
+        _collection = collection;
+        _concurrency = concurrency;
+        _task = task;
+        _deferred = deferred;
+        _total = [(id)collection respondsToSelector:@selector(count)] ? [(id)collection count] : 0;
+        _results = collect ? [NSMutableArray arrayWithCapacity:MIN(_total, concurrency)] : nil;
+        _running = [NSMutableArray arrayWithCapacity:concurrency];
+    }
+    return self;
+}
 
-        self.error = error;
-        self.state = OMPromiseStateFailed;
+- (BOOL)nextItem:(id __strong *)item {
+    if (_position == _available && !_exhausted) {
+        _available = [_collection countByEnumeratingWithState:&_enumeration objects:_buffer count:kBoundedMapBufferSize];
+        _position = 0;
+        _exhausted = _available == 0;
     }
 
-    for (void (^failHandler)(NSError *) in self.failHandlers) {
-        failHandler(error);
+    if (_exhausted) {
+        return NO;
     }
 
-    [self cleanup];
+    *item = _enumeration.itemsPtr[_position++];
+    return YES;
 }
 
-- (void)progress:(float)progress {
-    NSArray *progressHandlers = nil;
-
+- (void)pump {
     @synchronized (self) {
-        NSAssert(self.state == OMPromiseStateUnfulfilled, @"Can only progress while being Unfulfilled");
-        NSAssert(self.progress <= progress + FLT_EPSILON, @"Progress must not decrease");
-        NSAssert(progress <= 1.0f + FLT_EPSILON, @"Progress must be in range (0, 1]");
-
-        if (self.progress < progress - FLT_EPSILON) {
-            self.progress = MIN(1.0f, progress);
-            progressHandlers = self.progressHandlers;
+        if (_pumping) {
+            return;
         }
-
+        _pumping = YES;
     }
 
-    if (progressHandlers) {
-        @synchronized (progressHandlers) {
-            for (void (^progressHandler)(float) in progressHandlers) {
-                progressHandler(progress);
+    // promises settling right away must not recurse, the loop picks up their slots
+    while (YES) {
+        id item = nil;
+        NSUInteger index = 0;
+        BOOL completed = NO;
+
+        @synchronized (self) {
+            if (_finished || _inFlight >= _concurrency || ![self nextItem:&item]) {
+                completed = !_finished && _exhausted && _inFlight == 0;
+                _finished = _finished || completed;
+                _pumping = NO;
+            } else {
+                index = _started++;
+                _inFlight += 1;
+                [_results addObject:[NSNull null]];
+            }
+        }
+
+        if (item == nil) {
+            if (completed) {
+                [self complete];
             }
+            return;
         }
+
+        [self run:item at:index];
     }
 }
 
-- (BOOL)tryFulfil:(id)result {
+- (void)run:(id)item at:(NSUInteger)index {
+    OMPromise *promise = _task(item);
+    NSAssert([promise isKindOfClass:OMPromise.class], @"The task has to return a promise");
+
+    BOOL abandoned = NO;
     @synchronized (self) {
-        if (self.state == OMPromiseStateUnfulfilled) {
-            [self fulfil:result];
-            return YES;
-        }
+        abandoned = _finished;
+        [_running addObject:promise];
     }
+    [promise addConsumer];
 
-    return NO;
-}
+    // failed or got cancelled while the task was creating the promise
+    if (abandoned) {
+        [promise cancelConsumer];
+        return;
+    }
 
-- (BOOL)tryFail:(NSError *)error {
-    @synchronized (self) {
-        if (self.state == OMPromiseStateUnfulfilled) {
-            [self fail:error];
-            return YES;
+    [promise always:^(OMPromiseState state, id result, NSError *error) {
+        if (state == OMPromiseStateFailed) {
+            [self failed:error];
+            return;
         }
+
+        float progress = 0.f;
+        @synchronized (self) {
+            [_running removeObjectAtIndex:[_running indexOfObjectIdenticalTo:promise]];
+            _results[index] = result ?: [NSNull null];
+            _inFlight -= 1;
+            _settled += 1;
+            progress = _total > 0 ? (float)_settled / _total : 0.f;
+        }
+
+        [_deferred tryProgress:progress];
+        [self pump];
+    }];
+}
+
+- (void)complete {
+    NSArray *results = nil;
+    @synchronized (self) {
+        results = [_results copy];
+        _results = nil;
+        _task = nil;
+        _collection = nil;
     }
 
-    return NO;
+    [_deferred tryFulfil:results];
 }
 
-- (BOOL)tryProgress:(float)progress {
+- (void)failed:(NSError *)error {
+    NSArray *running = nil;
     @synchronized (self) {
-        if (self.state == OMPromiseStateUnfulfilled && progress > self.progress + FLT_EPSILON) {
-            [self progress:progress];
-            return YES;
+        if (_finished) {
+            return;
         }
+        _finished = YES;
+        _collection = nil;
+        _results = nil;
+        running = _running;
+        _running = nil;
     }
 
-    return NO;
+    [_deferred tryFail:error];
+
+    for (OMPromise *promise in running) {
+        [promise cancelConsumer];
+    }
 }
 
-- (void)cancelled:(void (^)())cancelHandler {
+- (void)cancel {
+    NSArray *running = nil;
     @synchronized (self) {
-        if (self.state == OMPromiseStateUnfulfilled) {
-            if (self.cancelHandlers == nil) {
-                self.cancelHandlers = [NSMutableArray arrayWithCapacity:1];
-            }
-            [self.cancelHandlers addObject:cancelHandler];
-            self.cancellable = YES;
+        _finished = YES;
+        _collection = nil;
+        _results = nil;
+        running = _running;
+        _running = nil;
+    }
+
+    for (OMPromise *promise in running) {
+        [promise cancelConsumer];
+    }
+}
+
+@end
+
+@interface OMPromise ()
+
+@property(nonatomic) NSError *error;
+@property(nonatomic) id result;
+
+@property(nonatomic) NSUInteger depth;
+
+@end
+
+@implementation OMPromise {
+    _Atomic(OMPromiseState) _state;
+    _Atomic(float) _progress;
+    atomic_bool _cancellable;
+
+    _Atomic(OMContinuation *) _continuations;
+    _Atomic(OMRetiredContinuations *) _retiredContinuations;
+    _Atomic(NSInteger) _walkers;
+
+    OMContinuation _inlineContinuations[kInlineContinuations];
+    atomic_uint _inlineClaims;
+
+    OMPromise *_adopted;
+    float _adoptedOffset;
+    float _adoptedScale;
+    OMPromiseReference *_adoption;
+    OMContinuation *_adoptedHandlers;
+
+    /** The promise the receiver is derived from, told once the receiver got cancelled. */
+    __weak OMPromise *_upstream;
+
+    _Atomic(float) _deliveredProgress;
+    _Atomic(CFAbsoluteTime) _deliveredProgressAt;
+    atomic_bool _progressFlushScheduled;
+
+    _Atomic(NSUInteger) _consumers;
+    _Atomic(NSUInteger) _cancelledConsumers;
+}
+
+#pragma mark - Init
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _depth = 1;
+        _defaultQueue = [OMPromise globalDefaultQueue];
+        _tracksProgress = [OMPromise globalTracksProgress];
+        atomic_init(&_state, OMPromiseStateUnfulfilled);
+        atomic_init(&_progress, 0.f);
+        atomic_init(&_cancellable, NO);
+        atomic_init(&_continuations, NULL);
+        atomic_init(&_retiredContinuations, NULL);
+        atomic_init(&_walkers, 0);
+        atomic_init(&_inlineClaims, 0);
+        atomic_init(&_deliveredProgress, 0.f);
+        atomic_init(&_deliveredProgressAt, 0.);
+        atomic_init(&_progressFlushScheduled, NO);
+        atomic_init(&_consumers, 0);
+        atomic_init(&_cancelledConsumers, 0);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    OMContinuation *continuations = atomic_load_explicit(&_continuations, memory_order_acquire);
+    if (continuations != kSealedContinuations && continuations != kAdoptedContinuations) {
+        OMContinuationFree(continuations);
+    }
+    if (_adoptedHandlers != kSealedContinuations) {
+        OMContinuationFree(_adoptedHandlers);
+    }
+    [self reclaimContinuations];
+}
+
+#pragma mark - State
+
+- (OMPromiseState)state {
+    OMPromiseState state = atomic_load_explicit(&_state, memory_order_acquire);
+    return state == OMPromiseStateResolving ? OMPromiseStateUnfulfilled : state;
+}
+
+- (float)progress {
+    return atomic_load_explicit(&_progress, memory_order_acquire);
+}
+
+- (BOOL)cancellable {
+    return atomic_load_explicit(&_cancellable, memory_order_acquire);
+}
+
+#pragma mark - Queue
+
++ (dispatch_queue_t)globalDefaultQueue {
+    return globalDefaultQueue;
+}
+
++ (void)setGlobalDefaultQueue:(dispatch_queue_t)queue {
+    globalDefaultQueue = queue;
+}
+
++ (BOOL)globalTracksProgress {
+    return globalTracksProgress;
+}
+
++ (void)setGlobalTracksProgress:(BOOL)tracksProgress {
+    globalTracksProgress = tracksProgress;
+}
+
++ (dispatch_queue_t)globalTaskQueue {
+    return globalTaskQueue ?: dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+}
+
++ (void)setGlobalTaskQueue:(dispatch_queue_t)queue {
+    globalTaskQueue = queue;
+}
+
++ (dispatch_queue_t)queueWithExecutor:(id<OMExecutor>)executor {
+    NSAssert(executor != nil, @"The executor is required.");
+
+    // the queue only runs blocks dispatched to it directly, bypassing the library
+    dispatch_queue_t queue = dispatch_queue_create("de.reaktor42.OMPromises.executor", DISPATCH_QUEUE_CONCURRENT);
+    dispatch_queue_set_specific(queue, kExecutorKey, (__bridge_retained void *)executor, OMReleaseExecutor);
+
+    return queue;
+}
+
++ (void)dispatch:(dispatch_block_t)block on:(dispatch_queue_t)queue {
+    OMDispatch(queue, (__bridge_retained void *)[block copy], OMCallBlock);
+}
+
++ (dispatch_queue_t)immediateQueue {
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        // never used to run anything, its identity is what matters
+        immediateQueue = dispatch_queue_create("de.reaktor42.OMPromises.immediate", DISPATCH_QUEUE_SERIAL);
+        pthread_key_create(&trampolineKey, free);
+    });
+
+    return immediateQueue;
+}
+
+- (OMPromise *)on:(dispatch_queue_t)queue {
+    self.defaultQueue = queue;
+    return self;
+}
+
+#pragma mark - Return
+
++ (OMPromise *)promiseWithTask:(id (^)())task {
+    return [OMPromise promiseWithTask:task on:[OMPromise globalTaskQueue]];
+}
+
++ (OMPromise *)promiseWithTask:(id (^)())task on:(dispatch_queue_t)queue {
+    return [[OMPromise promiseWithResult:nil]
+        then:^(id _) {
+            return task();
+        } on:queue];
+}
+
++ (OMPromise *)promiseWithResult:(id)result {
+    OMDeferred *deferred = [OMDeferred new];
+    [deferred fulfil:result];
+    return deferred.promise;
+}
+
++ (OMPromise *)promiseWithResult:(id)result after:(NSTimeInterval)delay {
+    OMDeferred *deferred = [OMDeferred new];
+    [[OMTimerWheel sharedWheel] schedule:^{
+        [deferred fulfil:result];
+    } after:delay];
+    return deferred.promise;
+}
+
++ (OMPromise *)promiseWithError:(NSError *)error {
+    OMDeferred *deferred = [OMDeferred new];
+    [deferred fail:error];
+    return deferred.promise;
+}
+
++ (OMPromise *)promiseWithError:(NSError *)error after:(NSTimeInterval)delay {
+    OMDeferred *deferred = [OMDeferred new];
+    [[OMTimerWheel sharedWheel] schedule:^{
+        [deferred fail:error];
+    } after:delay];
+    return deferred.promise;
+}
+
+#pragma mark - Bind
+
+- (instancetype)then:(id (^)(id result))thenHandler {
+    return [self then:thenHandler on:self.defaultQueue];
+}
+
+- (instancetype)then:(id (^)(id result))thenHandler on:(dispatch_queue_t)queue {
+    OMDeferred *deferred = [OMDeferred new];
+    deferred.promise.depth = self.depth + 1;
+    [deferred.promise inheritFrom:self];
+    [deferred.promise consume:self];
+
+    [self link:deferred then:thenHandler on:queue];
+
+    return deferred.promise;
+}
+
+- (instancetype)rescue:(id (^)(NSError *error))rescueHandler {
+    return [self rescue:rescueHandler on:self.defaultQueue];
+}
+
+- (instancetype)rescue:(id (^)(NSError *error))rescueHandler on:(dispatch_queue_t)queue {
+    OMDeferred *deferred = [OMDeferred new];
+    deferred.promise.depth = self.depth;
+    [deferred.promise inheritFrom:self];
+    [deferred.promise consume:self];
+
+    [self link:deferred rescue:rescueHandler on:queue];
+
+    return deferred.promise;
+}
+
+#pragma mark - Callbacks
+
+- (instancetype)fulfilled:(void (^)(id result))fulfilHandler {
+    return [self fulfilled:fulfilHandler on:self.defaultQueue];
+}
+
+- (instancetype)fulfilled:(void (^)(id result))fulfilHandler on:(dispatch_queue_t)queue {
+    [self addContinuation:OMContinuationMake(OMPromiseHandlerFulfilled, fulfilHandler, queue, nil)];
+
+    return self;
+}
+
+- (instancetype)failed:(void (^)(NSError *error))failHandler {
+    return [self failed:failHandler on:self.defaultQueue];
+}
+
+- (instancetype)failed:(void (^)(NSError *error))failHandler on:(dispatch_queue_t)queue {
+    [self addContinuation:OMContinuationMake(OMPromiseHandlerFailed, failHandler, queue, nil)];
+
+    return self;
+}
+
+- (instancetype)progressed:(void (^)(float progress))progressHandler {
+    return [self progressed:progressHandler on:self.defaultQueue];
+}
+
+- (instancetype)progressed:(void (^)(float progress))progressHandler on:(dispatch_queue_t)queue {
+    [self addContinuation:OMContinuationMake(OMPromiseHandlerProgressed, progressHandler, queue, nil)];
+
+    return self;
+}
+
+- (instancetype)always:(void (^)(OMPromiseState state, id result, NSError *error))alwaysHandler {
+    return [self always:alwaysHandler on:self.defaultQueue];
+}
+
+- (instancetype)always:(void (^)(OMPromiseState state, id result, NSError *error))alwaysHandler
+                   on:(dispatch_queue_t)queue
+{
+    [self addContinuation:OMContinuationMake(OMPromiseHandlerAlways, alwaysHandler, queue, nil)];
+
+    return self;
+}
+
+#pragma mark - Cancellation
+
+- (void)cancel {
+    NSAssert(self.cancellable, @"Promise does not support cancellation!");
+
+    // the handlers moved over to the adopted promise, which has to settle them
+    if (atomic_load_explicit(&_continuations, memory_order_acquire) == kAdoptedContinuations) {
+        OMPromise *adopted = nil;
+        @synchronized (self) {
+            adopted = _adopted;
         }
+        [adopted cancelConsumer];
+    }
+
+    [self resolveWithState:OMPromiseStateFailed
+                    result:nil
+                     error:[NSError errorWithDomain:OMPromisesErrorDomain
+                                               code:OMPromisesCancelledError
+                                           userInfo:@{
+                                               NSLocalizedDescriptionKey: @"The promise has been cancelled."
+                                           }]
+                 cancelled:YES];
+}
+
+#pragma mark - Internal Methods
+
+- (void)fulfil:(id)result {
+    NSAssert(self.state == OMPromiseStateUnfulfilled, @"Can only get fulfilled while being Unfulfilled");
+
+    [self tryFulfil:result];
+}
+
+- (void)fail:(NSError *)error {
+    NSAssert(self.state == OMPromiseStateUnfulfilled, @"Can only fail while being Unfulfilled");
+
+    [self tryFail:error];
+}
+
+- (void)progress:(float)progress {
+    NSAssert(self.state == OMPromiseStateUnfulfilled, @"Can only progress while being Unfulfilled");
+    NSAssert(self.progress <= progress + FLT_EPSILON, @"Progress must not decrease");
+    NSAssert(progress <= 1.0f + FLT_EPSILON, @"Progress must be in range (0, 1]");
+
+    [self updateProgress:progress];
+}
+
+- (BOOL)tryFulfil:(id)result {
+    return [self resolveWithState:OMPromiseStateFulfilled result:result error:nil cancelled:NO];
+}
+
+- (BOOL)tryFail:(NSError *)error {
+    return [self resolveWithState:OMPromiseStateFailed result:nil error:error cancelled:NO];
+}
+
+- (BOOL)tryProgress:(float)progress {
+    return self.state == OMPromiseStateUnfulfilled && [self updateProgress:progress];
+}
+
+- (void)link:(OMDeferred *)deferred then:(id (^)(id))thenHandler on:(dispatch_queue_t)queue {
+    OMContinuation continuation = OMContinuationMake(OMPromiseHandlerThen, thenHandler, queue, deferred);
+
+    if (self.tracksProgress) {
+        const NSUInteger current = self.depth;
+        const NSUInteger next = self.depth + 1;
+
+        continuation.bias = (float)current/next;
+        continuation.fraction = 1.f/next;
+        continuation.scale = (float)current/next;
     }
+
+    [self addContinuation:continuation];
+}
+
+- (void)link:(OMDeferred *)deferred rescue:(id (^)(NSError *))rescueHandler on:(dispatch_queue_t)queue {
+    [self addContinuation:OMContinuationMake(OMPromiseHandlerRescue, rescueHandler, queue, deferred)];
+}
+
+- (void)willAddContinuation {
+    // lazy promises start their work once somebody is interested
+}
+
+- (void)cancelled:(void (^)())cancelHandler {
+    if ([self addContinuation:OMContinuationMake(OMPromiseHandlerCancelled, cancelHandler, nil, nil)]) {
+        atomic_store_explicit(&_cancellable, YES, memory_order_release);
+    }
+}
+
+- (void)addConsumer {
+    atomic_fetch_add_explicit(&_consumers, 1, memory_order_relaxed);
+}
+
+- (void)cancelConsumer {
+    NSUInteger cancelled = atomic_fetch_add_explicit(&_cancelledConsumers, 1, memory_order_acq_rel) + 1;
+
+    // a shared promise keeps going as long as a single consumer is still interested
+    if (cancelled >= atomic_load_explicit(&_consumers, memory_order_acquire) &&
+        self.state == OMPromiseStateUnfulfilled && self.cancellable)
+    {
+        [self cancel];
+    }
+}
+
+- (void)consume:(OMPromise *)promise {
+    [promise addConsumer];
+
+    // no handler of its own, such that derived promises don't cost another allocation
+    _upstream = promise;
+    atomic_store_explicit(&_cancellable, YES, memory_order_release);
+}
+
+- (void)consumeAll:(NSArray *)promises {
+    NSPointerArray *upstreams = [NSPointerArray weakObjectsPointerArray];
+    for (OMPromise *promise in promises) {
+        [promise addConsumer];
+        [upstreams addPointer:(__bridge void *)promise];
+    }
+
+    [self cancelled:^{
+        for (OMPromise *promise in upstreams) {
+            [promise cancelConsumer];
+        }
+    }];
 }
 
 #pragma mark - Combinators & Transformers
@@ -459,18 +1261,19 @@ static dispatch_queue_t globalDefaultQueue = nil;
 + (OMPromise *)any:(NSArray *)promises {
     OMDeferred *deferred = [OMDeferred new];
 
-    __block NSUInteger failed = 0;
+    OMAggregate *aggregate = [[OMAggregate alloc] initWithCount:promises.count];
+    [deferred.promise consumeAll:promises];
 
-    for (OMPromise *promise in promises) {
-        [[[promise fulfilled:^(id result) {
+    for (NSUInteger i = 0; i < promises.count; ++i) {
+        [[[(OMPromise *)promises[i] fulfilled:^(id result) {
             [deferred tryFulfil:result];
         }] failed:^(NSError *error) {
-            if (++failed == promises.count) {
-                [deferred fail:[NSError errorWithDomain:OMPromisesErrorDomain
-                                                   code:OMPromisesCombinatorAnyNonFulfilledError
-                                               userInfo:@{
-                                                   NSLocalizedDescriptionKey: @"No promise combined with the any combinator has been fulfilled."
-                                               }]];
+            if ([aggregate collect:nil at:i]) {
+                [deferred tryFail:[NSError errorWithDomain:OMPromisesErrorDomain
+                                                      code:OMPromisesCombinatorAnyNonFulfilledError
+                                                  userInfo:@{
+                                                      NSLocalizedDescriptionKey: @"No promise combined with the any combinator has been fulfilled."
+                                                  }]];
             }
         }] progressed:^(float progress) {
             [deferred tryProgress:progress];
@@ -488,95 +1291,178 @@ static dispatch_queue_t globalDefaultQueue = nil;
     return deferred.promise;
 }
 
-+ (OMPromise *)all:(NSArray *)promises {
-    OMDeferred *deferred = [OMDeferred new];
++ (OMPromise *)anyCancellingOthers:(NSArray *)promises {
+    NSError *error = [NSError errorWithDomain:OMPromisesErrorDomain
+                                         code:OMPromisesCombinatorAnyNonFulfilledError
+                                     userInfo:@{
+                                         NSLocalizedDescriptionKey: @"No promise combined with the any combinator has been fulfilled."
+                                     }];
 
-    NSMutableArray *results = [NSMutableArray arrayWithCapacity:promises.count];
-    __block NSUInteger done = 0;
-    
-    void (^updateProgress)() = ^{
-        float sum = 0;
-        for (OMPromise *promise in promises) {
-            sum += promise.progress;
-        }
-        [deferred tryProgress:(sum / promises.count)];
-    };
+    if (promises.count == 0) {
+        return [OMPromise promiseWithError:error];
+    }
 
-    for (NSUInteger i = 0; i < promises.count; ++i) {
-        [results addObject:[NSNull null]];
-        [[[(OMPromise *)promises[i] fulfilled:^(id result) {
-            if (deferred.promise.state == OMPromiseStateUnfulfilled) {
-                updateProgress();
-                
-                if (result != nil) {
-                    results[i] = result;
-                }
+    return [OMPromise quorumOf:promises required:1 tolerated:promises.count - 1 error:error single:YES];
+}
+
++ (OMPromise *)race:(NSArray *)promises {
+    if (promises.count == 0) {
+        return [OMPromise promiseWithError:[NSError errorWithDomain:OMPromisesErrorDomain
+                                                               code:OMPromisesCombinatorRaceEmptyError
+                                                           userInfo:@{
+                                                               NSLocalizedDescriptionKey: @"There has been no promise to race."
+                                                           }]];
+    }
 
-                if (++done == promises.count) {
-                    [deferred tryFulfil:results];
+    return [OMPromise quorumOf:promises required:1 tolerated:0 error:nil single:YES];
+}
+
++ (OMPromise *)some:(NSArray *)promises count:(NSUInteger)count {
+    if (count == 0) {
+        return [OMPromise promiseWithResult:@[]];
+    }
+
+    NSError *error = [NSError errorWithDomain:OMPromisesErrorDomain
+                                         code:OMPromisesCombinatorSomeNotEnoughFulfilledError
+                                     userInfo:@{
+                                         NSLocalizedDescriptionKey: @"Not enough promises combined with the some combinator have been fulfilled."
+                                     }];
+
+    if (count > promises.count) {
+        return [OMPromise promiseWithError:error];
+    }
+
+    return [OMPromise quorumOf:promises required:count tolerated:promises.count - count error:error single:NO];
+}
+
++ (OMPromise *)quorumOf:(NSArray *)promises
+               required:(NSUInteger)required
+              tolerated:(NSUInteger)tolerated
+                  error:(NSError *)reason
+                 single:(BOOL)single
+{
+    OMDeferred *deferred = [OMDeferred new];
+    OMQuorum *quorum = [[OMQuorum alloc] initWithPromises:promises
+                                                 deferred:deferred
+                                                 required:required
+                                                tolerated:tolerated
+                                                    error:reason
+                                                   single:single];
+    OMQuorumReference *reference = quorum.reference;
+    [deferred.promise consumeAll:promises];
+
+    for (OMPromise *promise in promises) {
+        [[promise
+            always:^(OMPromiseState state, id result, NSError *error) {
+                OMQuorum *quorum = reference.quorum;
+                if (state == OMPromiseStateFulfilled) {
+                    [quorum fulfilled:result];
+                } else {
+                    [quorum failed:error];
                 }
-            }
-        }] failed:^(NSError *error) {
-            [deferred tryFail:error];
-        }] progressed:^(float progress) {
-            if (deferred.promise.state == OMPromiseStateUnfulfilled) {
-                updateProgress();
-            }
-        }];
+            }]
+            progressed:^(float progress) {
+                [reference.quorum progressed:progress];
+            }];
     }
 
+    return deferred.promise;
+}
+
++ (OMPromise *)all:(NSArray *)promises {
+    OMDeferred *deferred = [OMDeferred new];
+
     if (promises.count == 0) {
-        [deferred fulfil:results];
+        [deferred fulfil:@[]];
+        return deferred.promise;
     }
-    
+
+    OMAggregate *aggregate = [[OMAggregate alloc] initWithCount:promises.count];
+    [deferred.promise consumeAll:promises];
+
+    for (NSUInteger i = 0; i < promises.count; ++i) {
+        [[(OMPromise *)promises[i]
+            always:^(OMPromiseState state, id result, NSError *error) {
+                if (state == OMPromiseStateFailed) {
+                    [deferred tryFail:error];
+                } else if ([aggregate collect:result at:i]) {
+                    [deferred tryFulfil:aggregate.outcomes];
+                } else {
+                    [deferred tryProgress:[aggregate progress:1.f at:i]];
+                }
+            }]
+            progressed:^(float progress) {
+                [deferred tryProgress:[aggregate progress:progress at:i]];
+            }];
+    }
+
     return deferred.promise;
 }
 
 + (OMPromise *)collect:(NSArray *)promises {
     OMDeferred *deferred = [OMDeferred new];
-    
-    NSMutableArray *outcomes = [NSMutableArray arrayWithCapacity:promises.count];
-    __block NSUInteger collected = 0;
-    
-    void (^updateProgress)() = ^{
-        float sum = 0;
-        for (OMPromise *promise in promises) {
-            sum += (promise.state == OMPromiseStateUnfulfilled) ? promise.progress : 1.f;
-        }
-        [deferred tryProgress:(sum / promises.count)];
-    };
-    
-    void (^updateOutcomes)(NSUInteger, id) = ^(NSUInteger idx, id obj) {
-        if (obj != nil) {
-            outcomes[idx] = obj;
-        }
-        
-        if (++collected == promises.count) {
-            [deferred fulfil:outcomes];
-        } else {
-            updateProgress();
-        }
-    };
-    
+
+    if (promises.count == 0) {
+        [deferred fulfil:@[]];
+        return deferred.promise;
+    }
+
+    OMAggregate *aggregate = [[OMAggregate alloc] initWithCount:promises.count];
+    [deferred.promise consumeAll:promises];
+
     for (NSUInteger i = 0; i < promises.count; ++i) {
-        [outcomes addObject:[NSNull null]];
-        
-        [[[(OMPromise *)promises[i]
-            fulfilled:^(id result) {
-                updateOutcomes(i, result);
-            }]
-            failed:^(NSError *error) {
-                updateOutcomes(i, error);
+        [[(OMPromise *)promises[i]
+            always:^(OMPromiseState state, id result, NSError *error) {
+                if ([aggregate collect:(state == OMPromiseStateFulfilled ? result : error) at:i]) {
+                    [deferred tryFulfil:aggregate.outcomes];
+                } else {
+                    [deferred tryProgress:[aggregate progress:1.f at:i]];
+                }
             }]
             progressed:^(float progress) {
-                updateProgress();
+                [deferred tryProgress:[aggregate progress:progress at:i]];
             }];
     }
-    
-    if (promises.count == 0) {
-        [deferred fulfil:outcomes];
-    }
-    
+
+    return deferred.promise;
+}
+
++ (OMPromise *)map:(id<NSFastEnumeration>)collection
+       concurrency:(NSUInteger)concurrency
+              task:(OMPromise *(^)(id item))task
+{
+    return [OMPromise map:collection concurrency:concurrency task:task collect:YES];
+}
+
++ (OMPromise *)forEach:(id<NSFastEnumeration>)collection
+           concurrency:(NSUInteger)concurrency
+                  task:(OMPromise *(^)(id item))task
+{
+    return [OMPromise map:collection concurrency:concurrency task:task collect:NO];
+}
+
++ (OMPromise *)map:(id<NSFastEnumeration>)collection
+       concurrency:(NSUInteger)concurrency
+              task:(OMPromise *(^)(id item))task
+           collect:(BOOL)collect
+{
+    NSAssert(concurrency > 0, @"At least a single promise has to be in flight");
+
+    OMDeferred *deferred = [OMDeferred new];
+    OMBoundedMap *map = [[OMBoundedMap alloc] initWithCollection:collection
+                                                     concurrency:concurrency
+                                                            task:task
+                                                        deferred:deferred
+                                                         collect:collect];
+
+    // the promises in flight keep the state alive
+    __weak OMBoundedMap *weakMap = map;
+    [deferred.promise cancelled:^{
+        [weakMap cancel];
+    }];
+
+    [map pump];
+
     return deferred.promise;
 }
 
@@ -592,66 +1478,162 @@ static dispatch_queue_t globalDefaultQueue = nil;
     }];
 }
 
-#pragma mark - Testing
+- (OMPromise *)timeout:(NSTimeInterval)seconds {
+    OMDeferred *deferred = [OMDeferred new];
+    [deferred.promise inheritFrom:self];
+    [deferred.promise consume:self];
+    [self relay:deferred];
+
+    // neither keep the promises alive until the deadline, nor care if settled by then
+    __weak OMDeferred *weakDeferred = deferred;
+    __weak OMPromise *upstream = self;
+    [[OMTimerWheel sharedWheel] schedule:^{
+        if ([weakDeferred tryFail:[NSError errorWithDomain:OMPromisesErrorDomain
+                                                      code:OMPromisesTimeoutError
+                                                  userInfo:@{
+                                                      NSLocalizedDescriptionKey: @"The promise has timed out."
+                                                  }]]) {
+            [upstream cancelConsumer];
+        }
+    } after:seconds];
+
+    return deferred.promise;
+}
+
+- (OMPromise *)delay:(NSTimeInterval)seconds {
+    OMDeferred *deferred = [OMDeferred new];
+    [deferred.promise inheritFrom:self];
+    [deferred.promise consume:self];
+
+    [[self
+        always:^(OMPromiseState state, id result, NSError *error) {
+            [[OMTimerWheel sharedWheel] schedule:^{
+                if (state == OMPromiseStateFulfilled) {
+                    [deferred tryFulfil:result];
+                } else {
+                    [deferred tryFail:error];
+                }
+            } after:seconds];
+        } on:nil]
+        progressed:^(float progress) {
+            [deferred tryProgress:progress];
+        } on:nil];
+
+    return deferred.promise;
+}
+
+#pragma mark - Awaiting
+
+- (id)await:(NSError **)error {
+    return [self awaitWithin:-1. error:error];
+}
+
+- (id)awaitWithin:(NSTimeInterval)seconds error:(NSError **)error {
+    if ([self waitWithin:seconds] && self.state == OMPromiseStateFulfilled) {
+        return self.result;
+    }
+
+    if (error != NULL) {
+        *error = self.state == OMPromiseStateFailed
+            ? self.error
+            : [NSError errorWithDomain:OMPromisesErrorDomain
+                                  code:OMPromisesTimeoutError
+                              userInfo:@{
+                                  NSLocalizedDescriptionKey: @"The promise didn't settle in time."
+                              }];
+    }
+
+    return nil;
+}
+
++ (NSArray *)awaitAll:(NSArray *)promises error:(NSError **)error {
+    return [[OMPromise all:promises] await:error];
+}
+
+#pragma mark - Testing
+
+- (id)waitForResultWithin:(NSTimeInterval)seconds {
+    [self waitWithin:seconds];
+
+    if (self.state == OMPromiseStateFailed) {
+        @throw [NSException exceptionWithName:@"WaitingForFufilledPromise"
+                                       reason:[NSString stringWithFormat:@"Instead of getting fulfilled, the promise failed: %@",
+                                               self.error ? self.error : @"no error provided"]
+                                     userInfo:self.error ? @{NSUnderlyingErrorKey: self.error} : nil];
+    } else if (self.state == OMPromiseStateUnfulfilled) {
+        @throw [NSException exceptionWithName:@"WaitingForFufilledPromise"
+                                       reason:@"The promise didn't get fulfilled in time."
+                                     userInfo:nil];
+    }
+
+    return self.result;
+}
+
+- (NSError *)waitForErrorWithin:(NSTimeInterval)seconds {
+    [self waitWithin:seconds];
+
+    if (self.state == OMPromiseStateFulfilled) {
+        @throw [NSException exceptionWithName:@"WaitingForFailedPromise"
+                                       reason:[NSString stringWithFormat:@"Instead of failing, the promise got fulfilled: %@",
+                                               self.result]
+                                     userInfo:nil];
+    } else if (self.state == OMPromiseStateUnfulfilled) {
+        @throw [NSException exceptionWithName:@"WaitingForFailedPromise"
+                                       reason:@"The promise didn't fail in time."
+                                     userInfo:nil];
+    }
+
+    return self.error;
+}
+
+/** Blocks until the promise settled or the time is up, negative for infinity.
+
+ Threads are parked on a semaphore signalled by the settling thread. The main
+ thread keeps running its run loop instead, which gets stopped once settled.
+ */
+- (BOOL)waitWithin:(NSTimeInterval)seconds {
+    if (self.state != OMPromiseStateUnfulfilled) {
+        return YES;
+    }
+
+    if (![NSThread isMainThread]) {
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        [self always:^(OMPromiseState state, id result, NSError *error) {
+            dispatch_semaphore_signal(semaphore);
+        } on:nil];
 
-- (id)waitForResultWithin:(NSTimeInterval)seconds {
-    NSDate *start = [NSDate date];
-    
-    while (42) {
-        if (self.state == OMPromiseStateFulfilled) {
-            return self.result;
-        }
-        
-        if (self.state == OMPromiseStateFailed) {
-            @throw [NSException exceptionWithName:@"WaitingForFufilledPromise"
-                                           reason:[NSString stringWithFormat:@"Instead of getting fulfilled, the promise failed: %@",
-                                                   self.error ? self.error : @"no error provided"]
-                                         userInfo:self.error ? @{NSUnderlyingErrorKey: self.error} : nil];
-        }
-        
-        NSTimeInterval runtime = -start.timeIntervalSinceNow;
-        
-        if (seconds >= 0. && runtime > seconds) {
-            @throw [NSException exceptionWithName:@"WaitingForFufilledPromise"
-                                           reason:@"The promise didn't get fulfilled in time."
-                                         userInfo:nil];
-        }
-        
-        NSTimeInterval waiting = seconds >= 0. ? MIN(seconds - runtime, kTestingIntervalPrecision) : kTestingIntervalPrecision;
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:waiting]];
+        dispatch_time_t timeout = seconds >= 0. ? dispatch_time(DISPATCH_TIME_NOW, (int64_t)(seconds * NSEC_PER_SEC))
+                                                : DISPATCH_TIME_FOREVER;
+        return dispatch_semaphore_wait(semaphore, timeout) == 0;
     }
-    
-    return nil;
-}
 
-- (NSError *)waitForErrorWithin:(NSTimeInterval)seconds {
-    NSDate *start = [NSDate date];
-    
-    while (42) {
-        if (self.state == OMPromiseStateFailed) {
-            return self.error;
-        }
-        
-        if (self.state == OMPromiseStateFulfilled) {
-            @throw [NSException exceptionWithName:@"WaitingForFailedPromise"
-                                           reason:[NSString stringWithFormat:@"Instead of failing, the promise got fulfilled: %@",
-                                                   self.result]
-                                         userInfo:nil];
-        }
-        
-        NSTimeInterval runtime = -start.timeIntervalSinceNow;
-        
-        if (seconds >= 0. && runtime > seconds) {
-            @throw [NSException exceptionWithName:@"WaitingForFailedPromise"
-                                           reason:@"The promise didn't fail in time."
-                                         userInfo:nil];
+    // only touched on the main thread, a late stop must not hit an unrelated run
+    __block BOOL waiting = YES;
+    CFRunLoopRef runLoop = CFRunLoopGetCurrent();
+
+    [self always:^(OMPromiseState state, id result, NSError *error) {
+        CFRunLoopPerformBlock(runLoop, kCFRunLoopCommonModes, ^{
+            if (waiting) {
+                CFRunLoopStop(runLoop);
+            }
+        });
+        CFRunLoopWakeUp(runLoop);
+    } on:nil];
+
+    NSDate *deadline = seconds >= 0. ? [NSDate dateWithTimeIntervalSinceNow:seconds] : [NSDate distantFuture];
+
+    while (self.state == OMPromiseStateUnfulfilled) {
+        NSTimeInterval remaining = deadline.timeIntervalSinceNow;
+        if (remaining <= 0.) {
+            break;
         }
-        
-        NSTimeInterval waiting = seconds >= 0. ? MIN(seconds - runtime, kTestingIntervalPrecision) : kTestingIntervalPrecision;
-        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:waiting]];
+
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, MIN(remaining, kAwaitRunLoopInterval), false);
     }
-    
-    return nil;
+
+    waiting = NO;
+
+    return self.state != OMPromiseStateUnfulfilled;
 }
 
 #pragma mark - Private Helper Methods
@@ -677,17 +1659,30 @@ static dispatch_queue_t globalDefaultQueue = nil;
     }
     
     if ([next isKindOfClass:OMPromise.class]) {
-        return [[[(OMPromise *)next progressed:^(float progress) {
-            [deferred progress:bias + progress*fraction];
-        }] fulfilled:^(id result) {
-            [deferred fulfil:result];
-        }] failed:^(NSError *error) {
-            [deferred fail:error];
-        }];
+        OMPromise *promise = next;
+
+        // the returned promise is mostly settled already, no need to observe it then
+        switch (promise.state) {
+            case OMPromiseStateFulfilled:
+                [deferred tryFulfil:promise.result];
+                break;
+
+            case OMPromiseStateFailed:
+                [deferred tryProgress:bias + promise.progress*fraction];
+                [deferred tryFail:promise.error];
+                break;
+
+            default:
+                [promise addConsumer];
+                [deferred.promise adopt:promise offset:bias scale:fraction];
+                break;
+        }
+
+        return promise;
     } else if ([next isKindOfClass:NSError.class]) {
-        [deferred fail:next];
+        [deferred tryFail:next];
     } else {
-        [deferred fulfil:next];
+        [deferred tryFulfil:next];
     }
     
     return nil;
@@ -725,10 +1720,632 @@ static dispatch_queue_t globalDefaultQueue = nil;
 }
 
 - (void)cleanup {
-    self.fulfilHandlers = nil;
-    self.failHandlers = nil;
-    self.progressHandlers = nil;
-    self.cancelHandlers = nil;
+    // nothing to release by default, the continuations are retired on their own
+}
+
+- (void)inheritFrom:(OMPromise *)promise {
+    self.tracksProgress = promise.tracksProgress;
+    self.progressInterval = promise.progressInterval;
+    self.progressGranularity = promise.progressGranularity;
+}
+
+#pragma mark - Continuations
+
+- (BOOL)addContinuation:(OMContinuation)continuation {
+    if (continuation.type != OMPromiseHandlerCancelled) {
+        [self willAddContinuation];
+    }
+
+    OMContinuation *head = atomic_load_explicit(&_continuations, memory_order_acquire);
+    if (head == kAdoptedContinuations) {
+        return [self addAdoptedContinuation:continuation];
+    }
+
+    float progress = self.progress;
+    if (progress > FLT_EPSILON && self.tracksProgress) {
+        OMContinuation *current = &continuation;
+        [self deliver:OMPromiseHandlerProgressed to:&current count:1 value:nil progress:progress];
+    }
+
+    OMContinuation *pushed = NULL;
+
+    if (head != kSealedContinuations) {
+        pushed = [self claimContinuation];
+        BOOL inlined = pushed->inlined;
+        *pushed = continuation;
+        pushed->inlined = inlined;
+
+        do {
+            if (head == kSealedContinuations || head == kAdoptedContinuations) {
+                break;
+            }
+            pushed->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&_continuations, &head, pushed,
+                                                        memory_order_release, memory_order_acquire));
+
+        if (head == kAdoptedContinuations) {
+            OMContinuation adopted = *pushed;
+            if (!pushed->inlined) {
+                free(pushed);
+            }
+            return [self addAdoptedContinuation:adopted];
+        } else if (head != kSealedContinuations) {
+            return YES;
+        }
+    }
+
+    // the promise has been resolved in the meantime, deliver the outcome right away
+    OMContinuation *resolved = pushed ? pushed : &continuation;
+    OMPromiseState state = self.state;
+
+    if (state == OMPromiseStateFulfilled) {
+        [self deliver:OMPromiseHandlerFulfilled to:&resolved count:1 value:self.result progress:1.f];
+    } else if (state == OMPromiseStateFailed) {
+        [self deliver:OMPromiseHandlerFailed to:&resolved count:1 value:self.error progress:self.progress];
+    }
+
+    // only claimed records live on the heap, the parameter itself only holds references
+    if (pushed) {
+        pushed->next = NULL;
+        OMContinuationFree(pushed);
+    } else {
+        OMContinuationRelease(&continuation);
+    }
+
+    return NO;
+}
+
+- (BOOL)addAdoptedContinuation:(OMContinuation)continuation {
+    OMPromise *adopted = nil;
+
+    @synchronized (self) {
+        if (_adoptedHandlers != kSealedContinuations) {
+            // keep a copy, in case the receiver settles on its own
+            if (continuation.origin == NULL) {
+                OMContinuation *copy = malloc(sizeof(OMContinuation));
+                *copy = OMContinuationCopy(&continuation);
+                copy->next = _adoptedHandlers;
+                _adoptedHandlers = copy;
+
+                continuation.origin = (__bridge_retained void *)_adoption;
+            }
+
+            adopted = _adopted;
+            OMContinuationCompose(&continuation, _adoptedOffset, _adoptedScale);
+        }
+    }
+
+    // the receiver settled in the meantime, the handler is called right away
+    if (adopted == nil) {
+        return [self addContinuation:continuation];
+    }
+
+    return [adopted addContinuation:continuation];
+}
+
+/** Let the receiver follow the outcome of the supplied promise.
+
+ All handlers are moved over to the adopted promise and further ones are registered
+ there right away. The receiver itself is only referenced weakly, such that long
+ recursive chains of adopting promises don't grow in memory.
+
+ The receiver keeps copies of its own handlers though, to settle them itself once it
+ gets cancelled before the adopted promise settles.
+ */
+- (void)adopt:(OMPromise *)promise offset:(float)offset scale:(float)scale {
+    OMPromiseReference *reference = [OMPromiseReference new];
+    reference.promise = self;
+
+    OMContinuation *continuations = NULL;
+
+    @synchronized (self) {
+        _adopted = promise;
+        _adoptedOffset = offset;
+        _adoptedScale = scale;
+        _adoption = reference;
+
+        continuations = atomic_load_explicit(&_continuations, memory_order_acquire);
+        do {
+            if (continuations == kSealedContinuations) {
+                return;
+            }
+        } while (!atomic_compare_exchange_weak(&_continuations, &continuations, kAdoptedContinuations));
+
+        // settling on its own, e.g., by getting cancelled, the receiver calls its handlers itself
+        _adoptedHandlers = OMContinuationsCopyOwn(continuations);
+    }
+
+    // the receiver is settled first, as it was prior to calling its handlers before
+    OMContinuation forward = OMContinuationMake(OMPromiseHandlerForward, reference, nil, nil);
+    forward.offset = offset;
+    forward.scale = scale;
+    [promise addContinuation:forward];
+
+    OMContinuation *buffer[kContinuationBufferSize];
+    size_t count = 0;
+    OMContinuation **ordered = OMContinuationsInOrder(continuations, buffer, &count);
+
+    for (size_t i = 0; i < count; ++i) {
+        OMContinuation continuation = OMContinuationCopy(ordered[i]);
+        OMContinuationCompose(&continuation, offset, scale);
+
+        if (continuation.origin == NULL) {
+            continuation.origin = (__bridge_retained void *)reference;
+        }
+
+        if (continuation.type == OMPromiseHandlerForward) {
+            OMPromise *adopter = ((__bridge OMPromiseReference *)continuation.handler).promise;
+
+            if (adopter == nil) {
+                OMContinuationRelease(&continuation);
+                continue;
+            }
+
+            // skip the receiver for promises that adopted it before
+            @synchronized (adopter) {
+                adopter->_adopted = promise;
+                adopter->_adoptedOffset = continuation.offset;
+                adopter->_adoptedScale = continuation.scale;
+            }
+        }
+
+        [promise addContinuation:continuation];
+    }
+
+    if (ordered != buffer) {
+        free(ordered);
+    }
+
+    [self retireContinuations:continuations];
+}
+
+- (OMContinuation *)claimContinuation {
+    unsigned claims = atomic_load_explicit(&_inlineClaims, memory_order_relaxed);
+
+    for (unsigned i = 0; i < kInlineContinuations; ++i) {
+        unsigned slot = 1u << i;
+
+        if ((claims & slot) == 0) {
+            claims = atomic_fetch_or_explicit(&_inlineClaims, slot, memory_order_relaxed);
+
+            if ((claims & slot) == 0) {
+                _inlineContinuations[i].inlined = YES;
+                return &_inlineContinuations[i];
+            }
+        }
+    }
+
+    OMContinuation *continuation = malloc(sizeof(OMContinuation));
+    continuation->inlined = NO;
+    return continuation;
+}
+
+static void OMContinuationCall(OMPromiseHandler type, id handler, OMDeferred *deferred, float bias, float fraction,
+                               OMPromiseHandler event, id value, float progress)
+{
+    switch (type) {
+        case OMPromiseHandlerFulfilled:
+        case OMPromiseHandlerFailed:
+            ((void (^)(id))handler)(value);
+            break;
+
+        case OMPromiseHandlerProgressed:
+            ((void (^)(float))handler)(progress);
+            break;
+
+        case OMPromiseHandlerAlways:
+            if (event == OMPromiseHandlerFulfilled) {
+                ((void (^)(OMPromiseState, id, NSError *))handler)(OMPromiseStateFulfilled, value, nil);
+            } else {
+                ((void (^)(OMPromiseState, id, NSError *))handler)(OMPromiseStateFailed, nil, value);
+            }
+            break;
+
+        case OMPromiseHandlerCancelled:
+            ((void (^)())handler)();
+            break;
+
+        case OMPromiseHandlerThen:
+            // the derived promise might have been cancelled in the meantime
+            if (deferred.promise.state != OMPromiseStateUnfulfilled) {
+                break;
+            } else if (event == OMPromiseHandlerProgressed) {
+                [deferred tryProgress:progress];
+            } else if (event == OMPromiseHandlerFailed) {
+                [deferred tryFail:value];
+            } else {
+                [OMPromise bind:deferred with:handler using:value bias:bias fraction:fraction];
+            }
+            break;
+
+        case OMPromiseHandlerRescue:
+            if (deferred.promise.state != OMPromiseStateUnfulfilled) {
+                break;
+            } else if (event == OMPromiseHandlerProgressed) {
+                [deferred tryProgress:progress];
+            } else if (event == OMPromiseHandlerFulfilled) {
+                [deferred tryFulfil:value];
+            } else {
+                [OMPromise bind:deferred with:handler using:value bias:progress fraction:1.f - progress];
+            }
+            break;
+
+        case OMPromiseHandlerForward: {
+            OMPromise *promise = ((OMPromiseReference *)handler).promise;
+
+            if (event == OMPromiseHandlerProgressed) {
+                [promise tryProgress:progress];
+            } else if (event == OMPromiseHandlerFulfilled) {
+                [promise tryFulfil:value];
+            } else {
+                [promise tryFail:value];
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static void OMRunBatch(OMDeliveryBatch *batch) {
+    id value = (__bridge_transfer id)batch->value;
+
+    for (size_t i = 0; i < batch->count; ++i) {
+        OMDelivery *delivery = &batch->deliveries[i];
+        id handler = (__bridge_transfer id)delivery->handler;
+        OMDeferred *deferred = (__bridge_transfer OMDeferred *)delivery->deferred;
+
+        OMContinuationCall(delivery->type, handler, deferred, delivery->bias, delivery->fraction,
+                           batch->event, value, delivery->progress);
+    }
+
+    free(batch);
+}
+
+static OMTrampoline *OMCurrentTrampoline(void) {
+    [OMPromise immediateQueue];
+
+    OMTrampoline *trampoline = pthread_getspecific(trampolineKey);
+    if (trampoline == NULL) {
+        trampoline = calloc(1, sizeof(OMTrampoline));
+        pthread_setspecific(trampolineKey, trampoline);
+    }
+
+    return trampoline;
+}
+
+static void OMTrampolineRun(OMTrampoline *trampoline, OMDeliveryBatch *batch) {
+    batch->next = NULL;
+
+    if (trampoline->running) {
+        if (trampoline->tail != NULL) {
+            trampoline->tail->next = batch;
+        } else {
+            trampoline->head = batch;
+        }
+        trampoline->tail = batch;
+        return;
+    }
+
+    trampoline->running = YES;
+
+    while (batch != NULL) {
+        OMRunBatch(batch);
+
+        batch = trampoline->head;
+        if (batch != NULL) {
+            trampoline->head = batch->next;
+            if (trampoline->head == NULL) {
+                trampoline->tail = NULL;
+            }
+        }
+    }
+
+    trampoline->running = NO;
+}
+
+static void OMDeliverBatch(void *context) {
+    OMDeliveryBatch *batch = context;
+    OMTrampoline *trampoline = OMCurrentTrampoline();
+
+    // a nested run loop might call us while running another batch, start afresh
+    OMTrampoline outer = *trampoline;
+    *trampoline = (OMTrampoline) { .queue = batch->queue };
+
+    OMTrampolineRun(trampoline, batch);
+
+    *trampoline = outer;
+}
+
+- (void)deliver:(OMPromiseHandler)event
+             to:(OMContinuation **)continuations
+          count:(size_t)count
+          value:(id)value
+       progress:(float)progress
+{
+    OMDeliveryGroup buffer[kContinuationBufferSize];
+    OMDeliveryGroup *groups = count <= kContinuationBufferSize ? buffer : malloc(count * sizeof(OMDeliveryGroup));
+    size_t groupCount = 0;
+
+    // size the batch of each queue upfront, there are usually only a few distinct queues
+    for (size_t i = 0; i < count; ++i) {
+        OMContinuation *continuation = continuations[i];
+
+        if (OMContinuationObserves(continuation, event) && OMContinuationClaims(continuation, event) &&
+            OMContinuationDispatches(continuation, event))
+        {
+            size_t j = 0;
+            while (j < groupCount && groups[j].queue != continuation->queue) {
+                j += 1;
+            }
+
+            if (j == groupCount) {
+                groups[groupCount++] = (OMDeliveryGroup) { .queue = continuation->queue, .size = 0, .batch = NULL };
+            }
+            groups[j].size += 1;
+        }
+    }
+
+    for (size_t j = 0; j < groupCount; ++j) {
+        OMDeliveryBatch *batch = malloc(sizeof(OMDeliveryBatch) + groups[j].size * sizeof(OMDelivery));
+        batch->queue = groups[j].queue;
+        batch->value = (__bridge_retained void *)value;
+        batch->event = event;
+        batch->count = 0;
+        groups[j].batch = batch;
+    }
+
+    // call immediate handlers right away and fill the batches in registration order
+    for (size_t i = 0; i < count; ++i) {
+        OMContinuation *continuation = continuations[i];
+
+        if (!OMContinuationObserves(continuation, event) || !OMContinuationClaims(continuation, event)) {
+            continue;
+        }
+
+        float observed = continuation->offset + progress * continuation->scale;
+
+        if (!OMContinuationDispatches(continuation, event)) {
+            OMContinuationCall(continuation->type, (__bridge id)continuation->handler,
+                               (__bridge OMDeferred *)continuation->deferred, continuation->bias,
+                               continuation->fraction, event, value, observed);
+            continue;
+        }
+
+        size_t j = 0;
+        while (groups[j].queue != continuation->queue) {
+            j += 1;
+        }
+
+        OMDeliveryBatch *batch = groups[j].batch;
+        batch->deliveries[batch->count++] = (OMDelivery) {
+            .type = continuation->type,
+            .handler = (__bridge_retained void *)(__bridge id)continuation->handler,
+            .deferred = (__bridge_retained void *)(__bridge id)continuation->deferred,
+            .bias = continuation->bias,
+            .fraction = continuation->fraction,
+            .progress = observed
+        };
+    }
+
+    OMTrampoline *trampoline = groupCount > 0 ? OMCurrentTrampoline() : NULL;
+
+    for (size_t j = 0; j < groupCount; ++j) {
+        void *queue = groups[j].queue;
+
+        // executors decide on their own where to run, e.g., on the very same thread
+        if (queue == (__bridge void *)immediateQueue ||
+            (queue == trampoline->queue && !dispatch_queue_get_specific((__bridge dispatch_queue_t)queue, kExecutorKey)))
+        {
+            OMTrampolineRun(trampoline, groups[j].batch);
+        } else {
+            OMDispatch((__bridge dispatch_queue_t)queue, groups[j].batch, OMDeliverBatch);
+        }
+    }
+
+    if (groups != buffer) {
+        free(groups);
+    }
+}
+
+- (BOOL)resolveWithState:(OMPromiseState)state result:(id)result error:(NSError *)error cancelled:(BOOL)cancelled {
+    OMPromiseState expected = OMPromiseStateUnfulfilled;
+
+    // only a single caller wins the transition, everybody else observes a settled promise
+    if (!atomic_compare_exchange_strong_explicit(&_state, &expected, OMPromiseStateResolving,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+        return NO;
+    }
+
+    if (state == OMPromiseStateFulfilled) {
+        [self updateProgress:1.f];
+    }
+
+    _result = result;
+    _error = error;
+    atomic_store_explicit(&_state, state, memory_order_release);
+
+    OMContinuation *continuations = atomic_exchange(&_continuations, kSealedContinuations);
+    if (continuations == kAdoptedContinuations) {
+        continuations = [self takeAdoptedHandlers];
+    }
+
+    OMContinuation *buffer[kContinuationBufferSize];
+    size_t count = 0;
+    OMContinuation **ordered = OMContinuationsInOrder(continuations, buffer, &count);
+
+    if (cancelled) {
+        [self deliver:OMPromiseHandlerCancelled to:ordered count:count value:nil progress:0.f];
+        [_upstream cancelConsumer];
+    }
+
+    if (state == OMPromiseStateFulfilled) {
+        [self deliver:OMPromiseHandlerFulfilled to:ordered count:count value:result progress:1.f];
+    } else {
+        [self deliver:OMPromiseHandlerFailed to:ordered count:count value:error progress:self.progress];
+    }
+
+    if (ordered != buffer) {
+        free(ordered);
+    }
+
+    [self retireContinuations:continuations];
+    [self cleanup];
+
+    return YES;
+}
+
+/** Takes the handlers moved over to the adopted promise back, unless it claimed them
+ while settling already.
+ */
+- (OMContinuation *)takeAdoptedHandlers {
+    OMContinuation *handlers = NULL;
+    OMPromiseReference *adoption = nil;
+
+    @synchronized (self) {
+        handlers = _adoptedHandlers;
+        adoption = _adoption;
+        _adoptedHandlers = kSealedContinuations;
+    }
+
+    if (![adoption detach]) {
+        OMContinuationFree(handlers);
+        return NULL;
+    }
+
+    return handlers;
+}
+
+- (BOOL)updateProgress:(float)progress {
+    progress = MIN(1.f, progress);
+
+    float current = atomic_load_explicit(&_progress, memory_order_relaxed);
+    do {
+        if (current >= progress - FLT_EPSILON) {
+            return NO;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&_progress, &current, progress,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+
+    if (self.tracksProgress && [self shouldDeliverProgress:progress]) {
+        [self deliverProgress:progress];
+    }
+
+    return YES;
+}
+
+- (BOOL)shouldDeliverProgress:(float)progress {
+    if (progress >= 1.f) {
+        return YES;
+    }
+
+    float delivered = atomic_load_explicit(&_deliveredProgress, memory_order_relaxed);
+    if (self.progressGranularity > 0. && progress - delivered < self.progressGranularity) {
+        return NO;
+    }
+
+    if (self.progressInterval > 0.) {
+        CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+        CFAbsoluteTime due = atomic_load_explicit(&_deliveredProgressAt, memory_order_relaxed) + self.progressInterval;
+
+        if (now < due) {
+            [self scheduleProgressFlushIn:due - now];
+            return NO;
+        }
+
+        atomic_store_explicit(&_deliveredProgressAt, now, memory_order_relaxed);
+    }
+
+    return YES;
+}
+
+/** Delivers the most recent progress once the current interval elapsed, unless
+ somebody else did so in the meantime.
+ */
+- (void)scheduleProgressFlushIn:(NSTimeInterval)delay {
+    if (atomic_exchange(&_progressFlushScheduled, YES)) {
+        return;
+    }
+
+    __weak OMPromise *weakSelf = self;
+    [[OMTimerWheel sharedWheel] schedule:^{
+        OMPromise *promise = weakSelf;
+        if (promise == nil) {
+            return;
+        }
+
+        atomic_store(&promise->_progressFlushScheduled, NO);
+
+        if (promise.state == OMPromiseStateUnfulfilled) {
+            atomic_store_explicit(&promise->_deliveredProgressAt, CFAbsoluteTimeGetCurrent(), memory_order_relaxed);
+            [promise deliverProgress:promise.progress];
+        }
+    } after:delay];
+}
+
+/** Calls the progress handlers, unless a more recent progress got delivered already.
+ */
+- (void)deliverProgress:(float)progress {
+    float delivered = atomic_load_explicit(&_deliveredProgress, memory_order_relaxed);
+    do {
+        if (delivered >= progress) {
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&_deliveredProgress, &delivered, progress,
+                                                    memory_order_relaxed, memory_order_relaxed));
+
+    // walkers keep stolen continuations alive until they are done with them
+    atomic_fetch_add(&_walkers, 1);
+
+    OMContinuation *continuations = atomic_load(&_continuations);
+    if (continuations != kSealedContinuations && continuations != kAdoptedContinuations) {
+        OMContinuation *buffer[kContinuationBufferSize];
+        size_t count = 0;
+        OMContinuation **ordered = OMContinuationsInOrder(continuations, buffer, &count);
+
+        [self deliver:OMPromiseHandlerProgressed to:ordered count:count value:nil progress:progress];
+
+        if (ordered != buffer) {
+            free(ordered);
+        }
+    }
+
+    if (atomic_fetch_sub(&_walkers, 1) == 1 && atomic_load(&_retiredContinuations) != NULL) {
+        [self reclaimContinuations];
+    }
+}
+
+- (void)retireContinuations:(OMContinuation *)continuations {
+    if (continuations == NULL) {
+        return;
+    }
+
+    // nobody is able to reach stolen continuations anymore, unless he started walking before
+    if (atomic_load(&_walkers) == 0) {
+        OMContinuationFree(continuations);
+        return;
+    }
+
+    OMRetiredContinuations *retired = malloc(sizeof(OMRetiredContinuations));
+    retired->continuations = continuations;
+    retired->next = atomic_load_explicit(&_retiredContinuations, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak(&_retiredContinuations, &retired->next, retired));
+
+    if (atomic_load(&_walkers) == 0) {
+        [self reclaimContinuations];
+    }
+}
+
+- (void)reclaimContinuations {
+    OMRetiredContinuations *retired = atomic_exchange(&_retiredContinuations, NULL);
+
+    while (retired != NULL) {
+        OMRetiredContinuations *next = retired->next;
+        OMContinuationFree(retired->continuations);
+        free(retired);
+        retired = next;
+    }
 }
 
 #pragma mark - NSObject Overrides
@@ -0,0 +1,125 @@
+//
+// OMPromiseCache.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "OMPromise.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** Memoizes the promises of asynchronous operations by key.
+
+ Concurrent lookups of the same key share a single operation: the task supplied
+ along promiseForKey:task: is only called if there is neither a cached result nor
+ an operation in flight for the key. Each caller gets a promise of its own, the
+ shared operation is only cancelled once all of them got cancelled.
+
+ Results are kept for timeToLive seconds after their promise got fulfilled,
+ failures for failureTimeToLive seconds. If countLimit or totalCostLimit is
+ exceeded, the least recently used entries are evicted.
+ */
+@interface OMPromiseCache<KeyType, ResultType> : NSObject
+
+///---------------------------------------------------------------------------------------
+/// @name Limits
+///---------------------------------------------------------------------------------------
+
+/** Seconds a result is kept once its promise got fulfilled.
+
+ Defaults to DBL_MAX, i.e., results never expire. Use 0 to share operations in
+ flight only.
+ */
+@property(assign) NSTimeInterval timeToLive;
+
+/** Seconds a failure is kept once its promise failed.
+
+ Defaults to 0, i.e., the next lookup retries right away. Cancelled operations
+ are never kept.
+ */
+@property(assign) NSTimeInterval failureTimeToLive;
+
+/** Maximum number of entries, 0 meaning no limit. Defaults to 0.
+ */
+@property(assign) NSUInteger countLimit;
+
+/** Maximum total cost of all entries, 0 meaning no limit. Defaults to 0.
+ */
+@property(assign) NSUInteger totalCostLimit;
+
+/** Determines the cost of a result once its promise got fulfilled.
+
+ Entries cost 1 if not specified otherwise.
+ */
+@property(copy, nullable) NSUInteger (^costOfResult)(ResultType _Nullable result);
+
+/** The number of entries, including those in flight.
+ */
+@property(readonly) NSUInteger count;
+
+/** The total cost of all entries.
+ */
+@property(readonly) NSUInteger totalCost;
+
+///---------------------------------------------------------------------------------------
+/// @name Lookup
+///---------------------------------------------------------------------------------------
+
+/** Get the promise cached for the key, without starting any operation.
+
+ @param key The key to look up.
+ @return A promise, possibly still unfulfilled, or nil if there is no valid entry.
+ */
+- (nullable OMPromise<ResultType> *)promiseForKey:(KeyType<NSCopying>)key;
+
+/** Get the promise cached for the key, or start a new operation.
+
+ The task is called synchronously on the calling thread, but outside of any lock,
+ thus it might use the cache itself.
+
+ @param key The key to look up.
+ @param task Starts the operation, called only if there is no valid entry.
+ @return A promise representing the outcome of the shared operation.
+ */
+- (OMPromise<ResultType> *)promiseForKey:(KeyType<NSCopying>)key task:(OMPromise<ResultType> *(^)(void))task;
+
+///---------------------------------------------------------------------------------------
+/// @name Invalidation
+///---------------------------------------------------------------------------------------
+
+/** Remove the entry of the key.
+
+ Operations in flight aren't cancelled, but later lookups no longer share them.
+
+ @param key The key to remove.
+ */
+- (void)invalidateKey:(KeyType<NSCopying>)key;
+
+/** Remove all entries.
+ */
+- (void)invalidateAll;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,293 @@
+//
+// OMPromiseCache.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMPromiseCache.h"
+
+#import "OMDeferred.h"
+#import "OMPromise+Internal.h"
+
+/** A cached promise, linked into the list of entries ordered by recent use.
+ */
+@interface OMPromiseCacheEntry : NSObject
+
+@property(nonatomic) id<NSCopying> key;
+@property(nonatomic) OMPromise *promise;
+@property(assign, nonatomic) NSUInteger cost;
+/** Uptime after which the entry is stale, DBL_MAX while in flight. */
+@property(assign, nonatomic) NSTimeInterval expires;
+
+@property(nonatomic) OMPromiseCacheEntry *next;
+@property(unsafe_unretained, nonatomic) OMPromiseCacheEntry *previous;
+
+@end
+
+@implementation OMPromiseCacheEntry
+@end
+
+@implementation OMPromiseCache {
+    NSMutableDictionary *_entries;
+    /** Most recently used entry. */
+    OMPromiseCacheEntry *_head;
+    /** Least recently used entry. */
+    OMPromiseCacheEntry *_tail;
+    NSUInteger _totalCost;
+}
+
+#pragma mark - Init
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _entries = [NSMutableDictionary dictionary];
+        _timeToLive = DBL_MAX;
+    }
+    return self;
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)count {
+    @synchronized (self) {
+        return _entries.count;
+    }
+}
+
+- (NSUInteger)totalCost {
+    @synchronized (self) {
+        return _totalCost;
+    }
+}
+
+#pragma mark - Lookup
+
+- (OMPromise *)promiseForKey:(id<NSCopying>)key {
+    OMPromiseCacheEntry *entry = nil;
+
+    @synchronized (self) {
+        entry = [self validEntryForKey:key];
+    }
+
+    return entry ? [self shareEntry:entry] : nil;
+}
+
+- (OMPromise *)promiseForKey:(id<NSCopying>)key task:(OMPromise *(^)(void))task {
+    OMPromiseCacheEntry *entry = nil;
+    OMDeferred *deferred = nil;
+
+    @synchronized (self) {
+        entry = [self validEntryForKey:key];
+
+        if (entry == nil) {
+            deferred = [OMDeferred new];
+
+            entry = [OMPromiseCacheEntry new];
+            entry.key = key;
+            entry.promise = deferred.promise;
+            entry.cost = 1;
+            entry.expires = DBL_MAX;
+
+            _entries[key] = entry;
+            [self insertEntry:entry];
+            _totalCost += entry.cost;
+            [self trim];
+        }
+    }
+
+    // hand out the promise first, the task might settle right away
+    OMPromise *promise = [self shareEntry:entry];
+
+    if (deferred != nil) {
+        __weak OMPromiseCache *weakSelf = self;
+        [entry.promise always:^(OMPromiseState state, id result, NSError *error) {
+            [weakSelf settleEntry:entry];
+        } on:nil];
+
+        OMPromise *operation = task();
+        NSAssert(operation != nil, @"The task has to return a promise");
+
+        [deferred.promise consume:operation];
+        [self follow:operation with:deferred];
+    }
+
+    return promise;
+}
+
+#pragma mark - Invalidation
+
+- (void)invalidateKey:(id<NSCopying>)key {
+    @synchronized (self) {
+        OMPromiseCacheEntry *entry = _entries[key];
+        if (entry != nil) {
+            [self removeEntry:entry];
+        }
+    }
+}
+
+- (void)invalidateAll {
+    @synchronized (self) {
+        // break the links one by one, releasing a long list at once would recurse
+        while (_head != nil) {
+            OMPromiseCacheEntry *next = _head.next;
+            _head.next = nil;
+            _head = next;
+        }
+
+        [_entries removeAllObjects];
+        _tail = nil;
+        _totalCost = 0;
+    }
+}
+
+#pragma mark - Private Methods
+
+/** The entry of the key, unless it is stale. Marks the entry as recently used.
+ */
+- (OMPromiseCacheEntry *)validEntryForKey:(id<NSCopying>)key {
+    OMPromiseCacheEntry *entry = _entries[key];
+
+    if (entry != nil && entry.expires <= [NSProcessInfo processInfo].systemUptime) {
+        [self removeEntry:entry];
+        entry = nil;
+    }
+
+    if (entry != nil && entry != _head) {
+        [self unlinkEntry:entry];
+        [self insertEntry:entry];
+    }
+
+    return entry;
+}
+
+/** A promise of its own for the caller, such that cancelling it only affects the
+ shared operation once all callers cancelled.
+ */
+- (OMPromise *)shareEntry:(OMPromiseCacheEntry *)entry {
+    OMPromise *promise = entry.promise;
+
+    if (promise.state != OMPromiseStateUnfulfilled) {
+        return promise;
+    }
+
+    OMDeferred *deferred = [OMDeferred new];
+    [deferred.promise inheritFrom:promise];
+    [deferred.promise consume:promise];
+    [self follow:promise with:deferred];
+
+    return deferred.promise;
+}
+
+/** Like relay:, but without going through the default queue of the promise.
+ */
+- (void)follow:(OMPromise *)promise with:(OMDeferred *)deferred {
+    [[promise
+        always:^(OMPromiseState state, id result, NSError *error) {
+            if (state == OMPromiseStateFulfilled) {
+                [deferred tryFulfil:result];
+            } else {
+                [deferred tryFail:error];
+            }
+        } on:nil]
+        progressed:^(float progress) {
+            [deferred tryProgress:progress];
+        } on:nil];
+}
+
+/** Determines how long and at which cost the outcome of the entry is kept.
+ */
+- (void)settleEntry:(OMPromiseCacheEntry *)entry {
+    OMPromise *promise = entry.promise;
+    NSUInteger (^costOfResult)(id) = self.costOfResult;
+    NSUInteger cost = costOfResult && promise.state == OMPromiseStateFulfilled ? costOfResult(promise.result) : 1;
+
+    @synchronized (self) {
+        // invalidated or evicted in the meantime
+        if (_entries[entry.key] != entry) {
+            return;
+        }
+
+        NSTimeInterval timeToLive = promise.state == OMPromiseStateFulfilled ? _timeToLive : _failureTimeToLive;
+        BOOL cancelled = [promise.error.domain isEqualToString:OMPromisesErrorDomain] &&
+            promise.error.code == OMPromisesCancelledError;
+
+        if (timeToLive <= 0 || cancelled) {
+            [self removeEntry:entry];
+            return;
+        }
+
+        NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+        entry.expires = timeToLive >= DBL_MAX - now ? DBL_MAX : now + timeToLive;
+
+        _totalCost = _totalCost - entry.cost + cost;
+        entry.cost = cost;
+        [self trim];
+    }
+}
+
+/** Evicts the least recently used entries until the limits are met.
+ */
+- (void)trim {
+    while (_tail != nil && ((_countLimit > 0 && _entries.count > _countLimit) ||
+                            (_totalCostLimit > 0 && _totalCost > _totalCostLimit)))
+    {
+        [self removeEntry:_tail];
+    }
+}
+
+- (void)removeEntry:(OMPromiseCacheEntry *)entry {
+    // the dictionary might hold the last reference
+    _totalCost -= entry.cost;
+    [self unlinkEntry:entry];
+    [_entries removeObjectForKey:entry.key];
+}
+
+- (void)insertEntry:(OMPromiseCacheEntry *)entry {
+    entry.previous = nil;
+    entry.next = _head;
+    _head.previous = entry;
+    _head = entry;
+
+    if (_tail == nil) {
+        _tail = entry;
+    }
+}
+
+- (void)unlinkEntry:(OMPromiseCacheEntry *)entry {
+    if (entry.previous != nil) {
+        entry.previous.next = entry.next;
+    } else {
+        _head = entry.next;
+    }
+
+    if (entry.next != nil) {
+        entry.next.previous = entry.previous;
+    } else {
+        _tail = entry.previous;
+    }
+
+    entry.previous = nil;
+    entry.next = nil;
+}
+
+@end
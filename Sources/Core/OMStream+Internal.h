@@ -0,0 +1,45 @@
+//
+// OMStream+Internal.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMStream.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface OMStream<__covariant ValueType> (Internal)
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+@property(readonly, nonatomic) NSUInteger demand;
+
+- (BOOL)push:(nullable id)value;
+- (void)complete;
+- (void)fail:(nullable NSError *)error;
+
+- (void)requested:(void (^)(NSUInteger count))requestHandler;
+- (void)cancelled:(void (^)(void))cancelHandler;
+
+@end
+
+NS_ASSUME_NONNULL_END
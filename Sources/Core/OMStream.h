@@ -0,0 +1,159 @@
+//
+// OMStream.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "OMPromise.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** OMStream proxies a sequence of values produced asynchronously, followed by either
+ its completion or a failure.
+
+ In contrast to OMPromise, a stream is consumed by a single consumer only, which
+ registers its block using values:. Values are only delivered on demand, i.e., the
+ consumer has to request: the number of values it is able to handle. Values produced
+ ahead of demand are kept in a bounded buffer, thus a producer can never outrun a slow
+ consumer. The producing side is controlled using an OMDeferredStream.
+
+ Once all values have been delivered, the completion promise gets fulfilled. If the
+ stream fails, remaining values are dropped and the completion promise fails.
+
+ The operators map:, filter:, buffer: and flatMap:concurrency: create new streams
+ which forward the demand of their consumer to the receiver. collect and
+ reduce:initial: consume the whole stream and bridge it back to OMPromise.
+ */
+@interface OMStream<__covariant ValueType> : NSObject
+
+///---------------------------------------------------------------------------------------
+/// @name Current state
+///---------------------------------------------------------------------------------------
+
+/** Gets fulfilled with nil once all values have been delivered, or fails along with
+ the stream.
+ */
+@property(readonly, nonatomic) OMPromise *completion;
+
+///---------------------------------------------------------------------------------------
+/// @name Consuming values
+///---------------------------------------------------------------------------------------
+
+/** Register the block to be called for each value.
+
+ Only a single block can be registered per stream. Values are delivered one after
+ another, as long as there is demand.
+
+ @param valueHandler The block to call for each value.
+ @return The stream itself.
+ @see values:on:
+ */
+- (instancetype)values:(void (^)(ValueType _Nullable value))valueHandler;
+
+/** Similar to values:, but calls the block on the specified queue.
+
+ @param valueHandler The block to call for each value.
+ @param queue A serial queue to call the block on, nil to call it right away.
+ @return The stream itself.
+ */
+- (instancetype)values:(void (^)(ValueType _Nullable value))valueHandler on:(nullable dispatch_queue_t)queue;
+
+/** Signal demand for further values.
+
+ Demand accumulates, request NSUIntegerMax to receive all values as fast as they
+ are produced.
+
+ @param count The number of additional values the consumer is able to handle.
+ */
+- (void)request:(NSUInteger)count;
+
+/** Stop consuming the stream.
+
+ Buffered values are dropped, the producer gets notified and the completion
+ promise fails with OMPromisesCancelledError.
+ */
+- (void)cancel;
+
+///---------------------------------------------------------------------------------------
+/// @name Operators
+///---------------------------------------------------------------------------------------
+
+/** Transform each value.
+
+ @param mapper The block transforming a single value.
+ @return A new stream.
+ */
+- (OMStream *)map:(id _Nullable (^)(ValueType _Nullable value))mapper;
+
+/** Pass only values matching the predicate.
+
+ @param predicate The block deciding whether to keep a value.
+ @return A new stream.
+ */
+- (OMStream<ValueType> *)filter:(BOOL (^)(ValueType _Nullable value))predicate;
+
+/** Group successive values into arrays.
+
+ Each array holds count values, except for the last one which might hold less.
+
+ @param count The number of values per array, at least one.
+ @return A new stream of arrays.
+ */
+- (OMStream<NSArray<ValueType> *> *)buffer:(NSUInteger)count;
+
+/** Map each value to a promise, while keeping a limited number of them in flight.
+
+ The results are delivered in the order the promises get fulfilled. If any of them
+ fails, the new stream fails as well and the receiver gets cancelled.
+
+ @param mapper The block creating the promise for a single value.
+ @param concurrency Maximum number of promises in flight, at least one.
+ @return A new stream.
+ */
+- (OMStream *)flatMap:(OMPromise *(^)(ValueType _Nullable value))mapper concurrency:(NSUInteger)concurrency;
+
+///---------------------------------------------------------------------------------------
+/// @name Bridging to promises
+///---------------------------------------------------------------------------------------
+
+/** Consume all values and collect them in order.
+
+ Values of nil are replaced by NSNull.null.
+
+ @return A promise yielding an array of all values.
+ */
+- (OMPromise<NSArray<ValueType> *> *)collect;
+
+/** Consume all values, combining them one after another.
+
+ @param reducer The block combining the accumulated value with the next one.
+ @param initial The initial value passed to the first call.
+ @return A promise yielding the accumulated value.
+ */
+- (OMPromise *)reduce:(id _Nullable (^)(id _Nullable accumulator, ValueType _Nullable value))reducer
+              initial:(nullable id)initial;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,482 @@
+//
+// OMStream.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMStream.h"
+
+#import "OMDeferred.h"
+#import "OMStream+Internal.h"
+
+/** Adds demand without overflowing, NSUIntegerMax stands for unbounded demand.
+ */
+static NSUInteger OMSaturatingAdd(NSUInteger a, NSUInteger b) {
+    return a > NSUIntegerMax - b ? NSUIntegerMax : a + b;
+}
+
+/** Stands in for nil values within the buffer.
+ */
+static id OMStreamNil(void) {
+    static id nilValue = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        nilValue = [NSObject new];
+    });
+
+    return nilValue;
+}
+
+@implementation OMStream {
+    NSUInteger _capacity;
+    NSMutableArray *_buffer;
+    NSUInteger _requested;
+
+    void (^_valueHandler)(id);
+    dispatch_queue_t _queue;
+    BOOL _draining;
+
+    BOOL _completed;
+    BOOL _terminated;
+    OMDeferred *_completion;
+
+    NSMutableArray *_requestHandlers;
+    NSMutableArray *_cancelHandlers;
+}
+
+#pragma mark - Init
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self) {
+        _capacity = capacity;
+        _buffer = [NSMutableArray arrayWithCapacity:MIN(capacity, 16U)];
+        _completion = [OMDeferred new];
+        _requestHandlers = [NSMutableArray array];
+        _cancelHandlers = [NSMutableArray array];
+
+        // cancelling any promise derived from the completion cancels the stream
+        __weak OMStream *weakSelf = self;
+        [_completion cancelled:^(OMDeferred *deferred) {
+            [weakSelf cancel];
+        }];
+    }
+    return self;
+}
+
+#pragma mark - State
+
+- (OMPromise *)completion {
+    return _completion.promise;
+}
+
+- (NSUInteger)demand {
+    @synchronized (self) {
+        if (_completed || _terminated) {
+            return 0;
+        }
+
+        NSUInteger accepted = OMSaturatingAdd(_requested, _capacity);
+        return accepted > _buffer.count ? accepted - _buffer.count : 0;
+    }
+}
+
+#pragma mark - Consuming
+
+- (instancetype)values:(void (^)(id value))valueHandler {
+    return [self values:valueHandler on:nil];
+}
+
+- (instancetype)values:(void (^)(id value))valueHandler on:(dispatch_queue_t)queue {
+    @synchronized (self) {
+        NSAssert(_valueHandler == nil, @"A stream can only be consumed by a single block");
+
+        if (_terminated) {
+            return self;
+        }
+
+        _valueHandler = valueHandler;
+        _queue = queue;
+    }
+
+    [self drain];
+
+    return self;
+}
+
+- (void)request:(NSUInteger)count {
+    NSArray *handlers = nil;
+
+    @synchronized (self) {
+        if (_terminated || count == 0) {
+            return;
+        }
+
+        _requested = OMSaturatingAdd(_requested, count);
+        handlers = [_requestHandlers copy];
+    }
+
+    [self drain];
+
+    for (void (^handler)(NSUInteger) in handlers) {
+        handler(count);
+    }
+}
+
+- (void)cancel {
+    NSArray *handlers = nil;
+
+    @synchronized (self) {
+        if (_terminated) {
+            return;
+        }
+
+        handlers = _cancelHandlers;
+        [self terminate];
+    }
+
+    for (void (^handler)(void) in handlers) {
+        handler();
+    }
+
+    [_completion tryFail:[NSError errorWithDomain:OMPromisesErrorDomain
+                                             code:OMPromisesCancelledError
+                                         userInfo:@{
+                                             NSLocalizedDescriptionKey: @"The stream has been cancelled."
+                                         }]];
+}
+
+#pragma mark - Operators
+
+- (OMStream *)map:(id (^)(id value))mapper {
+    OMStream *stream = [[OMStream alloc] initWithCapacity:NSUIntegerMax];
+
+    [self values:^(id value) {
+        [stream push:mapper(value)];
+    }];
+    [self forwardTo:stream];
+
+    return stream;
+}
+
+- (OMStream *)filter:(BOOL (^)(id value))predicate {
+    OMStream *stream = [[OMStream alloc] initWithCapacity:NSUIntegerMax];
+
+    [self values:^(id value) {
+        if (predicate(value)) {
+            [stream push:value];
+        } else {
+            // the consumer is still waiting for a value
+            [self request:1];
+        }
+    }];
+    [self forwardTo:stream];
+
+    return stream;
+}
+
+- (OMStream *)buffer:(NSUInteger)count {
+    NSAssert(count > 0, @"At least a single value has to be buffered");
+
+    OMStream *stream = [[OMStream alloc] initWithCapacity:NSUIntegerMax];
+    __block NSMutableArray *batch = [NSMutableArray arrayWithCapacity:count];
+
+    [self values:^(id value) {
+        [batch addObject:value ?: [NSNull null]];
+
+        if (batch.count == count) {
+            NSArray *full = batch;
+            batch = [NSMutableArray arrayWithCapacity:count];
+            [stream push:full];
+        }
+    }];
+
+    [stream requested:^(NSUInteger requested) {
+        [self request:requested > NSUIntegerMax / count ? NSUIntegerMax : requested * count];
+    }];
+    [stream cancelled:^{
+        [self cancel];
+    }];
+
+    // values are all delivered before the completion, the last batch is complete by then
+    [self.completion always:^(OMPromiseState state, id result, NSError *error) {
+        if (state == OMPromiseStateFulfilled) {
+            if (batch.count > 0) {
+                [stream push:batch];
+            }
+            [stream complete];
+        } else {
+            [stream fail:error];
+        }
+    } on:nil];
+
+    return stream;
+}
+
+- (OMStream *)flatMap:(OMPromise *(^)(id value))mapper concurrency:(NSUInteger)concurrency {
+    NSAssert(concurrency > 0, @"At least a single promise has to be in flight");
+
+    OMStream *stream = [[OMStream alloc] initWithCapacity:NSUIntegerMax];
+    NSObject *lock = [NSObject new];
+
+    // values requested from the receiver, promises in flight and results still wanted
+    __block NSUInteger awaiting = 0;
+    __block NSUInteger running = 0;
+    __block NSUInteger wanted = 0;
+    __block BOOL exhausted = NO;
+
+    void (^pull)(void) = ^{
+        NSUInteger count = 0;
+        @synchronized (lock) {
+            while (awaiting + running + count < concurrency && wanted > 0) {
+                count += 1;
+                wanted = wanted == NSUIntegerMax ? wanted : wanted - 1;
+            }
+            awaiting += count;
+        }
+
+        [self request:count];
+    };
+
+    void (^finish)(void) = ^{
+        BOOL done = NO;
+        @synchronized (lock) {
+            done = exhausted && running == 0;
+        }
+
+        if (done) {
+            [stream complete];
+        }
+    };
+
+    [self values:^(id value) {
+        @synchronized (lock) {
+            awaiting -= 1;
+            running += 1;
+        }
+
+        [[mapper(value)
+            fulfilled:^(id result) {
+                @synchronized (lock) {
+                    running -= 1;
+                }
+
+                [stream push:result];
+                pull();
+                finish();
+            } on:nil]
+            failed:^(NSError *error) {
+                [stream fail:error];
+                [self cancel];
+            } on:nil];
+    }];
+
+    [stream requested:^(NSUInteger requested) {
+        @synchronized (lock) {
+            wanted = OMSaturatingAdd(wanted, requested);
+        }
+        pull();
+    }];
+    [stream cancelled:^{
+        [self cancel];
+    }];
+
+    [self.completion always:^(OMPromiseState state, id result, NSError *error) {
+        if (state == OMPromiseStateFulfilled) {
+            @synchronized (lock) {
+                exhausted = YES;
+            }
+            finish();
+        } else {
+            [stream fail:error];
+        }
+    } on:nil];
+
+    return stream;
+}
+
+#pragma mark - Bridges
+
+- (OMPromise *)collect {
+    NSMutableArray *values = [NSMutableArray array];
+
+    [self values:^(id value) {
+        [values addObject:value ?: [NSNull null]];
+    }];
+    [self request:NSUIntegerMax];
+
+    return [self.completion then:^id(id _) {
+        return [values copy];
+    } on:nil];
+}
+
+- (OMPromise *)reduce:(id (^)(id accumulator, id value))reducer initial:(id)initial {
+    __block id accumulator = initial;
+
+    [self values:^(id value) {
+        accumulator = reducer(accumulator, value);
+    }];
+    [self request:NSUIntegerMax];
+
+    return [self.completion then:^id(id _) {
+        return accumulator;
+    } on:nil];
+}
+
+#pragma mark - Internal Methods
+
+- (BOOL)push:(id)value {
+    @synchronized (self) {
+        if (_completed || _terminated || _buffer.count >= OMSaturatingAdd(_requested, _capacity)) {
+            return NO;
+        }
+
+        [_buffer addObject:value ?: OMStreamNil()];
+    }
+
+    [self drain];
+
+    return YES;
+}
+
+- (void)complete {
+    @synchronized (self) {
+        if (_completed || _terminated) {
+            return;
+        }
+
+        _completed = YES;
+    }
+
+    [self drain];
+}
+
+- (void)fail:(NSError *)error {
+    @synchronized (self) {
+        if (_completed || _terminated) {
+            return;
+        }
+
+        [self terminate];
+    }
+
+    [_completion tryFail:error];
+}
+
+- (void)requested:(void (^)(NSUInteger count))requestHandler {
+    @synchronized (self) {
+        [_requestHandlers addObject:[requestHandler copy]];
+    }
+}
+
+- (void)cancelled:(void (^)(void))cancelHandler {
+    @synchronized (self) {
+        [_cancelHandlers addObject:[cancelHandler copy]];
+    }
+}
+
+#pragma mark - Private Methods
+
+/** Forwards demand and cancellation of the stream to the receiver, and the
+ completion of the receiver to the stream.
+ */
+- (void)forwardTo:(OMStream *)stream {
+    [stream requested:^(NSUInteger count) {
+        [self request:count];
+    }];
+    [stream cancelled:^{
+        [self cancel];
+    }];
+
+    [self.completion always:^(OMPromiseState state, id result, NSError *error) {
+        if (state == OMPromiseStateFulfilled) {
+            [stream complete];
+        } else {
+            [stream fail:error];
+        }
+    } on:nil];
+}
+
+/** Delivers buffered values as long as there is demand, and completes the stream
+ once the last one got delivered. Only a single thread drains at a time.
+ */
+- (void)drain {
+    @synchronized (self) {
+        if (_draining) {
+            return;
+        }
+        _draining = YES;
+    }
+
+    while (YES) {
+        id value = nil;
+        void (^handler)(id) = nil;
+        dispatch_queue_t queue = nil;
+        BOOL finished = NO;
+
+        @synchronized (self) {
+            if (_valueHandler != nil && _requested > 0 && _buffer.count > 0) {
+                value = _buffer[0];
+                [_buffer removeObjectAtIndex:0];
+                _requested = _requested == NSUIntegerMax ? _requested : _requested - 1;
+                handler = _valueHandler;
+                queue = _queue;
+            } else {
+                finished = _completed && !_terminated && _buffer.count == 0;
+                if (finished) {
+                    [self terminate];
+                }
+                _draining = NO;
+            }
+        }
+
+        if (handler == nil) {
+            if (finished) {
+                [_completion tryFulfil:nil];
+            }
+            return;
+        }
+
+        value = value == OMStreamNil() ? nil : value;
+
+        if (queue != nil) {
+            dispatch_async(queue, ^{
+                handler(value);
+            });
+        } else {
+            handler(value);
+        }
+    }
+}
+
+/** Drops buffered values and all handlers, which might refer to the receiver.
+ */
+- (void)terminate {
+    _terminated = YES;
+    [_buffer removeAllObjects];
+    _valueHandler = nil;
+    _queue = nil;
+    _requestHandlers = nil;
+    _cancelHandlers = nil;
+}
+
+@end
@@ -0,0 +1,52 @@
+//
+// OMTimerWheel.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** A hashed timer wheel, scheduling a block in constant time.
+
+ Deadlines are rounded up to the resolution of the wheel and kept in a fixed number
+ of slots. A single dispatch timer advances the wheel, armed for the next occupied
+ slot only and independent of any run loop. Blocks are called on a private serial
+ queue.
+ */
+@interface OMTimerWheel : NSObject
+
+/** The wheel shared by all delayed promises.
+ */
++ (OMTimerWheel *)sharedWheel;
+
+/** Call the block once the delay elapsed.
+
+ @param block The block to call.
+ @param delay Seconds to wait at least, the block is dispatched right away if not positive.
+ */
+- (void)schedule:(dispatch_block_t)block after:(NSTimeInterval)delay;
+
+@end
+
+NS_ASSUME_NONNULL_END
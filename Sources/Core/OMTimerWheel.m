@@ -0,0 +1,211 @@
+//
+// OMTimerWheel.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTimerWheel.h"
+
+#import <pthread.h>
+
+/** Seconds covered by a single tick of the wheel.
+ */
+static const NSTimeInterval kTimerWheelResolution = .01;
+
+/** Number of slots, deadlines further out take several revolutions.
+ */
+enum { kTimerWheelSlots = 512 };
+
+typedef struct OMTimerEntry {
+    struct OMTimerEntry *next;
+    /** Number of revolutions to skip before firing. */
+    uint64_t rounds;
+    void *block;
+} OMTimerEntry;
+
+@implementation OMTimerWheel {
+    pthread_mutex_t _lock;
+    OMTimerEntry *_slots[kTimerWheelSlots];
+    /** The last tick processed. */
+    uint64_t _cursor;
+    NSUInteger _count;
+
+    dispatch_queue_t _queue;
+    dispatch_source_t _timer;
+    /** The tick the timer fires at next, UINT64_MAX while idle. */
+    uint64_t _armed;
+}
+
+#pragma mark - Init
+
++ (OMTimerWheel *)sharedWheel {
+    static OMTimerWheel *sharedWheel = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedWheel = [OMTimerWheel new];
+    });
+
+    return sharedWheel;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+
+        _queue = dispatch_queue_create("de.reaktor42.OMPromises.timers", DISPATCH_QUEUE_SERIAL);
+        _timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _queue);
+        _armed = UINT64_MAX;
+
+        // never fires until armed for the first deadline
+        dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+
+        __weak OMTimerWheel *weakSelf = self;
+        dispatch_source_set_event_handler(_timer, ^{
+            [weakSelf advance];
+        });
+        dispatch_resume(_timer);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    for (NSUInteger i = 0; i < kTimerWheelSlots; ++i) {
+        while (_slots[i] != NULL) {
+            OMTimerEntry *entry = _slots[i];
+            _slots[i] = entry->next;
+            CFRelease(entry->block);
+            free(entry);
+        }
+    }
+
+    dispatch_source_cancel(_timer);
+    pthread_mutex_destroy(&_lock);
+}
+
+#pragma mark - Scheduling
+
+- (void)schedule:(dispatch_block_t)block after:(NSTimeInterval)delay {
+    if (delay <= 0.) {
+        dispatch_async(_queue, block);
+        return;
+    }
+
+    OMTimerEntry *entry = malloc(sizeof(OMTimerEntry));
+    entry->block = (__bridge_retained void *)[block copy];
+
+    pthread_mutex_lock(&_lock);
+
+    uint64_t now = [self now];
+    if (_count++ == 0) {
+        _cursor = now;
+    }
+
+    // due on the first tick not before the deadline, relative to the ticks processed so far
+    uint64_t target = now + MAX(1, (uint64_t)ceil(delay / kTimerWheelResolution));
+    uint64_t ticks = target - _cursor;
+
+    entry->rounds = (ticks - 1) / kTimerWheelSlots;
+    entry->next = _slots[target % kTimerWheelSlots];
+    _slots[target % kTimerWheelSlots] = entry;
+
+    if (target < _armed) {
+        [self armAt:target];
+    }
+
+    pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Private Methods
+
+/** The current time in ticks, based on a monotonic clock.
+ */
+- (uint64_t)now {
+    return (uint64_t)([NSProcessInfo processInfo].systemUptime / kTimerWheelResolution);
+}
+
+/** Let the timer fire once at the tick, instead of on every tick.
+ */
+- (void)armAt:(uint64_t)tick {
+    _armed = tick;
+
+    NSTimeInterval delay = MAX(0., tick * kTimerWheelResolution - [NSProcessInfo processInfo].systemUptime);
+    dispatch_source_set_timer(_timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                              DISPATCH_TIME_FOREVER, (uint64_t)(kTimerWheelResolution * NSEC_PER_SEC) / 10);
+}
+
+- (void)advance {
+    OMTimerEntry *due = NULL;
+
+    pthread_mutex_lock(&_lock);
+
+    // the timer might lag behind, catch up with all ticks passed since
+    uint64_t now = [self now];
+    while (_cursor < now && _count > 0) {
+        _cursor += 1;
+
+        OMTimerEntry **link = &_slots[_cursor % kTimerWheelSlots];
+        while (*link != NULL) {
+            OMTimerEntry *entry = *link;
+
+            if (entry->rounds > 0) {
+                entry->rounds -= 1;
+                link = &entry->next;
+            } else {
+                *link = entry->next;
+                entry->next = due;
+                due = entry;
+                _count -= 1;
+            }
+        }
+    }
+
+    if (_count == 0) {
+        // idle until the next schedule
+        _armed = UINT64_MAX;
+        dispatch_source_set_timer(_timer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    } else {
+        // entries of later revolutions are visited once per revolution to count them down
+        uint64_t next = _cursor + 1;
+        while (_slots[next % kTimerWheelSlots] == NULL) {
+            next += 1;
+        }
+        [self armAt:next];
+    }
+
+    pthread_mutex_unlock(&_lock);
+
+    [self fire:due];
+}
+
+- (void)fire:(OMTimerEntry *)entries {
+    while (entries != NULL) {
+        OMTimerEntry *next = entries->next;
+        dispatch_block_t block = (__bridge_transfer dispatch_block_t)entries->block;
+        free(entries);
+
+        block();
+        entries = next;
+    }
+}
+
+@end
@@ -0,0 +1,84 @@
+//
+// OMWorkStealingPool.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "OMExecutor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** A fixed number of worker threads, each running the work of its own deque.
+
+ Work submitted from one of the workers, e.g., the handlers of a promise settled
+ by a task running in the pool, is pushed to the deque of that very worker and
+ taken from it in last-in-first-out order, thus benefiting from warm caches.
+ Work submitted from any other thread is pushed to a shared deque. Idle workers
+ take the oldest work of the shared deque or steal from the other workers.
+
+ In contrast to the global dispatch queues, the pool never spawns additional
+ threads if work blocks.
+
+ Use queue to run promise handlers and tasks in the pool, e.g., by setting it as
+ [OMPromise globalDefaultQueue] or [OMPromise globalTaskQueue].
+ */
+@interface OMWorkStealingPool : NSObject <OMExecutor>
+
+///---------------------------------------------------------------------------------------
+/// @name Creation
+///---------------------------------------------------------------------------------------
+
+/** A pool having a worker per active processor.
+
+ @return The shared pool.
+ */
++ (OMWorkStealingPool *)sharedPool;
+
+/** Create a pool with a fixed number of workers.
+
+ The workers are started right away and run as long as the process does, thus
+ pools should be created once only.
+
+ @param workers The number of worker threads, at least one.
+ @return A new pool.
+ */
+- (instancetype)initWithWorkers:(NSUInteger)workers NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+///---------------------------------------------------------------------------------------
+/// @name Properties
+///---------------------------------------------------------------------------------------
+
+/** The number of worker threads.
+ */
+@property(readonly, nonatomic) NSUInteger workers;
+
+/** The queue representing the pool, to be passed wherever a queue is accepted.
+ */
+@property(readonly, nonatomic) dispatch_queue_t queue;
+
+@end
+
+NS_ASSUME_NONNULL_END
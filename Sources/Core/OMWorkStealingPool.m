@@ -0,0 +1,248 @@
+//
+// OMWorkStealingPool.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMWorkStealingPool.h"
+
+#import <pthread.h>
+#import <stdatomic.h>
+
+#import "OMPromise.h"
+
+/** Initial number of work items a deque is able to hold.
+ */
+static const size_t kInitialDequeCapacity = 64;
+
+typedef struct OMWork {
+    dispatch_function_t function;
+    void *context;
+} OMWork;
+
+/** A growable ring buffer, pushed and popped at its bottom by its owner and stolen
+ from at its top by everybody else.
+
+ Each deque has its own lock, which is only ever contended while stealing.
+ */
+typedef struct OMWorkDeque {
+    pthread_mutex_t lock;
+    OMWork *items;
+    size_t capacity;
+    size_t top;
+    size_t bottom;
+} OMWorkDeque;
+
+static void OMWorkDequeInit(OMWorkDeque *deque) {
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->items = malloc(kInitialDequeCapacity * sizeof(OMWork));
+    deque->capacity = kInitialDequeCapacity;
+    deque->top = 0;
+    deque->bottom = 0;
+}
+
+static void OMWorkDequePush(OMWorkDeque *deque, OMWork work) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom - deque->top == deque->capacity) {
+        OMWork *items = malloc(2 * deque->capacity * sizeof(OMWork));
+        for (size_t i = deque->top; i < deque->bottom; ++i) {
+            items[i % (2 * deque->capacity)] = deque->items[i % deque->capacity];
+        }
+        free(deque->items);
+        deque->items = items;
+        deque->capacity *= 2;
+    }
+
+    deque->items[deque->bottom++ % deque->capacity] = work;
+
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static BOOL OMWorkDequePop(OMWorkDeque *deque, OMWork *work) {
+    pthread_mutex_lock(&deque->lock);
+
+    BOOL found = deque->bottom != deque->top;
+    if (found) {
+        *work = deque->items[--deque->bottom % deque->capacity];
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static BOOL OMWorkDequeSteal(OMWorkDeque *deque, OMWork *work) {
+    if (pthread_mutex_trylock(&deque->lock) != 0) {
+        return NO;
+    }
+
+    BOOL found = deque->bottom != deque->top;
+    if (found) {
+        *work = deque->items[deque->top++ % deque->capacity];
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+typedef struct OMWorker {
+    void *pool;
+    size_t index;
+    OMWorkDeque deque;
+} OMWorker;
+
+static pthread_key_t workerKey;
+
+@interface OMWorkStealingPool ()
+
+- (BOOL)takeWork:(OMWork *)work for:(OMWorker *)worker;
+- (void)sleep;
+
+@end
+
+static void *OMWorkerMain(void *context) {
+    OMWorker *worker = context;
+    OMWorkStealingPool *pool = (__bridge OMWorkStealingPool *)worker->pool;
+
+    pthread_setspecific(workerKey, worker);
+
+    while (YES) {
+        OMWork work;
+        if ([pool takeWork:&work for:worker]) {
+            @autoreleasepool {
+                work.function(work.context);
+            }
+        } else {
+            [pool sleep];
+        }
+    }
+
+    return NULL;
+}
+
+@implementation OMWorkStealingPool {
+    OMWorker *_threads;
+    OMWorkDeque _shared;
+
+    _Atomic(NSInteger) _pending;
+    _Atomic(NSInteger) _sleeping;
+    pthread_mutex_t _sleepLock;
+    pthread_cond_t _wakeup;
+}
+
+#pragma mark - Init
+
++ (OMWorkStealingPool *)sharedPool {
+    static OMWorkStealingPool *sharedPool = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedPool = [[OMWorkStealingPool alloc] initWithWorkers:NSProcessInfo.processInfo.activeProcessorCount];
+    });
+
+    return sharedPool;
+}
+
+- (instancetype)initWithWorkers:(NSUInteger)workers {
+    NSAssert(workers > 0, @"A pool needs at least a single worker");
+
+    self = [super init];
+    if (self) {
+        static dispatch_once_t once;
+        dispatch_once(&once, ^{
+            pthread_key_create(&workerKey, NULL);
+        });
+
+        _workers = workers;
+        _queue = [OMPromise queueWithExecutor:self];
+
+        atomic_init(&_pending, 0);
+        atomic_init(&_sleeping, 0);
+        pthread_mutex_init(&_sleepLock, NULL);
+        pthread_cond_init(&_wakeup, NULL);
+        OMWorkDequeInit(&_shared);
+
+        // the workers keep the pool alive, it lives as long as the process does
+        _threads = calloc(workers, sizeof(OMWorker));
+        for (NSUInteger i = 0; i < workers; ++i) {
+            _threads[i].pool = (__bridge_retained void *)self;
+            _threads[i].index = i;
+            OMWorkDequeInit(&_threads[i].deque);
+
+            pthread_t thread;
+            pthread_create(&thread, NULL, OMWorkerMain, &_threads[i]);
+            pthread_detach(thread);
+        }
+    }
+    return self;
+}
+
+#pragma mark - OMExecutor
+
+- (void)execute:(dispatch_function_t)function context:(void *)context {
+    OMWorker *worker = pthread_getspecific(workerKey);
+    OMWork work = { .function = function, .context = context };
+
+    if (worker != NULL && worker->pool == (__bridge void *)self) {
+        OMWorkDequePush(&worker->deque, work);
+    } else {
+        OMWorkDequePush(&_shared, work);
+    }
+
+    atomic_fetch_add(&_pending, 1);
+
+    // a worker about to sleep either observes the pending work or gets signaled
+    if (atomic_load(&_sleeping) > 0) {
+        pthread_mutex_lock(&_sleepLock);
+        pthread_cond_signal(&_wakeup);
+        pthread_mutex_unlock(&_sleepLock);
+    }
+}
+
+#pragma mark - Private Methods
+
+- (BOOL)takeWork:(OMWork *)work for:(OMWorker *)worker {
+    BOOL found = OMWorkDequePop(&worker->deque, work) || OMWorkDequeSteal(&_shared, work);
+
+    for (NSUInteger i = 1; !found && i < _workers; ++i) {
+        found = OMWorkDequeSteal(&_threads[(worker->index + i) % _workers].deque, work);
+    }
+
+    if (found) {
+        atomic_fetch_sub(&_pending, 1);
+    }
+
+    return found;
+}
+
+- (void)sleep {
+    pthread_mutex_lock(&_sleepLock);
+    atomic_fetch_add(&_sleeping, 1);
+
+    while (atomic_load(&_pending) == 0) {
+        pthread_cond_wait(&_wakeup, &_sleepLock);
+    }
+
+    atomic_fetch_sub(&_sleeping, 1);
+    pthread_mutex_unlock(&_sleepLock);
+}
+
+@end
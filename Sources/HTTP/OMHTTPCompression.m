@@ -0,0 +1,63 @@
+//
+// OMHTTPCompression.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMHTTPCompression.h"
+
+#import <zlib.h>
+
+#import "OMHTTPRequest.h"
+
+/** Window bits selecting the zlib format, adding 16 selects the gzip format. */
+static const int kWindowBits = 15;
+
+NSData *OMCompressedData(NSData *data, NSString *contentCoding) {
+    int windowBits = 0;
+    if ([contentCoding isEqualToString:OMHTTPCompressionGzip]) {
+        windowBits = kWindowBits + 16;
+    } else if ([contentCoding isEqualToString:OMHTTPCompressionDeflate]) {
+        windowBits = kWindowBits;
+    } else {
+        return nil;
+    }
+
+    z_stream stream = {0};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nil;
+    }
+
+    // a single pass suffices given the bound, the gzip wrapper adds a few bytes
+    NSMutableData *compressed = [NSMutableData dataWithLength:deflateBound(&stream, (uLong)data.length) + 32];
+
+    stream.next_in = (Bytef *)data.bytes;
+    stream.avail_in = (uInt)data.length;
+    stream.next_out = compressed.mutableBytes;
+    stream.avail_out = (uInt)compressed.length;
+
+    int status = deflate(&stream, Z_FINISH);
+    compressed.length = stream.total_out;
+    deflateEnd(&stream);
+
+    return status == Z_STREAM_END ? compressed : nil;
+}
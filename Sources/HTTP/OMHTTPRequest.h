@@ -44,6 +44,11 @@ typedef NS_ENUM(NSInteger, OMPromisesHTTPErrorCodes) {
  */
 extern NSString *const OMHTTPResponseKey;
 
+/** NSError userInfo key specifying the data to resume a failed download with, see
+ OMHTTPResumeData.
+ */
+extern NSString *const OMHTTPResumeDataKey;
+
 /** Option key specifying the time interval before a request is considered timed out.
  
  The value should be encoded as NSNumber containing an NSTimeInterval (double) describing
@@ -79,12 +84,182 @@ extern NSString *const OMHTTPSerializationURLEncoded;
  */
 extern NSString *const OMHTTPAllowInvalidCertificates;
 
+/** Option key specifying whether identical GET requests in flight share a single
+ connection.
+
+ Requests are identical if their URL, their headers and the
+ OMHTTPAllowInvalidCertificates option match. Each caller gets a promise of its
+ own, the connection is only cancelled once all of them got cancelled.
+ Requires a boolean wrapped in an @p NSNumber. Defaults to @p YES.
+ */
+extern NSString *const OMHTTPCoalesce;
+
+/** Option key specifying whether the body is delivered in chunks as it arrives.
+
+ The promise is fulfilled as soon as the headers arrived, using an OMHTTPResponse
+ without body. Its bodyStream delivers the chunks instead, without copying them.
+ Reading from the connection pauses while the consumer of the stream falls behind.
+ Requires a boolean wrapped in an @p NSNumber. Defaults to @p NO.
+ */
+extern NSString *const OMHTTPStreamBody;
+
+/** Option key specifying whether the body is written to a temporary file while it
+ downloads, instead of being kept in memory.
+
+ The OMHTTPResponse refers to the file using bodyURL and maps it into memory on
+ access of its body. If the download fails, the error might contain the data to
+ resume it under OMHTTPResumeDataKey.
+ Requires a boolean wrapped in an @p NSNumber. Defaults to @p NO.
+ */
+extern NSString *const OMHTTPDownloadToFile;
+
+/** Option key specifying the data to resume a failed download with.
+
+ The data is taken from the error of the failed download, see OMHTTPResumeDataKey.
+ The download continues using a range request if the server supports it, thus
+ the URL and the parameters passed along are ignored. Implies OMHTTPDownloadToFile.
+ */
+extern NSString *const OMHTTPResumeData;
+
+/** Priority classes of requests waiting for a free slot.
+ */
+typedef NS_ENUM(NSInteger, OMHTTPPriority) {
+    OMHTTPPriorityLow = -1,
+    OMHTTPPriorityNormal = 0,
+    OMHTTPPriorityHigh = 1
+};
+
+/** Option key specifying the priority class of the request.
+
+ Requests start once there is a free slot, see setMaximumConcurrentRequests: and
+ setMaximumConcurrentRequestsPerHost:. Waiting requests of a higher class start
+ first, requests of the same class in the order they were made. Cancelling a
+ waiting request removes it without ever connecting.
+ Requires an OMHTTPPriority wrapped in an @p NSNumber. Defaults to
+ OMHTTPPriorityNormal.
+ */
+extern NSString *const OMHTTPPriorityOption;
+
+/** Option key specifying the maximum number of attempts, including the first one.
+
+ Only requests using an idempotent method, like GET, PUT or DELETE, are attempted
+ again, if they failed due to a status code contained in OMHTTPRetryStatusCodes or
+ a connection that could not be established or got lost. Cancellation is never
+ retried. The promise fails using the error of the last attempt.
+ Requires an NSUInteger wrapped in an @p NSNumber. Defaults to `1`.
+ */
+extern NSString *const OMHTTPRetryAttempts;
+
+/** Option key specifying the upper bound of the delay before the second attempt.
+
+ The bound doubles with each further attempt, up to 30 seconds. The actual delay
+ is picked randomly below it, unless the response asks for a longer one using a
+ Retry-After header.
+ Requires an NSTimeInterval wrapped in an @p NSNumber. Defaults to `.5`.
+ */
+extern NSString *const OMHTTPRetryDelay;
+
+/** Option key specifying the status codes worth another attempt.
+
+ Requires an NSSet of status codes wrapped in @p NSNumber instances. Defaults to
+ 408, 429, 500, 502, 503 and 504.
+ */
+extern NSString *const OMHTTPRetryStatusCodes;
+
+/** Option key specifying the time interval after which a GET request still waiting
+ for its response is sent a second time.
+
+ Whichever of both succeeds first is used and the other one cancelled, trading a
+ few additional requests for fewer requests taking exceptionally long. A sensible
+ value is about the 95th percentile of the response times of the resource.
+ Requests downloading their body to a file are never hedged.
+ Requires an NSTimeInterval wrapped in an @p NSNumber. Disabled by default.
+ */
+extern NSString *const OMHTTPHedgeDelay;
+
+/** Option key specifying the cache to serve GET requests from, see
+ OMHTTPResponseCache.
+
+ Fresh responses are returned without any request, stale ones are revalidated.
+ Requests streaming their body or downloading it to a file bypass the cache.
+ Successful POST, PUT, PATCH and DELETE requests invalidate the response stored for
+ their URL.
+ Requires an OMHTTPResponseCache, e.g., [OMHTTPResponseCache sharedCache]. No
+ cache is used by default.
+ */
+extern NSString *const OMHTTPCache;
+
+/** Option key specifying whether stale responses found in the OMHTTPCache are
+ returned right away, while they are revalidated in the background.
+
+ Responses requiring revalidation by no-cache or must-revalidate, as well as requests
+ sending no-cache, always wait for the revalidation. So do responses which are stale
+ beyond their stale-while-revalidate window, if they specify one.
+
+ Requires a boolean wrapped in an @p NSNumber. Defaults to @p NO.
+ */
+extern NSString *const OMHTTPStaleWhileRevalidate;
+
+/** Option key specifying the content coding to compress the body of the request
+ with.
+
+ Possible values are OMHTTPCompressionGzip and OMHTTPCompressionDeflate. The body
+ is only compressed if it is at least OMHTTPCompressionThreshold bytes long and
+ gets smaller, in which case the Content-Encoding header is set and the
+ Content-Length adjusted. The server has to support the coding, there is no way
+ to negotiate it for requests.
+ Responses are always decompressed by the URL loading system, as it negotiates
+ gzip and deflate using Accept-Encoding on its own.
+ Bodies are sent uncompressed by default.
+ */
+extern NSString *const OMHTTPCompression;
+extern NSString *const OMHTTPCompressionGzip;
+extern NSString *const OMHTTPCompressionDeflate;
+
+/** Option key specifying the minimum size in bytes of a body compressed due to
+ OMHTTPCompression.
+
+ Requires an NSUInteger wrapped in an @p NSNumber. Defaults to `1024`.
+ */
+extern NSString *const OMHTTPCompressionThreshold;
+
 @class OMHTTPResponse;
+@class OMHTTPRoute;
 
 /** Provides methods to create an OMPromise representing an HTTP request.
+
+ All requests are performed using a single shared NSURLSession, thus connections
+ are kept alive and reused across requests. Its callbacks are processed on a
+ serial queue of their own, the main thread is only involved if the handlers
+ registered at the promise are scheduled on it, see [OMPromise globalDefaultQueue].
+ Requires iOS 7.0 or OS X 10.9.
  */
 @interface OMHTTPRequest : OMDeferred
 
+///---------------------------------------------------------------------------------------
+/// @name Scheduling
+///---------------------------------------------------------------------------------------
+
+/** Maximum number of requests running at once. Defaults to 16.
+ */
++ (NSUInteger)maximumConcurrentRequests;
+
+/** Set the maximum number of requests running at once.
+
+ @param maximumConcurrentRequests The limit, at least 1.
+ */
++ (void)setMaximumConcurrentRequests:(NSUInteger)maximumConcurrentRequests;
+
+/** Maximum number of requests running at once per host. Defaults to 4.
+ */
++ (NSUInteger)maximumConcurrentRequestsPerHost;
+
+/** Set the maximum number of requests running at once per host.
+
+ @param maximumConcurrentRequestsPerHost The limit, at least 1.
+ */
++ (void)setMaximumConcurrentRequestsPerHost:(NSUInteger)maximumConcurrentRequestsPerHost;
+
 ///---------------------------------------------------------------------------------------
 /// @name Universal HTTP Request
 ///---------------------------------------------------------------------------------------
@@ -110,8 +285,12 @@ extern NSString *const OMHTTPAllowInvalidCertificates;
  @param options An optional set of HTTP headers including values and method specific
                 options like OMHTTPSerialization. Each non method specific option is
                 automatically treated as an HTTP header and added to the request.
-                Possible domain specific keys are OMHTTPTimeout, OMHTTPLookupProgress
-                and OMHTTPSerialization.
+                Possible domain specific keys are OMHTTPTimeout, OMHTTPLookupProgress,
+                OMHTTPSerialization, OMHTTPCoalesce, OMHTTPStreamBody,
+                OMHTTPDownloadToFile, OMHTTPResumeData, OMHTTPPriorityOption,
+                OMHTTPRetryAttempts, OMHTTPRetryDelay, OMHTTPRetryStatusCodes,
+                OMHTTPHedgeDelay, OMHTTPCache, OMHTTPStaleWhileRevalidate,
+                OMHTTPCompression and OMHTTPCompressionThreshold.
  @return A promise that yields an OMHTTPResponse instance if successful.
  @see OMHTTPResponse
  @see get:parameters:options:
@@ -125,6 +304,25 @@ extern NSString *const OMHTTPAllowInvalidCertificates;
                                         parameters:(nullable NSDictionary *)parameters
                                            options:(nullable NSDictionary *)options __deprecated;
 
+/** Perform an HTTP request to the URL of a route.
+
+ Parameters used by the placeholders of the route are removed before the remaining
+ ones are serialized, like for the convenience methods. Keeping the route around
+ spares parsing its template with every request.
+
+ @param method The HTTP method to use. E.g. GET, POST, etc.
+ @param route The route to expand into the URL of the resource.
+ @param parameters Optional set of parameters, see requestWithMethod:url:parameters:options:.
+ @param options An optional set of HTTP headers and method specific options, see
+                requestWithMethod:url:parameters:options:.
+ @return A promise that yields an OMHTTPResponse instance if successful.
+ @see OMHTTPRoute
+ */
++ (OMPromise<OMHTTPResponse *> *)requestWithMethod:(NSString *)method
+                                             route:(OMHTTPRoute *)route
+                                        parameters:(nullable NSDictionary *)parameters
+                                           options:(nullable NSDictionary *)options;
+
 ///---------------------------------------------------------------------------------------
 /// @name Convenience Methods
 ///---------------------------------------------------------------------------------------
@@ -132,6 +330,8 @@ extern NSString *const OMHTTPAllowInvalidCertificates;
 /** Convenience method to perform an HTTP GET request.
  
  Uses OMHTTPSerializationQueryString for OMHTTPSerialization if not specified otherwise.
+ Identical requests in flight share a single connection unless OMHTTPCoalesce is
+ disabled.
  
  @see requestWithMethod:url:parameters:options:
  */
@@ -23,12 +23,20 @@
 // THE SOFTWARE.
 //
 
-#import "OMHTTPRequest.h"
+#import "OMHTTPRequest+Internal.h"
 
+#import "OMDeferredStream.h"
+#import "OMHTTPCompression.h"
 #import "OMHTTPResponse.h"
+#import "OMHTTPResponseCache+Internal.h"
+#import "OMHTTPRetryPolicy.h"
+#import "OMHTTPRoute.h"
+#import "OMHTTPScheduler.h"
+#import "OMPromiseCache.h"
 
 static const NSTimeInterval kDefaultTimeoutInterval = 20.;
 static const float kDefaultLookupProgress = .05f;
+static const NSUInteger kDefaultCompressionThreshold = 1024;
 
 NSString *const OMPromisesHTTPErrorDomain = @"de.reaktor42.OMPromises.HTTP";
 NSString *const OMHTTPResponseKey = @"response";
@@ -39,137 +47,544 @@ NSString *const OMHTTPSerializationQueryString = @"querystring";
 NSString *const OMHTTPSerializationJSON = @"json";
 NSString *const OMHTTPSerializationURLEncoded = @"urlencoded";
 NSString *const OMHTTPAllowInvalidCertificates = @"allowinvalidcertificates";
-
-@interface OMHTTPRequest () <NSURLConnectionDelegate, NSURLConnectionDataDelegate>
+NSString *const OMHTTPCoalesce = @"OMHTTPCoalesce";
+NSString *const OMHTTPStreamBody = @"OMHTTPStreamBody";
+NSString *const OMHTTPDownloadToFile = @"OMHTTPDownloadToFile";
+NSString *const OMHTTPResumeData = @"OMHTTPResumeData";
+NSString *const OMHTTPResumeDataKey = @"resumeData";
+NSString *const OMHTTPPriorityOption = @"OMHTTPPriorityOption";
+NSString *const OMHTTPRetryAttempts = @"OMHTTPRetryAttempts";
+NSString *const OMHTTPRetryDelay = @"OMHTTPRetryDelay";
+NSString *const OMHTTPRetryStatusCodes = @"OMHTTPRetryStatusCodes";
+NSString *const OMHTTPHedgeDelay = @"OMHTTPHedgeDelay";
+NSString *const OMHTTPCache = @"OMHTTPCache";
+NSString *const OMHTTPStaleWhileRevalidate = @"OMHTTPStaleWhileRevalidate";
+NSString *const OMHTTPCompression = @"OMHTTPCompression";
+NSString *const OMHTTPCompressionGzip = @"gzip";
+NSString *const OMHTTPCompressionDeflate = @"deflate";
+NSString *const OMHTTPCompressionThreshold = @"OMHTTPCompressionThreshold";
+
+@interface OMHTTPRequest ()
 
 @property(assign, nonatomic) float lookup;
-@property(nonatomic) NSURLConnection *connection;
+@property(nonatomic) NSURLSessionTask *task;
 @property(nonatomic) OMHTTPResponse *response;
 @property(nonatomic) NSMutableData *data;
 @property(assign, nonatomic) NSUInteger expectedContentLength;
 @property(nonatomic) BOOL allowInvalidCertificates;
 
+/** Receives the body if streamed, chunks are only kept while the consumer falls behind. */
+@property(nonatomic) OMDeferredStream *bodyStream;
+@property(nonatomic) NSMutableArray *pendingChunks;
+@property(assign, nonatomic) BOOL suspended;
+@property(assign, nonatomic) BOOL finished;
+
+- (void)didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge
+          completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition, NSURLCredential *))completionHandler;
+- (void)didReceiveResponse:(NSURLResponse *)response
+         completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler;
+- (void)didReceiveData:(NSData *)data;
+- (void)didWriteData:(int64_t)totalBytesWritten totalBytesExpectedToWrite:(int64_t)totalBytesExpectedToWrite;
+- (void)didFinishDownloadingToURL:(NSURL *)location response:(NSHTTPURLResponse *)response;
+- (void)didCompleteWithError:(NSError *)error;
+
+@end
+
+/** Owns the session shared by all requests and dispatches its delegate callbacks
+ to the respective request.
+
+ The session retains its delegate, thus requests are kept in a table of their own
+ until their task completes.
+ */
+@interface OMHTTPSession : NSObject <NSURLSessionDataDelegate, NSURLSessionDownloadDelegate>
+
+@property(readonly) NSURLSession *session;
+
++ (OMHTTPSession *)sharedSession;
+
+/** Replaces the session by one consulting the protocol classes first, the previous
+ one is invalidated once its tasks finished.
+ */
+- (void)setProtocolClasses:(NSArray *)protocolClasses;
+
+/** Dispatches the callbacks of the task to the request, the task still has to be
+ resumed.
+ */
+- (NSURLSessionTask *)registerTask:(NSURLSessionTask *)task forRequest:(OMHTTPRequest *)httpRequest;
+
+/** Stop dispatching the callbacks of a task which never got resumed.
+ */
+- (void)unregisterTask:(NSURLSessionTask *)task;
+
+/** Runs the block on the delegate queue, serialized with all callbacks.
+ */
+- (void)perform:(void (^)(void))block;
+
+@end
+
+@implementation OMHTTPSession {
+    NSURLSession *_session;
+    NSOperationQueue *_queue;
+    NSMutableDictionary *_requests;
+}
+
++ (OMHTTPSession *)sharedSession {
+    static OMHTTPSession *session = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        session = [OMHTTPSession new];
+    });
+
+    return session;
+}
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _requests = [NSMutableDictionary dictionary];
+
+        // callbacks are serialized on a queue of their own, never on the main thread
+        _queue = [NSOperationQueue new];
+        _queue.name = @"de.reaktor42.OMPromises.HTTP";
+        _queue.maxConcurrentOperationCount = 1;
+
+        _session = [self sessionWithProtocolClasses:nil];
+    }
+    return self;
+}
+
+- (NSURLSession *)sessionWithProtocolClasses:(NSArray *)protocolClasses {
+    NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+    configuration.requestCachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+
+    if (protocolClasses.count > 0) {
+        configuration.protocolClasses = [protocolClasses arrayByAddingObjectsFromArray:configuration.protocolClasses ?: @[]];
+    }
+
+    return [NSURLSession sessionWithConfiguration:configuration delegate:self delegateQueue:_queue];
+}
+
+- (NSURLSession *)session {
+    @synchronized (self) {
+        return _session;
+    }
+}
+
+- (void)setProtocolClasses:(NSArray *)protocolClasses {
+    NSURLSession *previous = nil;
+
+    @synchronized (self) {
+        previous = _session;
+        _session = [self sessionWithProtocolClasses:protocolClasses];
+    }
+
+    [previous finishTasksAndInvalidate];
+}
+
+- (NSURLSessionTask *)registerTask:(NSURLSessionTask *)task forRequest:(OMHTTPRequest *)httpRequest {
+    @synchronized (self) {
+        _requests[@(task.taskIdentifier)] = httpRequest;
+    }
+
+    return task;
+}
+
+- (void)unregisterTask:(NSURLSessionTask *)task {
+    @synchronized (self) {
+        [_requests removeObjectForKey:@(task.taskIdentifier)];
+    }
+}
+
+- (void)perform:(void (^)(void))block {
+    [_queue addOperationWithBlock:block];
+}
+
+- (OMHTTPRequest *)requestForTask:(NSURLSessionTask *)task {
+    @synchronized (self) {
+        return _requests[@(task.taskIdentifier)];
+    }
+}
+
+#pragma mark - NSURLSessionTaskDelegate
+
+- (void)URLSession:(NSURLSession *)session
+              task:(NSURLSessionTask *)task
+didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge
+ completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition, NSURLCredential *))completionHandler
+{
+    OMHTTPRequest *request = [self requestForTask:task];
+
+    if (request) {
+        [request didReceiveChallenge:challenge completionHandler:completionHandler];
+    } else {
+        completionHandler(NSURLSessionAuthChallengePerformDefaultHandling, nil);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    OMHTTPRequest *request = nil;
+
+    @synchronized (self) {
+        request = _requests[@(task.taskIdentifier)];
+        [_requests removeObjectForKey:@(task.taskIdentifier)];
+    }
+
+    [[OMHTTPScheduler sharedScheduler] taskCompleted:task];
+    [request didCompleteWithError:error];
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    OMHTTPRequest *request = [self requestForTask:dataTask];
+
+    if (request) {
+        [request didReceiveResponse:response completionHandler:completionHandler];
+    } else {
+        completionHandler(NSURLSessionResponseCancel);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    [[self requestForTask:dataTask] didReceiveData:data];
+}
+
+#pragma mark - NSURLSessionDownloadDelegate
+
+- (void)URLSession:(NSURLSession *)session
+      downloadTask:(NSURLSessionDownloadTask *)downloadTask
+      didWriteData:(int64_t)bytesWritten
+ totalBytesWritten:(int64_t)totalBytesWritten
+totalBytesExpectedToWrite:(int64_t)totalBytesExpectedToWrite
+{
+    [[self requestForTask:downloadTask] didWriteData:totalBytesWritten totalBytesExpectedToWrite:totalBytesExpectedToWrite];
+}
+
+- (void)URLSession:(NSURLSession *)session
+      downloadTask:(NSURLSessionDownloadTask *)downloadTask
+ didResumeAtOffset:(int64_t)fileOffset
+expectedTotalBytes:(int64_t)expectedTotalBytes
+{
+    [[self requestForTask:downloadTask] didWriteData:fileOffset totalBytesExpectedToWrite:expectedTotalBytes];
+}
+
+- (void)URLSession:(NSURLSession *)session
+      downloadTask:(NSURLSessionDownloadTask *)downloadTask
+didFinishDownloadingToURL:(NSURL *)location
+{
+    [[self requestForTask:downloadTask] didFinishDownloadingToURL:location
+                                                         response:(NSHTTPURLResponse *)downloadTask.response];
+}
+
 @end
 
 @implementation OMHTTPRequest
 
 #pragma mark - Init
 
-- (id)initWithURL:(NSURL *)url
-           method:(NSString *)method
-       parameters:(NSDictionary *)parameters
-          options:(NSDictionary *)options
-{
+- (id)initWithRequest:(NSURLRequest *)request options:(NSDictionary *)options {
     self = [super init];
     if (self) {
-        NSAssert(url, @"URL is required.");
-        NSAssert(method, @"Method is required.");
-        NSAssert([url.scheme.lowercaseString hasPrefix:@"http"], @"Only HTTP(S) requests are supported.");
-        
         _lookup = options[OMHTTPLookupProgress] ? [options[OMHTTPLookupProgress] floatValue] : kDefaultLookupProgress;
         _allowInvalidCertificates = [(options[OMHTTPAllowInvalidCertificates] ?: @NO) boolValue];
 
-        NSURLRequest *request = [self requestForURL:url method:method parameters:parameters options:options];
+        BOOL streamBody = [(options[OMHTTPStreamBody] ?: @NO) boolValue];
+        BOOL downloadToFile = [(options[OMHTTPDownloadToFile] ?: @NO) boolValue] || options[OMHTTPResumeData];
+        NSAssert(!(streamBody && downloadToFile), @"The body can either be streamed or downloaded to a file.");
 
-        _connection  = [[NSURLConnection alloc] initWithRequest:request delegate:self startImmediately:NO];
+        NSURLSession *session = [OMHTTPSession sharedSession].session;
+        NSURLSessionTask *task = nil;
 
-        // make sure that the feedback queue is available all the time
-        // TODO: Switch to NSURLSession and use a custom queue for these events.
-        [_connection scheduleInRunLoop:[NSRunLoop mainRunLoop]
-                               forMode:NSDefaultRunLoopMode];
-        [_connection start];
+        if (options[OMHTTPResumeData]) {
+            task = [session downloadTaskWithResumeData:options[OMHTTPResumeData]];
+        } else if (downloadToFile) {
+            task = [session downloadTaskWithRequest:request];
+        } else {
+            task = [session dataTaskWithRequest:request];
+        }
 
-        // cancellation support
+        if (streamBody) {
+            [self prepareBodyStream];
+        }
+
+        _task = [[OMHTTPSession sharedSession] registerTask:task forRequest:self];
+
+        // cancellation support, a queued task is dropped without ever connecting
         __weak OMHTTPRequest *weakSelf = self;
         [self cancelled:^(OMDeferred *_) {
-            [weakSelf.connection cancel];
+            NSURLSessionTask *queuedTask = weakSelf.task;
+            if ([[OMHTTPScheduler sharedScheduler] dequeueTask:queuedTask]) {
+                [[OMHTTPSession sharedSession] unregisterTask:queuedTask];
+            }
+            [queuedTask cancel];
         }];
+
+        OMHTTPPriority priority = [(options[OMHTTPPriorityOption] ?: @(OMHTTPPriorityNormal)) integerValue];
+        if ([_task respondsToSelector:@selector(setPriority:)]) {
+            _task.priority = priority == OMHTTPPriorityHigh ? NSURLSessionTaskPriorityHigh
+                : priority == OMHTTPPriorityLow ? NSURLSessionTaskPriorityLow : NSURLSessionTaskPriorityDefault;
+        }
+
+        [[OMHTTPScheduler sharedScheduler] enqueueTask:_task priority:priority];
     }
     return self;
 }
 
-#pragma mark - NSURLConnectionDelegate
+#pragma mark - Session Callbacks
 
-- (void)connection:(NSURLConnection *)connection
-        willSendRequestForAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge
+- (void)didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge
+          completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition, NSURLCredential *))completionHandler
 {
     if (self.allowInvalidCertificates &&
             [challenge.protectionSpace.authenticationMethod isEqualToString:NSURLAuthenticationMethodServerTrust])
     {
-        [challenge.sender useCredential:[NSURLCredential credentialForTrust:challenge.protectionSpace.serverTrust]
-             forAuthenticationChallenge:challenge];
+        completionHandler(NSURLSessionAuthChallengeUseCredential,
+                          [NSURLCredential credentialForTrust:challenge.protectionSpace.serverTrust]);
 
         return;
     }
 
-    [challenge.sender performDefaultHandlingForAuthenticationChallenge:challenge];
+    completionHandler(NSURLSessionAuthChallengePerformDefaultHandling, nil);
 }
 
-- (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
-    NSMutableDictionary *userInfo = @{
-        NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to perform HTTP request: %@", error],
-        NSUnderlyingErrorKey: error
-    }.mutableCopy;
+- (void)didReceiveResponse:(NSHTTPURLResponse *)response
+         completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+    NSAssert([response isKindOfClass:NSHTTPURLResponse.class], @"An NSHTTPURLResponse was expected!");
+    
+    self.expectedContentLength = (NSUInteger)(response.expectedContentLength > 0 ? response.expectedContentLength : 0);
 
-    if (self.response) {
-        userInfo[OMHTTPResponseKey] = self.response;
+    // streamed bodies and the ones of failed responses are never appended, don't reserve room for them
+    if (response.statusCode < 400 && !self.bodyStream) {
+        self.data = [NSMutableData dataWithCapacity:self.expectedContentLength > 0 ? self.expectedContentLength : 16];
+    } else {
+        self.data = [NSMutableData data];
     }
 
-    [self fail:[NSError errorWithDomain:OMPromisesHTTPErrorDomain
-                                   code:OMPromisesHTTPRequestError
-                               userInfo:userInfo]];
+    self.response = [[OMHTTPResponse alloc] initWithCode:(NSUInteger)response.statusCode
+                                                 headers:response.allHeaderFields
+                                                    body:self.data];
+    
+    if (response.statusCode >= 400) {
+        [self.bodyStream cancel];
+        completionHandler(NSURLSessionResponseCancel);
+
+        [self tryFail:[self statusError]];
+    } else if (self.bodyStream) {
+        completionHandler(NSURLSessionResponseAllow);
+
+        // the body follows using the stream
+        [self tryFulfil:[[OMHTTPResponse alloc] initWithCode:(NSUInteger)response.statusCode
+                                                     headers:response.allHeaderFields
+                                                  bodyStream:self.bodyStream.stream]];
+    } else {
+        completionHandler(NSURLSessionResponseAllow);
+
+        [self tryProgress:self.lookup];
+    }
 }
 
-#pragma mark - NSURLConnectionDataDelegate Methods
+- (void)didReceiveData:(NSData *)data {
+    if (self.bodyStream) {
+        [self streamChunk:data];
+        return;
+    }
 
-- (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
     [self.data appendData:data];
     
     if (self.expectedContentLength > 0) {
-        [self progress:MIN(1.0f, self.lookup + (1 - self.lookup) *
+        [self tryProgress:MIN(1.0f, self.lookup + (1 - self.lookup) *
                 (float)self.data.length / self.expectedContentLength)];
     }
 }
 
-- (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSHTTPURLResponse *)response {
+- (void)didWriteData:(int64_t)totalBytesWritten totalBytesExpectedToWrite:(int64_t)totalBytesExpectedToWrite {
+    if (totalBytesExpectedToWrite > 0) {
+        [self tryProgress:MIN(1.0f, self.lookup + (1 - self.lookup) *
+                (float)totalBytesWritten / totalBytesExpectedToWrite)];
+    }
+}
+
+- (void)didFinishDownloadingToURL:(NSURL *)location response:(NSHTTPURLResponse *)response {
     NSAssert([response isKindOfClass:NSHTTPURLResponse.class], @"An NSHTTPURLResponse was expected!");
-    
-    self.expectedContentLength = (NSUInteger)(response.expectedContentLength > 0 ? response.expectedContentLength : 0);
-    self.data = [NSMutableData dataWithCapacity:self.expectedContentLength > 0 ? self.expectedContentLength : 16];
+
+    // the location is only valid until returning
+    NSString *name = [NSString stringWithFormat:@"OMPromises-%@", [NSUUID UUID].UUIDString];
+    NSURL *url = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+
+    NSError *error = nil;
+    if (![[NSFileManager defaultManager] moveItemAtURL:location toURL:url error:&error]) {
+        [self tryFail:[NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                                          code:OMPromisesHTTPRequestError
+                                      userInfo:@{
+                                          NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to keep the downloaded file: %@", error],
+                                          NSUnderlyingErrorKey: error
+                                      }]];
+        return;
+    }
+
     self.response = [[OMHTTPResponse alloc] initWithCode:(NSUInteger)response.statusCode
                                                  headers:response.allHeaderFields
-                                                    body:self.data];
-    
+                                                 bodyURL:url];
+
     if (response.statusCode >= 400) {
-        [connection cancel];
-
-        [self fail:[NSError errorWithDomain:OMPromisesHTTPErrorDomain
-                                       code:OMPromisesHTTPStatusError
-                                   userInfo:@{
-                                       NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Server responded with status code %i: %@.",
-                                           response.statusCode, [NSHTTPURLResponse localizedStringForStatusCode:response.statusCode]],
-                                       OMHTTPResponseKey: self.response
-                                   }]];
-    } else {
-        [self progress:self.lookup];
+        [self tryFail:[self statusError]];
+    }
+}
+
+- (void)didCompleteWithError:(NSError *)error {
+    if (error == nil) {
+        [self tryFulfil:self.response];
+
+        if (self.bodyStream) {
+            self.finished = YES;
+            [self flushChunks];
+        }
+        return;
+    }
+
+    NSMutableDictionary *userInfo = @{
+        NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to perform HTTP request: %@", error],
+        NSUnderlyingErrorKey: error
+    }.mutableCopy;
+
+    if (self.response) {
+        userInfo[OMHTTPResponseKey] = self.response;
+    }
+
+    if (error.userInfo[NSURLSessionDownloadTaskResumeData]) {
+        userInfo[OMHTTPResumeDataKey] = error.userInfo[NSURLSessionDownloadTaskResumeData];
+    }
+
+    // does nothing if already failed due to the status code or a cancellation
+    NSError *requestError = [NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                                                code:OMPromisesHTTPRequestError
+                                            userInfo:userInfo];
+    [self tryFail:requestError];
+    [self.bodyStream fail:requestError];
+}
+
+- (NSError *)statusError {
+    NSUInteger statusCode = self.response.statusCode;
+
+    return [NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                               code:OMPromisesHTTPStatusError
+                           userInfo:@{
+                               NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Server responded with status code %i: %@.",
+                                   (int)statusCode, [NSHTTPURLResponse localizedStringForStatusCode:(NSInteger)statusCode]],
+                               OMHTTPResponseKey: self.response
+                           }];
+}
+
+#pragma mark - Streaming
+
+- (void)prepareBodyStream {
+    self.bodyStream = [OMDeferredStream new];
+    self.pendingChunks = [NSMutableArray array];
+
+    // the handlers are dropped once the stream terminates, keeping the request alive until then
+    OMHTTPSession *session = [OMHTTPSession sharedSession];
+    [self.bodyStream requested:^(NSUInteger count) {
+        [session perform:^{
+            [self flushChunks];
+        }];
+    }];
+    [self.bodyStream cancelled:^{
+        [self.task cancel];
+    }];
+}
+
+/** Passes the chunk on as is, or holds it back and stops reading if the consumer
+ falls behind.
+ */
+- (void)streamChunk:(NSData *)chunk {
+    if (self.pendingChunks.count == 0 && [self.bodyStream push:chunk]) {
+        return;
+    }
+
+    [self.pendingChunks addObject:chunk];
+
+    if (!self.suspended) {
+        self.suspended = YES;
+        [self.task suspend];
     }
 }
 
-- (void)connectionDidFinishLoading:(NSURLConnection *)connection {
-    [self fulfil:self.response];
+/** Pushes held back chunks as far as demanded, then either continues reading or
+ completes the stream.
+ */
+- (void)flushChunks {
+    while (self.pendingChunks.count > 0 && [self.bodyStream push:self.pendingChunks[0]]) {
+        [self.pendingChunks removeObjectAtIndex:0];
+    }
+
+    if (self.pendingChunks.count > 0) {
+        return;
+    }
+
+    if (self.finished) {
+        [self.bodyStream complete];
+    } else if (self.suspended) {
+        self.suspended = NO;
+        [self.task resume];
+    }
 }
 
 #pragma mark - Public Static Methods
 
++ (NSUInteger)maximumConcurrentRequests {
+    return [OMHTTPScheduler sharedScheduler].maximumConcurrentTasks;
+}
+
++ (void)setMaximumConcurrentRequests:(NSUInteger)maximumConcurrentRequests {
+    [OMHTTPScheduler sharedScheduler].maximumConcurrentTasks = maximumConcurrentRequests;
+}
+
++ (NSUInteger)maximumConcurrentRequestsPerHost {
+    return [OMHTTPScheduler sharedScheduler].maximumConcurrentTasksPerHost;
+}
+
++ (void)setMaximumConcurrentRequestsPerHost:(NSUInteger)maximumConcurrentRequestsPerHost {
+    [OMHTTPScheduler sharedScheduler].maximumConcurrentTasksPerHost = maximumConcurrentRequestsPerHost;
+}
+
 + (OMPromise *)requestWithMethod:(NSString *)method
                              url:(NSURL *)url
                       parameters:(NSDictionary *)parameters
                          options:(NSDictionary *)options
 {
-    return [[OMHTTPRequest alloc] initWithURL:url
-                                       method:method
-                                   parameters:parameters
-                                      options:options].promise;
+    NSURLRequest *request = [OMHTTPRequest requestForURL:url method:method parameters:parameters options:options];
+
+    OMHTTPResponseCache *cache = options[OMHTTPCache];
+    if (cache && [method isEqualToString:@"GET"] && ![(options[OMHTTPStreamBody] ?: @NO) boolValue] &&
+            ![(options[OMHTTPDownloadToFile] ?: @NO) boolValue] && !options[OMHTTPResumeData])
+    {
+        return [cache responseForRequest:request
+                    staleWhileRevalidate:[(options[OMHTTPStaleWhileRevalidate] ?: @NO) boolValue]
+                                 perform:^OMPromise *(NSURLRequest *revalidation) {
+                                     return [OMHTTPRequest performRequest:revalidation options:options];
+                                 }];
+    } else if (cache && [[NSSet setWithObjects:@"POST", @"PUT", @"PATCH", @"DELETE", nil] containsObject:method]) {
+        return [cache responseForUnsafeRequest:request perform:^OMPromise *(NSURLRequest *unsafe) {
+            return [OMHTTPRequest performRequest:unsafe options:options];
+        }];
+    }
+
+    return [OMHTTPRequest performRequest:request options:options];
+}
+
++ (OMPromise *)requestWithMethod:(NSString *)method
+                           route:(OMHTTPRoute *)route
+                      parameters:(NSDictionary *)parameters
+                         options:(NSDictionary *)options
+{
+    NSURL *url = [route URLWithParameters:parameters remainingParameters:&parameters];
+
+    return [OMHTTPRequest requestWithMethod:method url:url parameters:parameters options:options];
 }
 
 + (OMPromise *)get:(NSString *)urlString
@@ -227,6 +642,12 @@ NSString *const OMHTTPAllowInvalidCertificates = @"allowinvalidcertificates";
                              defaultOptions:nil];
 }
 
+#pragma mark - Internal Methods
+
++ (void)setProtocolClasses:(NSArray *)protocolClasses {
+    [[OMHTTPSession sharedSession] setProtocolClasses:protocolClasses];
+}
+
 #pragma mark - Private Helper Methods
 
 + (OMPromise *)requestWithMethod:(NSString *)method
@@ -235,56 +656,182 @@ NSString *const OMHTTPAllowInvalidCertificates = @"allowinvalidcertificates";
                          options:(NSDictionary *)options
                   defaultOptions:(NSDictionary *)defaultOptions
 {
-    // merge default options
-    if (defaultOptions) {
-        NSMutableDictionary *mutableOptions = defaultOptions.mutableCopy;
-        [mutableOptions addEntriesFromDictionary:options];
-        options = mutableOptions;
-    }
-    
-    // interpolate url string
-    if (parameters && parameters.count > 0) {
-        NSMutableDictionary *mutableParameters = parameters.mutableCopy;
-        NSMutableString *mutableUrlString = [NSMutableString stringWithCapacity:urlString.length];
-        
-        __block NSUInteger recentEnd = 0;
-        [[NSRegularExpression regularExpressionWithPattern:@"\\{\\w+\\}" options:0 error:nil]
-            enumerateMatchesInString:urlString options:0
-            range:NSMakeRange(0, urlString.length)
-            usingBlock:^(NSTextCheckingResult *result, NSMatchingFlags flags, BOOL *stop) {
-                [mutableUrlString appendString:[urlString substringWithRange:NSMakeRange(recentEnd, result.range.location - recentEnd)]];
-                recentEnd = result.range.location + result.range.length;
-                
-                NSString *key = [urlString substringWithRange:NSMakeRange(result.range.location + 1, result.range.length - 2)];
-                NSString *value = [OMHTTPRequest escapeString:parameters[key]];
-                
-                if (value) {
-                    [mutableUrlString appendString:value];
-                    [mutableParameters removeObjectForKey:key];
-                }
-            }];
-        
-        if (recentEnd > 0) {
-            [mutableUrlString appendString:[urlString substringFromIndex:recentEnd]];
-            urlString = mutableUrlString;
-            parameters = mutableParameters;
+    // merge default options, without copying unless some of them apply
+    if (options.count == 0) {
+        options = defaultOptions;
+    } else {
+        for (NSString *key in defaultOptions) {
+            if (options[key] == nil) {
+                NSMutableDictionary *mutableOptions = defaultOptions.mutableCopy;
+                [mutableOptions addEntriesFromDictionary:options];
+                options = mutableOptions;
+                break;
+            }
         }
     }
 
-    // trim leading/trailing whitespace
-    urlString = [urlString stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
-    
+    // interpolate url string using a route parsed once per template
+    NSURL *url = nil;
+    if (parameters.count > 0) {
+        url = [[OMHTTPRoute routeWithTemplate:urlString] URLWithParameters:parameters remainingParameters:&parameters];
+    } else {
+        url = [NSURL URLWithString:[urlString stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]]];
+    }
+
     return [OMHTTPRequest requestWithMethod:method
-                                        url:[NSURL URLWithString:urlString]
+                                        url:url
                                  parameters:parameters
                                     options:options];
 }
 
-- (NSURLRequest *)requestForURL:(NSURL *)url
+/** Performs the request, retried, hedged and coalesced as declared by the options.
+ */
++ (OMPromise *)performRequest:(NSURLRequest *)request options:(NSDictionary *)options {
+    OMPromise *(^attempt)(void) = ^OMPromise *{
+        return [[OMHTTPRequest alloc] initWithRequest:request options:options].promise;
+    };
+
+    // downloads only provide their response once finished, they would be hedged each time
+    if (options[OMHTTPHedgeDelay] && [request.HTTPMethod isEqualToString:@"GET"] && !options[OMHTTPResumeData] &&
+            ![(options[OMHTTPDownloadToFile] ?: @NO) boolValue])
+    {
+        NSTimeInterval delay = [options[OMHTTPHedgeDelay] doubleValue];
+        attempt = ^OMPromise *{
+            return [OMHTTPRequest hedgedRequest:request options:options after:delay];
+        };
+    }
+
+    OMHTTPRetryPolicy *policy = [OMHTTPRetryPolicy policyForMethod:request.HTTPMethod options:options];
+    if (policy) {
+        OMPromise *(^single)(void) = attempt;
+        attempt = ^OMPromise *{
+            return [policy perform:single];
+        };
+    }
+
+    // a streamed body has a single consumer only
+    if (![request.HTTPMethod isEqualToString:@"GET"] || ![(options[OMHTTPCoalesce] ?: @YES) boolValue] ||
+            [(options[OMHTTPStreamBody] ?: @NO) boolValue] || options[OMHTTPResumeData])
+    {
+        return attempt();
+    }
+
+    return [[OMHTTPRequest coalescingCache]
+        promiseForKey:[OMHTTPRequest coalescingKeyForRequest:request options:options]
+                 task:attempt];
+}
+
+/** Sends the request a second time if the first one has not received a response
+ within the delay. The first one to succeed wins and the other one is cancelled,
+ the one failing last determines the error otherwise.
+ */
++ (OMPromise *)hedgedRequest:(NSURLRequest *)request options:(NSDictionary *)options after:(NSTimeInterval)delay {
+    OMDeferred *deferred = [OMDeferred new];
+    OMHTTPRequest *first = [[OMHTTPRequest alloc] initWithRequest:request options:options];
+
+    // requests still running, emptied once decided
+    NSMutableArray *running = [NSMutableArray arrayWithObject:first];
+
+    void (^observe)(OMHTTPRequest *) = ^(OMHTTPRequest *httpRequest) {
+        [[httpRequest.promise
+            progressed:^(float progress) {
+                [deferred tryProgress:progress];
+            } on:nil]
+            always:^(OMPromiseState state, id result, NSError *error) {
+                NSArray *losers = nil;
+                @synchronized (running) {
+                    if (![running containsObject:httpRequest] ||
+                            (state == OMPromiseStateFailed && running.count > 1))
+                    {
+                        [running removeObject:httpRequest];
+                        return;
+                    }
+
+                    [running removeObject:httpRequest];
+                    losers = running.copy;
+                    [running removeAllObjects];
+                }
+
+                for (OMHTTPRequest *loser in losers) {
+                    [loser.promise cancel];
+                }
+
+                if (state == OMPromiseStateFulfilled) {
+                    [deferred tryFulfil:result];
+                } else {
+                    [deferred tryFail:error];
+                }
+            } on:nil];
+    };
+
+    [deferred cancelled:^(OMDeferred *_) {
+        NSArray *requests = nil;
+        @synchronized (running) {
+            requests = running.copy;
+            [running removeAllObjects];
+        }
+
+        for (OMHTTPRequest *httpRequest in requests) {
+            [httpRequest.promise cancel];
+        }
+    }];
+
+    observe(first);
+
+    // checked on the delegate queue, the response of the first one is set there
+    [[OMPromise promiseWithResult:nil after:delay] fulfilled:^(id _) {
+        [[OMHTTPSession sharedSession] perform:^{
+            OMHTTPRequest *second = nil;
+            @synchronized (running) {
+                if (first.response || ![running containsObject:first]) {
+                    return;
+                }
+
+                second = [[OMHTTPRequest alloc] initWithRequest:request options:options];
+                [running addObject:second];
+            }
+
+            observe(second);
+        }];
+    } on:nil];
+
+    return deferred.promise;
+}
+
++ (OMPromiseCache *)coalescingCache {
+    static OMPromiseCache *cache = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        cache = [OMPromiseCache new];
+        cache.timeToLive = 0.;
+    });
+
+    return cache;
+}
+
+/** Identical GET requests share a key, a response fetched without validating the
+ certificate is never shared with requests which do validate it. Neither are
+ downloaded files shared with requests expecting the body in memory.
+ */
++ (id<NSCopying>)coalescingKeyForRequest:(NSURLRequest *)request options:(NSDictionary *)options {
+    return @[
+        request.HTTPMethod,
+        request.URL.absoluteString,
+        request.allHTTPHeaderFields ?: @{},
+        options[OMHTTPAllowInvalidCertificates] ?: @NO,
+        options[OMHTTPDownloadToFile] ?: @NO
+    ];
+}
+
++ (NSURLRequest *)requestForURL:(NSURL *)url
                          method:(NSString *)method
                      parameters:(NSDictionary *)parameters
                         options:(NSDictionary *)options
 {
+    NSAssert(url, @"URL is required.");
+    NSAssert(method, @"Method is required.");
+    NSAssert([url.scheme.lowercaseString hasPrefix:@"http"], @"Only HTTP(S) requests are supported.");
+
     // add query string to URL
     if (parameters && [options[OMHTTPSerialization] isEqualToString:OMHTTPSerializationQueryString]) {
         NSString *queryString = [OMHTTPRequest buildQueryString:parameters];
@@ -322,12 +869,30 @@ NSString *const OMHTTPAllowInvalidCertificates = @"allowinvalidcertificates";
     
     // add http headers
     NSSet *ownOptions = [NSSet setWithObjects:OMHTTPTimeout, OMHTTPLookupProgress, OMHTTPSerialization,
-            OMHTTPAllowInvalidCertificates, nil];
+            OMHTTPAllowInvalidCertificates, OMHTTPCoalesce, OMHTTPStreamBody, OMHTTPDownloadToFile,
+            OMHTTPResumeData, OMHTTPPriorityOption, OMHTTPRetryAttempts, OMHTTPRetryDelay, OMHTTPRetryStatusCodes,
+            OMHTTPHedgeDelay, OMHTTPCache, OMHTTPStaleWhileRevalidate, OMHTTPCompression, OMHTTPCompressionThreshold, nil];
     for (NSString *key in options.keyEnumerator) {
         if (![ownOptions containsObject:key]) {
             [request setValue:options[key] forHTTPHeaderField:key];
         }
     }
+
+    // compress body, unless already encoded by the caller
+    NSUInteger threshold = options[OMHTTPCompressionThreshold] ?
+        [options[OMHTTPCompressionThreshold] unsignedIntegerValue] : kDefaultCompressionThreshold;
+    if (options[OMHTTPCompression] && request.HTTPBody.length >= threshold &&
+            ![request valueForHTTPHeaderField:@"Content-Encoding"])
+    {
+        NSData *compressed = OMCompressedData(request.HTTPBody, options[OMHTTPCompression]);
+        NSAssert(compressed, @"We should be able to compress the body using %@ but failed.", options[OMHTTPCompression]);
+
+        if (compressed && compressed.length < request.HTTPBody.length) {
+            request.HTTPBody = compressed;
+            [request setValue:options[OMHTTPCompression] forHTTPHeaderField:@"Content-Encoding"];
+            [request setValue:[@(compressed.length) stringValue] forHTTPHeaderField:@"Content-Length"];
+        }
+    }
     
     return request;
 }
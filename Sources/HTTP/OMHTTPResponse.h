@@ -25,6 +25,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import "OMStream.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
 /** Represents the outcome of a successful HTTP request operation.
@@ -38,6 +40,19 @@ NS_ASSUME_NONNULL_BEGIN
                      headers:(NSDictionary *)headers
                         body:(NSData *)body;
 
+/** Use this method to set the properties of a response whose body is streamed.
+ */
+- (instancetype)initWithCode:(NSUInteger)statusCode
+                     headers:(NSDictionary *)headers
+                  bodyStream:(OMStream<NSData *> *)bodyStream;
+
+/** Use this method to set the properties of a response whose body got downloaded
+ to a file. The response takes ownership of the file.
+ */
+- (instancetype)initWithCode:(NSUInteger)statusCode
+                     headers:(NSDictionary *)headers
+                     bodyURL:(NSURL *)bodyURL;
+
 /** The HTTP status code of the response.
  */
 @property(assign, readonly, nonatomic) NSUInteger statusCode;
@@ -46,10 +61,26 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property(readonly, nonatomic) NSDictionary *headers;
 
-/** The body of the response.
+/** The body of the response, nil if streamed.
+
+ If downloaded to a file, the file is mapped into memory the first time the body
+ is accessed, thus its pages are only loaded as they are read.
  */
 @property(readonly, nonatomic, nullable) NSData *body;
 
+/** The file containing the body, if OMHTTPDownloadToFile was requested.
+
+ The file is removed once the response is deallocated, move it elsewhere to keep
+ it. A mapped body remains valid regardless.
+ */
+@property(readonly, nonatomic, nullable) NSURL *bodyURL;
+
+/** The chunks of the body as they arrive, if OMHTTPStreamBody was requested.
+
+ The stream has to be consumed or cancelled, as it keeps the request alive.
+ */
+@property(readonly, nonatomic, nullable) OMStream<NSData *> *bodyStream;
+
 @end
 
 NS_ASSUME_NONNULL_END
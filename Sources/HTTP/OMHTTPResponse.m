@@ -27,6 +27,8 @@
 
 @implementation OMHTTPResponse
 
+@synthesize body = _body;
+
 #pragma mark - Init
 
 - (id)initWithCode:(NSUInteger)statusCode
@@ -42,6 +44,50 @@
     return self;
 }
 
+- (id)initWithCode:(NSUInteger)statusCode
+    headers:(NSDictionary *)headers
+    bodyStream:(OMStream *)bodyStream
+{
+    self = [super init];
+    if (self) {
+        _statusCode = statusCode;
+        _headers = headers;
+        _bodyStream = bodyStream;
+    }
+    return self;
+}
+
+- (id)initWithCode:(NSUInteger)statusCode
+    headers:(NSDictionary *)headers
+    bodyURL:(NSURL *)bodyURL
+{
+    self = [super init];
+    if (self) {
+        _statusCode = statusCode;
+        _headers = headers;
+        _bodyURL = bodyURL;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    if (_bodyURL) {
+        [[NSFileManager defaultManager] removeItemAtURL:_bodyURL error:nil];
+    }
+}
+
+#pragma mark - Properties
+
+- (NSData *)body {
+    @synchronized (self) {
+        if (_body == nil && _bodyURL != nil) {
+            _body = [NSData dataWithContentsOfURL:_bodyURL options:NSDataReadingMappedAlways error:nil];
+        }
+
+        return _body;
+    }
+}
+
 #pragma mark - NSObject Overrides
 
 - (NSString *)debugDescription {
@@ -0,0 +1,69 @@
+//
+// OMHTTPResponseCache.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** Keeps responses of GET requests to serve them again without downloading their
+ body, enabled per request using the OMHTTPCache option.
+
+ Responses are kept in memory as well as on disk, the least recently used ones
+ get evicted once the respective capacity is exceeded. Cached responses are used
+ as long as they are fresh according to their Cache-Control, Expires and
+ Last-Modified headers. Stale responses are revalidated using If-None-Match and
+ If-Modified-Since, an unmodified resource is answered using the cached body.
+ Responses marked no-store, without status code 200 or neither fresh nor carrying
+ a validator are never kept.
+ */
+@interface OMHTTPResponseCache : NSObject
+
+/** The cache shared by default, stored in the caches directory of the user.
+ */
++ (OMHTTPResponseCache *)sharedCache;
+
+/** Create a cache storing its responses in the directory.
+
+ @param directory The directory to store the responses in, created if necessary.
+                  Use nil to keep the responses in memory only.
+ @return A new cache.
+ */
+- (instancetype)initWithDirectory:(nullable NSURL *)directory NS_DESIGNATED_INITIALIZER;
+
+/** Maximum number of bytes of bodies kept in memory. Defaults to 4 MB.
+ */
+@property(assign) NSUInteger memoryCapacity;
+
+/** Maximum number of bytes stored on disk. Defaults to 32 MB.
+ */
+@property(assign) NSUInteger diskCapacity;
+
+/** Remove all responses, in memory as well as on disk.
+ */
+- (void)removeAllResponses;
+
+@end
+
+NS_ASSUME_NONNULL_END
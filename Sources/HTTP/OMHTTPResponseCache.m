@@ -0,0 +1,557 @@
+//
+// OMHTTPResponseCache.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMHTTPResponseCache+Internal.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+#import "OMDeferred.h"
+#import "OMHTTPResponse.h"
+#import "OMPromiseCache.h"
+
+static const NSUInteger kDefaultMemoryCapacity = 4 * 1024 * 1024;
+static const NSUInteger kDefaultDiskCapacity = 32 * 1024 * 1024;
+
+/** Upper bound of entries in memory, misses are remembered as well. */
+static const NSUInteger kMemoryCountLimit = 1024;
+
+/** Keys of the dictionaries describing cached responses, which are archived as is.
+ */
+static NSString *const kEntryStatusCode = @"statusCode";
+static NSString *const kEntryHeaders = @"headers";
+static NSString *const kEntryBody = @"body";
+static NSString *const kEntryDate = @"date";
+static NSString *const kEntryVary = @"vary";
+
+static NSString *OMHeaderValue(NSDictionary *headers, NSString *name) {
+    for (NSString *key in headers) {
+        if ([key caseInsensitiveCompare:name] == NSOrderedSame) {
+            return [headers[key] description];
+        }
+    }
+
+    return nil;
+}
+
+/** Directives of the Cache-Control header, lowercased, mapped to their value or
+ NSNull if they have none.
+ */
+static NSDictionary *OMCacheControl(NSDictionary *headers) {
+    NSMutableDictionary *directives = [NSMutableDictionary dictionary];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+
+    for (NSString *directive in [OMHeaderValue(headers, @"Cache-Control") componentsSeparatedByString:@","]) {
+        NSRange separator = [directive rangeOfString:@"="];
+        if (separator.location == NSNotFound) {
+            NSString *name = [directive stringByTrimmingCharactersInSet:whitespace].lowercaseString;
+            if (name.length > 0) {
+                directives[name] = [NSNull null];
+            }
+        } else {
+            NSString *name = [[directive substringToIndex:separator.location] stringByTrimmingCharactersInSet:whitespace];
+            NSString *value = [[directive substringFromIndex:NSMaxRange(separator)] stringByTrimmingCharactersInSet:whitespace];
+            directives[name.lowercaseString] = [value stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"\""]];
+        }
+    }
+
+    return directives;
+}
+
+static NSDate *OMDateOfHeader(NSDictionary *headers, NSString *name) {
+    static NSDateFormatter *formatter = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        formatter = [NSDateFormatter new];
+        formatter.locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneWithAbbreviation:@"GMT"];
+        formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss zzz";
+    });
+
+    NSString *value = OMHeaderValue(headers, name);
+    return value ? [formatter dateFromString:value] : nil;
+}
+
+/** Seconds the response is fresh for after it got stored.
+ */
+static NSTimeInterval OMFreshnessLifetime(NSDictionary *entry) {
+    NSDictionary *headers = entry[kEntryHeaders];
+    NSDictionary *cacheControl = OMCacheControl(headers);
+
+    if (cacheControl[@"no-cache"]) {
+        return 0.;
+    }
+
+    if ([cacheControl[@"max-age"] isKindOfClass:NSString.class]) {
+        return [cacheControl[@"max-age"] doubleValue];
+    }
+
+    NSDate *date = OMDateOfHeader(headers, @"Date") ?: entry[kEntryDate];
+    NSDate *expires = OMDateOfHeader(headers, @"Expires");
+    if (expires) {
+        return [expires timeIntervalSinceDate:date];
+    }
+
+    // heuristic freshness, a tenth of the time since its last modification
+    NSDate *lastModified = OMDateOfHeader(headers, @"Last-Modified");
+    if (lastModified) {
+        return MAX(0., [date timeIntervalSinceDate:lastModified] / 10.);
+    }
+
+    return 0.;
+}
+
+static NSTimeInterval OMEntryAge(NSDictionary *entry) {
+    return MAX(0., -[entry[kEntryDate] timeIntervalSinceNow]) +
+        MAX(0., [OMHeaderValue(entry[kEntryHeaders], @"Age") doubleValue]);
+}
+
+static BOOL OMEntryIsFresh(NSDictionary *entry, NSDictionary *requestCacheControl) {
+    if (requestCacheControl[@"no-cache"]) {
+        return NO;
+    }
+
+    NSTimeInterval lifetime = OMFreshnessLifetime(entry);
+    if ([requestCacheControl[@"max-age"] isKindOfClass:NSString.class]) {
+        lifetime = MIN(lifetime, [requestCacheControl[@"max-age"] doubleValue]);
+    }
+
+    return OMEntryAge(entry) < lifetime;
+}
+
+/** Whether the stale entry may be served while it is revalidated in the background.
+
+ Neither if the response or the request demand revalidation, nor once the entry is
+ stale for longer than the stale-while-revalidate window of the response.
+ */
+static BOOL OMEntryMayBeServedStale(NSDictionary *entry, NSDictionary *requestCacheControl) {
+    NSDictionary *cacheControl = OMCacheControl(entry[kEntryHeaders]);
+
+    if (requestCacheControl[@"no-cache"] || cacheControl[@"no-cache"] || cacheControl[@"must-revalidate"]) {
+        return NO;
+    }
+
+    id window = cacheControl[@"stale-while-revalidate"];
+    if ([window isKindOfClass:NSString.class]) {
+        return OMEntryAge(entry) < OMFreshnessLifetime(entry) + [window doubleValue];
+    }
+
+    return YES;
+}
+
+/** The response only applies to requests which match the request headers it
+ varies by.
+ */
+static BOOL OMEntryMatchesRequest(NSDictionary *entry, NSURLRequest *request) {
+    NSDictionary *vary = entry[kEntryVary];
+    for (NSString *name in vary) {
+        if (![vary[name] isEqualToString:OMHeaderValue(request.allHTTPHeaderFields, name) ?: @""]) {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+/** The entry to store for the response, nil if it must not or cannot be reused.
+ */
+static NSDictionary *OMEntryOfResponse(OMHTTPResponse *response, NSURLRequest *request) {
+    NSString *varyHeader = OMHeaderValue(response.headers, @"Vary");
+    if (response.statusCode != 200 || response.body == nil || [varyHeader rangeOfString:@"*"].location != NSNotFound ||
+            OMCacheControl(response.headers)[@"no-store"] || OMCacheControl(request.allHTTPHeaderFields)[@"no-store"])
+    {
+        return nil;
+    }
+
+    NSMutableDictionary *vary = [NSMutableDictionary dictionary];
+    for (NSString *name in [varyHeader componentsSeparatedByString:@","]) {
+        NSString *trimmed = [name stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        if (trimmed.length > 0) {
+            vary[trimmed] = OMHeaderValue(request.allHTTPHeaderFields, trimmed) ?: @"";
+        }
+    }
+
+    NSDictionary *entry = @{
+        kEntryStatusCode: @(response.statusCode),
+        kEntryHeaders: response.headers ?: @{},
+        kEntryBody: response.body,
+        kEntryDate: [NSDate date],
+        kEntryVary: vary
+    };
+
+    // useless if neither fresh nor revalidatable
+    if (OMFreshnessLifetime(entry) <= 0. && !OMHeaderValue(response.headers, @"ETag") &&
+            !OMHeaderValue(response.headers, @"Last-Modified"))
+    {
+        return nil;
+    }
+
+    return entry;
+}
+
+/** The entry updated by the headers of a 304 response, stored anew.
+ */
+static NSDictionary *OMEntryRevalidated(NSDictionary *entry, NSDictionary *headers) {
+    NSMutableDictionary *merged = [entry[kEntryHeaders] mutableCopy];
+    for (NSString *name in headers) {
+        if ([name caseInsensitiveCompare:@"Content-Length"] == NSOrderedSame) {
+            continue;
+        }
+
+        for (NSString *key in [merged allKeys]) {
+            if ([key caseInsensitiveCompare:name] == NSOrderedSame) {
+                [merged removeObjectForKey:key];
+            }
+        }
+        merged[name] = headers[name];
+    }
+
+    NSMutableDictionary *revalidated = entry.mutableCopy;
+    revalidated[kEntryHeaders] = merged;
+    revalidated[kEntryDate] = [NSDate date];
+
+    return revalidated;
+}
+
+static NSUInteger OMSizeOfFile(NSURL *file) {
+    NSNumber *size = nil;
+    [file getResourceValue:&size forKey:NSURLFileSizeKey error:nil];
+    return size.unsignedIntegerValue;
+}
+
+static OMHTTPResponse *OMResponseOfEntry(NSDictionary *entry) {
+    return [[OMHTTPResponse alloc] initWithCode:[entry[kEntryStatusCode] unsignedIntegerValue]
+                                        headers:entry[kEntryHeaders]
+                                           body:entry[kEntryBody]];
+}
+
+@implementation OMHTTPResponseCache {
+    NSURL *_directory;
+    /** Entries read from disk or stored recently, as well as misses. */
+    OMPromiseCache *_memory;
+    /** Serializes all file operations. */
+    dispatch_queue_t _diskQueue;
+    /** Bytes stored on disk, NSNotFound until measured. Only used on the disk queue. */
+    NSUInteger _diskSize;
+}
+
+#pragma mark - Init
+
++ (OMHTTPResponseCache *)sharedCache {
+    static OMHTTPResponseCache *cache = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSURL *caches = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory
+                                                                inDomains:NSUserDomainMask] firstObject];
+        cache = [[OMHTTPResponseCache alloc] initWithDirectory:[caches URLByAppendingPathComponent:@"de.reaktor42.OMPromises.HTTP"]];
+    });
+
+    return cache;
+}
+
+- (instancetype)initWithDirectory:(NSURL *)directory {
+    self = [super init];
+    if (self) {
+        _directory = directory;
+        _diskCapacity = kDefaultDiskCapacity;
+        _diskSize = NSNotFound;
+        _diskQueue = dispatch_queue_create("de.reaktor42.OMPromises.HTTPCache", DISPATCH_QUEUE_SERIAL);
+
+        _memory = [OMPromiseCache new];
+        _memory.countLimit = kMemoryCountLimit;
+        _memory.totalCostLimit = kDefaultMemoryCapacity;
+        _memory.costOfResult = ^NSUInteger(NSDictionary *entry) {
+            return [entry[kEntryBody] length];
+        };
+
+        if (directory) {
+            [[NSFileManager defaultManager] createDirectoryAtURL:directory
+                                     withIntermediateDirectories:YES
+                                                      attributes:nil
+                                                           error:nil];
+        }
+    }
+    return self;
+}
+
+- (instancetype)init {
+    return [self initWithDirectory:nil];
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)memoryCapacity {
+    return _memory.totalCostLimit;
+}
+
+- (void)setMemoryCapacity:(NSUInteger)memoryCapacity {
+    _memory.totalCostLimit = memoryCapacity;
+}
+
+#pragma mark - Public Methods
+
+- (void)removeAllResponses {
+    [_memory invalidateAll];
+
+    if (_directory) {
+        dispatch_async(_diskQueue, ^{
+            NSFileManager *fileManager = [NSFileManager defaultManager];
+            for (NSURL *file in [fileManager contentsOfDirectoryAtURL:_directory includingPropertiesForKeys:nil options:0 error:nil]) {
+                [fileManager removeItemAtURL:file error:nil];
+            }
+            _diskSize = NSNotFound;
+        });
+    }
+}
+
+#pragma mark - Internal Methods
+
+- (OMPromise *)responseForRequest:(NSURLRequest *)request
+             staleWhileRevalidate:(BOOL)staleWhileRevalidate
+                          perform:(OMPromise *(^)(NSURLRequest *))perform
+{
+    NSDictionary *requestCacheControl = OMCacheControl(request.allHTTPHeaderFields);
+    if (requestCacheControl[@"no-store"]) {
+        return perform(request);
+    }
+
+    NSString *key = request.URL.absoluteString;
+
+    return [[self entryForKey:key] then:^id(NSDictionary *entry) {
+        if (entry && !OMEntryMatchesRequest(entry, request)) {
+            entry = nil;
+        }
+
+        if (entry && OMEntryIsFresh(entry, requestCacheControl)) {
+            return OMResponseOfEntry(entry);
+        }
+
+        OMPromise *revalidation = [self fetchRequest:request entry:entry key:key perform:perform];
+
+        // the revalidation continues in the background
+        if (entry && staleWhileRevalidate && OMEntryMayBeServedStale(entry, requestCacheControl)) {
+            return OMResponseOfEntry(entry);
+        }
+
+        return revalidation;
+    } on:nil];
+}
+
+- (OMPromise *)responseForUnsafeRequest:(NSURLRequest *)request perform:(OMPromise *(^)(NSURLRequest *))perform {
+    NSString *key = request.URL.absoluteString;
+
+    return [perform(request) then:^id(OMHTTPResponse *response) {
+        [self removeEntryForKey:key];
+        return response;
+    } on:nil];
+}
+
+#pragma mark - Private Helper Methods
+
+- (OMPromise *)fetchRequest:(NSURLRequest *)request
+                      entry:(NSDictionary *)entry
+                        key:(NSString *)key
+                    perform:(OMPromise *(^)(NSURLRequest *))perform
+{
+    NSURLRequest *sent = request;
+
+    if (entry) {
+        NSMutableURLRequest *conditional = request.mutableCopy;
+        NSString *etag = OMHeaderValue(entry[kEntryHeaders], @"ETag");
+        NSString *lastModified = OMHeaderValue(entry[kEntryHeaders], @"Last-Modified");
+
+        if (etag && ![conditional valueForHTTPHeaderField:@"If-None-Match"]) {
+            [conditional setValue:etag forHTTPHeaderField:@"If-None-Match"];
+        }
+        if (lastModified && ![conditional valueForHTTPHeaderField:@"If-Modified-Since"]) {
+            [conditional setValue:lastModified forHTTPHeaderField:@"If-Modified-Since"];
+        }
+
+        sent = conditional;
+    }
+
+    return [perform(sent) then:^id(OMHTTPResponse *response) {
+        if (response.statusCode == 304 && entry) {
+            NSDictionary *revalidated = OMEntryRevalidated(entry, response.headers);
+            [self storeEntry:revalidated forKey:key];
+
+            return OMResponseOfEntry(revalidated);
+        }
+
+        NSDictionary *fetched = OMEntryOfResponse(response, request);
+        if (fetched) {
+            [self storeEntry:fetched forKey:key];
+        } else if (entry) {
+            [self removeEntryForKey:key];
+        }
+
+        return response;
+    } on:nil];
+}
+
+/** The entry of the key, nil if there is none. Concurrent lookups share a single
+ read from disk.
+ */
+- (OMPromise *)entryForKey:(NSString *)key {
+    return [_memory promiseForKey:key task:^OMPromise *{
+        if (_directory == nil) {
+            return [OMPromise promiseWithResult:nil];
+        }
+
+        OMDeferred *deferred = [OMDeferred new];
+        dispatch_async(_diskQueue, ^{
+            [deferred fulfil:[self readEntryForKey:key]];
+        });
+
+        return deferred.promise;
+    }];
+}
+
+- (void)storeEntry:(NSDictionary *)entry forKey:(NSString *)key {
+    [_memory invalidateKey:key];
+    [_memory promiseForKey:key task:^OMPromise *{
+        return [OMPromise promiseWithResult:entry];
+    }];
+
+    if (_directory) {
+        dispatch_async(_diskQueue, ^{
+            NSURL *file = [self fileForKey:key];
+            NSUInteger replaced = OMSizeOfFile(file);
+            NSData *data = [NSKeyedArchiver archivedDataWithRootObject:entry];
+
+            if ([data writeToURL:file atomically:YES]) {
+                _diskSize = self.diskSize - MIN(self.diskSize, replaced) + data.length;
+            }
+
+            if (self.diskSize > self.diskCapacity) {
+                [self trimDisk];
+            }
+        });
+    }
+}
+
+- (void)removeEntryForKey:(NSString *)key {
+    [_memory invalidateKey:key];
+
+    if (_directory) {
+        dispatch_async(_diskQueue, ^{
+            NSURL *file = [self fileForKey:key];
+            NSUInteger removed = OMSizeOfFile(file);
+
+            if ([[NSFileManager defaultManager] removeItemAtURL:file error:nil]) {
+                _diskSize = self.diskSize - MIN(self.diskSize, removed);
+            }
+        });
+    }
+}
+
+- (NSDictionary *)readEntryForKey:(NSString *)key {
+    NSURL *file = [self fileForKey:key];
+    NSData *data = [NSData dataWithContentsOfURL:file];
+    if (data == nil) {
+        return nil;
+    }
+
+    // the modification date orders the files by recent use
+    [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate: [NSDate date]}
+                                     ofItemAtPath:file.path
+                                            error:nil];
+
+    @try {
+        id entry = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+        return [entry isKindOfClass:NSDictionary.class] ? entry : nil;
+    }
+    @catch (NSException *exception) {
+        return nil;
+    }
+}
+
+/** Bytes stored on disk, the directory is only measured once.
+ */
+- (NSUInteger)diskSize {
+    if (_diskSize == NSNotFound) {
+        NSArray *files = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:_directory
+                                                       includingPropertiesForKeys:@[NSURLFileSizeKey]
+                                                                          options:0
+                                                                            error:nil];
+
+        _diskSize = 0;
+        for (NSURL *file in files) {
+            _diskSize += OMSizeOfFile(file);
+        }
+    }
+
+    return _diskSize;
+}
+
+/** Removes the least recently used files until the disk capacity is met.
+ */
+- (void)trimDisk {
+    NSArray *keys = @[NSURLFileSizeKey, NSURLContentModificationDateKey];
+    NSArray *files = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:_directory
+                                                   includingPropertiesForKeys:keys
+                                                                      options:0
+                                                                        error:nil];
+
+    files = [files sortedArrayUsingComparator:^NSComparisonResult(NSURL *a, NSURL *b) {
+        NSDate *dateA = nil, *dateB = nil;
+        [a getResourceValue:&dateA forKey:NSURLContentModificationDateKey error:nil];
+        [b getResourceValue:&dateB forKey:NSURLContentModificationDateKey error:nil];
+        return [dateA compare:dateB];
+    }];
+
+    // the tracked size might have drifted, e.g., if files got removed by the system
+    NSUInteger size = 0;
+    for (NSURL *file in files) {
+        size += OMSizeOfFile(file);
+    }
+
+    for (NSURL *file in files) {
+        if (size <= self.diskCapacity) {
+            break;
+        }
+
+        NSUInteger fileSize = OMSizeOfFile(file);
+        if ([[NSFileManager defaultManager] removeItemAtURL:file error:nil]) {
+            size -= MIN(size, fileSize);
+        }
+    }
+
+    _diskSize = size;
+}
+
+- (NSURL *)fileForKey:(NSString *)key {
+    NSData *data = [key dataUsingEncoding:NSUTF8StringEncoding];
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+
+    NSMutableString *name = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (size_t i = 0; i < CC_SHA256_DIGEST_LENGTH; ++i) {
+        [name appendFormat:@"%02x", digest[i]];
+    }
+
+    return [_directory URLByAppendingPathComponent:name];
+}
+
+@end
@@ -0,0 +1,91 @@
+//
+// OMHTTPRetryPolicy.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "OMPromise.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** Decides whether and when a failed request is attempted again, as declared by the
+ OMHTTPRetryAttempts, OMHTTPRetryDelay and OMHTTPRetryStatusCodes options.
+
+ Only failures which are likely transient are retried, i.e., responses with one of
+ the retryable status codes and connections which could not be established or
+ got lost. The delay doubles with each attempt and is randomized using full
+ jitter, such that clients failing at once do not retry in lockstep.
+ */
+@interface OMHTTPRetryPolicy : NSObject
+
+/** The policy declared by the options.
+
+ @param method The HTTP method of the request.
+ @param options The options of the request.
+ @return The policy, nil if the request is attempted only once, either because of
+         the options or because the method is not idempotent.
+ */
++ (nullable OMHTTPRetryPolicy *)policyForMethod:(NSString *)method options:(nullable NSDictionary *)options;
+
+/** Maximum number of attempts, including the first one.
+ */
+@property(assign, readonly, nonatomic) NSUInteger maximumAttempts;
+
+/** Upper bound of the delay before the second attempt, doubled for each further one.
+ */
+@property(assign, readonly, nonatomic) NSTimeInterval baseDelay;
+
+/** Status codes of responses worth another attempt.
+ */
+@property(readonly, nonatomic) NSSet *statusCodes;
+
+/** Whether the error is considered transient.
+
+ @param error The error a request failed with.
+ @return YES if another attempt might succeed.
+ */
+- (BOOL)shouldRetryAfterError:(NSError *)error;
+
+/** The randomized delay before an attempt. A Retry-After header of the failed
+ response is respected, up to the maximum delay of 30 seconds.
+
+ @param attempt The number of the upcoming attempt, starting at 2.
+ @param error The error the previous attempt failed with.
+ @return The delay in seconds.
+ */
+- (NSTimeInterval)delayBeforeAttempt:(NSUInteger)attempt error:(NSError *)error;
+
+/** Performs attempts until one succeeds, fails permanently or none is left.
+
+ Cancelling the returned promise cancels the current attempt, or skips the
+ upcoming one while waiting.
+
+ @param attempt Starts a single attempt.
+ @return A promise settled like the last attempt.
+ */
+- (OMPromise *)perform:(OMPromise *(^)(void))attempt;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,147 @@
+//
+// OMHTTPRetryPolicy.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMHTTPRetryPolicy.h"
+
+#import "OMHTTPRequest.h"
+#import "OMHTTPResponse.h"
+
+static const NSTimeInterval kDefaultRetryDelay = .5;
+static const NSTimeInterval kMaximumRetryDelay = 30.;
+
+/** Seconds a response asks to wait using a Retry-After header, negative if absent.
+ Dates are not supported, as they rely on the clocks being in sync anyway.
+ */
+static NSTimeInterval OMRetryAfterOfResponse(OMHTTPResponse *response) {
+    for (NSString *key in response.headers) {
+        if ([key caseInsensitiveCompare:@"Retry-After"] == NSOrderedSame) {
+            NSScanner *scanner = [NSScanner scannerWithString:[response.headers[key] description]];
+            NSInteger seconds = 0;
+            if ([scanner scanInteger:&seconds] && scanner.atEnd && seconds >= 0) {
+                return seconds;
+            }
+        }
+    }
+
+    return -1.;
+}
+
+@implementation OMHTTPRetryPolicy
+
+#pragma mark - Init
+
++ (OMHTTPRetryPolicy *)policyForMethod:(NSString *)method options:(NSDictionary *)options {
+    static NSSet *idempotentMethods = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        idempotentMethods = [NSSet setWithObjects:@"GET", @"HEAD", @"PUT", @"DELETE", @"OPTIONS", @"TRACE", nil];
+    });
+
+    NSUInteger maximumAttempts = [(options[OMHTTPRetryAttempts] ?: @1) unsignedIntegerValue];
+    if (maximumAttempts <= 1 || ![idempotentMethods containsObject:method.uppercaseString]) {
+        return nil;
+    }
+
+    return [[OMHTTPRetryPolicy alloc]
+        initWithMaximumAttempts:maximumAttempts
+                      baseDelay:options[OMHTTPRetryDelay] ? [options[OMHTTPRetryDelay] doubleValue] : kDefaultRetryDelay
+                    statusCodes:options[OMHTTPRetryStatusCodes] ?: [NSSet setWithObjects:@408, @429, @500, @502, @503, @504, nil]];
+}
+
+- (id)initWithMaximumAttempts:(NSUInteger)maximumAttempts baseDelay:(NSTimeInterval)baseDelay statusCodes:(NSSet *)statusCodes {
+    self = [super init];
+    if (self) {
+        _maximumAttempts = maximumAttempts;
+        _baseDelay = baseDelay;
+        _statusCodes = statusCodes;
+    }
+    return self;
+}
+
+#pragma mark - Policy
+
+- (BOOL)shouldRetryAfterError:(NSError *)error {
+    if (![error.domain isEqualToString:OMPromisesHTTPErrorDomain]) {
+        return NO;
+    }
+
+    if (error.code == OMPromisesHTTPStatusError) {
+        OMHTTPResponse *response = error.userInfo[OMHTTPResponseKey];
+        return [self.statusCodes containsObject:@(response.statusCode)];
+    }
+
+    if (error.code != OMPromisesHTTPRequestError) {
+        return NO;
+    }
+
+    NSError *underlyingError = error.userInfo[NSUnderlyingErrorKey];
+    if (![underlyingError.domain isEqualToString:NSURLErrorDomain]) {
+        return NO;
+    }
+
+    switch (underlyingError.code) {
+        case NSURLErrorTimedOut:
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorNetworkConnectionLost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorNotConnectedToInternet:
+            return YES;
+
+        default:
+            return NO;
+    }
+}
+
+- (NSTimeInterval)delayBeforeAttempt:(NSUInteger)attempt error:(NSError *)error {
+    NSAssert(attempt >= 2, @"There is no delay before the first attempt.");
+
+    NSTimeInterval window = MIN(kMaximumRetryDelay, self.baseDelay * pow(2., attempt - 2));
+    NSTimeInterval delay = window * ((double)arc4random() / UINT32_MAX);
+
+    // a server must not be able to stall the request indefinitely
+    return MAX(delay, MIN(kMaximumRetryDelay, OMRetryAfterOfResponse(error.userInfo[OMHTTPResponseKey])));
+}
+
+#pragma mark - Perform
+
+- (OMPromise *)perform:(OMPromise *(^)(void))attempt {
+    return [self perform:attempt attempt:1];
+}
+
+- (OMPromise *)perform:(OMPromise *(^)(void))attempt attempt:(NSUInteger)number {
+    return [attempt() rescue:^id(NSError *error) {
+        if (number >= self.maximumAttempts || ![self shouldRetryAfterError:error]) {
+            return error;
+        }
+
+        return [[OMPromise promiseWithResult:nil after:[self delayBeforeAttempt:number + 1 error:error]]
+            then:^id(id _) {
+                return [self perform:attempt attempt:number + 1];
+            } on:nil];
+    } on:nil];
+}
+
+@end
@@ -0,0 +1,86 @@
+//
+// OMHTTPRoute.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** A URL template parsed once, to be expanded by parameters repeatedly.
+
+ Each occurrence of a name consisting of word characters wrapped in curly braces,
+ e.g., `http://example.com/users/{id}`, is a placeholder replaced by the escaped
+ value of the parameter of the same name. Placeholders without a value are
+ removed. The template is trimmed of leading and trailing whitespace.
+
+ Routes are immutable and thus safe to share between threads.
+ */
+@interface OMHTTPRoute : NSObject
+
+/** Get the route of a template, parsed only once for recently used templates.
+
+ @param urlTemplate The URL template.
+ @return The shared route of the template.
+ */
++ (OMHTTPRoute *)routeWithTemplate:(NSString *)urlTemplate;
+
+/** Parse a URL template.
+
+ @param urlTemplate The URL template.
+ @return A new route.
+ */
+- (instancetype)initWithTemplate:(NSString *)urlTemplate NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/** The template the route got parsed from.
+ */
+@property(readonly, nonatomic) NSString *urlTemplate;
+
+/** Names of the placeholders in order of appearance.
+ */
+@property(readonly, nonatomic) NSArray<NSString *> *parameterNames;
+
+/** Expand the template in a single pass.
+
+ @param parameters The values of the placeholders, non-string values are replaced
+                   by their description.
+ @param remainingParameters Optionally returns the parameters not used by any
+                            placeholder, the supplied dictionary itself if none
+                            got used.
+ @return The expanded URL string.
+ */
+- (NSString *)URLStringWithParameters:(nullable NSDictionary *)parameters
+                  remainingParameters:(NSDictionary *_Nullable *_Nullable)remainingParameters;
+
+/** Expand the template into a URL.
+
+ @see URLStringWithParameters:remainingParameters:
+ */
+- (nullable NSURL *)URLWithParameters:(nullable NSDictionary *)parameters
+                  remainingParameters:(NSDictionary *_Nullable *_Nullable)remainingParameters;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,182 @@
+//
+// OMHTTPRoute.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMHTTPRoute.h"
+
+/** Number of parsed templates kept by routeWithTemplate:. */
+static const NSUInteger kRouteCacheCountLimit = 256;
+
+/** Characters reserved for each expanded value, used to size the buffer. */
+static const NSUInteger kExpectedValueLength = 16;
+
+/** Word characters as matched by \w in regular expressions.
+ */
+static BOOL OMIsWordCharacter(unichar character) {
+    static NSCharacterSet *wordCharacters = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        NSMutableCharacterSet *characters = [NSMutableCharacterSet alphanumericCharacterSet];
+        [characters addCharactersInString:@"_"];
+        wordCharacters = characters.copy;
+    });
+
+    return [wordCharacters characterIsMember:character];
+}
+
+static NSString *OMEscapedValue(id value) {
+    NSString *string = [value isKindOfClass:NSString.class] ? value : [value description];
+
+    return (__bridge_transfer NSString *)CFURLCreateStringByAddingPercentEscapes(
+        NULL, (__bridge CFStringRef)string, NULL, CFSTR("/%&=?$#+-~@<>|\\*,.()[]{}^!"), kCFStringEncodingUTF8);
+}
+
+@implementation OMHTTPRoute {
+    /** Literal parts around the placeholders, one more than there are names. */
+    NSArray *_literals;
+    NSUInteger _literalsLength;
+}
+
+#pragma mark - Init
+
++ (OMHTTPRoute *)routeWithTemplate:(NSString *)urlTemplate {
+    static NSCache *routes = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        routes = [NSCache new];
+        routes.countLimit = kRouteCacheCountLimit;
+    });
+
+    OMHTTPRoute *route = [routes objectForKey:urlTemplate];
+    if (route == nil) {
+        route = [[OMHTTPRoute alloc] initWithTemplate:urlTemplate];
+        [routes setObject:route forKey:urlTemplate];
+    }
+
+    return route;
+}
+
+- (instancetype)initWithTemplate:(NSString *)urlTemplate {
+    NSParameterAssert(urlTemplate);
+
+    self = [super init];
+    if (self) {
+        _urlTemplate = urlTemplate.copy;
+
+        NSString *trimmed = [urlTemplate stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+        NSUInteger length = trimmed.length;
+        NSMutableArray *literals = [NSMutableArray array];
+        NSMutableArray *names = [NSMutableArray array];
+
+        NSUInteger literalStart = 0;
+        NSUInteger literalsLength = length;
+        NSUInteger i = 0;
+        while (i < length) {
+            if ([trimmed characterAtIndex:i] != '{') {
+                i += 1;
+                continue;
+            }
+
+            NSUInteger end = i + 1;
+            while (end < length && OMIsWordCharacter([trimmed characterAtIndex:end])) {
+                end += 1;
+            }
+
+            // not a placeholder, part of the literal
+            if (end == i + 1 || end == length || [trimmed characterAtIndex:end] != '}') {
+                i = end;
+                continue;
+            }
+
+            [literals addObject:[trimmed substringWithRange:NSMakeRange(literalStart, i - literalStart)]];
+            [names addObject:[trimmed substringWithRange:NSMakeRange(i + 1, end - i - 1)]];
+            literalsLength -= end - i + 1;
+
+            literalStart = i = end + 1;
+        }
+
+        [literals addObject:[trimmed substringFromIndex:literalStart]];
+
+        _literals = literals;
+        _parameterNames = names;
+        _literalsLength = literalsLength;
+    }
+    return self;
+}
+
+#pragma mark - Expansion
+
+- (NSString *)URLStringWithParameters:(NSDictionary *)parameters
+                  remainingParameters:(NSDictionary **)remainingParameters
+{
+    NSUInteger count = _parameterNames.count;
+
+    if (remainingParameters) {
+        *remainingParameters = parameters;
+    }
+
+    if (count == 0) {
+        return _literals[0];
+    }
+
+    NSMutableString *urlString = [NSMutableString stringWithCapacity:_literalsLength + count * kExpectedValueLength];
+    NSMutableDictionary *remaining = nil;
+
+    [urlString appendString:_literals[0]];
+
+    for (NSUInteger i = 0; i < count; ++i) {
+        NSString *name = _parameterNames[i];
+        id value = parameters[name];
+
+        if (value) {
+            [urlString appendString:OMEscapedValue(value)];
+
+            if (remainingParameters) {
+                remaining = remaining ?: parameters.mutableCopy;
+                [remaining removeObjectForKey:name];
+            }
+        }
+
+        [urlString appendString:_literals[i + 1]];
+    }
+
+    if (remaining) {
+        *remainingParameters = remaining;
+    }
+
+    return urlString;
+}
+
+- (NSURL *)URLWithParameters:(NSDictionary *)parameters remainingParameters:(NSDictionary **)remainingParameters {
+    return [NSURL URLWithString:[self URLStringWithParameters:parameters remainingParameters:remainingParameters]];
+}
+
+#pragma mark - NSObject Overrides
+
+- (NSString *)debugDescription {
+    return [NSString stringWithFormat:@"<OMHTTPRoute: %p; template = %@; parameters = %@>",
+            (__bridge void *)self, self.urlTemplate, [self.parameterNames componentsJoinedByString:@", "]];
+}
+
+@end
@@ -0,0 +1,75 @@
+//
+// OMHTTPScheduler.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "OMHTTPRequest.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** Decides when session tasks are resumed, limiting the number of tasks running
+ at once in total and per host.
+
+ Tasks wait in a queue per priority. Once a slot frees up, the oldest task of the
+ highest priority whose host has a free slot is resumed. Tasks which never got
+ resumed never opened a connection.
+ */
+@interface OMHTTPScheduler : NSObject
+
+/** The scheduler used by all requests.
+ */
++ (OMHTTPScheduler *)sharedScheduler;
+
+/** Maximum number of tasks running at once. Defaults to 16.
+ */
+@property(assign, nonatomic) NSUInteger maximumConcurrentTasks;
+
+/** Maximum number of tasks running at once per host. Defaults to 4.
+ */
+@property(assign, nonatomic) NSUInteger maximumConcurrentTasksPerHost;
+
+/** Queue a suspended task, it is resumed right away if there is a free slot.
+
+ @param task The task to resume eventually.
+ @param priority The class of the task.
+ */
+- (void)enqueueTask:(NSURLSessionTask *)task priority:(OMHTTPPriority)priority;
+
+/** Remove a task which is still queued.
+
+ @param task The task to remove.
+ @return YES if the task was still queued, i.e., never resumed.
+ */
+- (BOOL)dequeueTask:(NSURLSessionTask *)task;
+
+/** Free the slot of a completed task.
+
+ @param task The completed task.
+ */
+- (void)taskCompleted:(NSURLSessionTask *)task;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,184 @@
+//
+// OMHTTPScheduler.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMHTTPScheduler.h"
+
+static const NSUInteger kDefaultMaximumConcurrentTasks = 16;
+static const NSUInteger kDefaultMaximumConcurrentTasksPerHost = 4;
+
+/** Number of priority classes, from OMHTTPPriorityLow to OMHTTPPriorityHigh.
+ */
+enum { kPriorityClasses = 3 };
+
+static NSString *OMHostOfTask(NSURLSessionTask *task) {
+    return task.originalRequest.URL.host.lowercaseString ?: @"";
+}
+
+@implementation OMHTTPScheduler {
+    /** Queued tasks by priority class, oldest first. */
+    NSMutableArray *_queues[kPriorityClasses];
+    NSMutableSet *_running;
+    NSCountedSet *_runningHosts;
+}
+
+#pragma mark - Init
+
++ (OMHTTPScheduler *)sharedScheduler {
+    static OMHTTPScheduler *scheduler = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        scheduler = [OMHTTPScheduler new];
+    });
+
+    return scheduler;
+}
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _maximumConcurrentTasks = kDefaultMaximumConcurrentTasks;
+        _maximumConcurrentTasksPerHost = kDefaultMaximumConcurrentTasksPerHost;
+
+        for (NSUInteger i = 0; i < kPriorityClasses; ++i) {
+            _queues[i] = [NSMutableArray array];
+        }
+        _running = [NSMutableSet set];
+        _runningHosts = [NSCountedSet set];
+    }
+    return self;
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)maximumConcurrentTasks {
+    @synchronized (self) {
+        return _maximumConcurrentTasks;
+    }
+}
+
+- (void)setMaximumConcurrentTasks:(NSUInteger)maximumConcurrentTasks {
+    NSAssert(maximumConcurrentTasks > 0, @"At least a single task has to run");
+
+    @synchronized (self) {
+        _maximumConcurrentTasks = maximumConcurrentTasks;
+    }
+
+    [self pump];
+}
+
+- (NSUInteger)maximumConcurrentTasksPerHost {
+    @synchronized (self) {
+        return _maximumConcurrentTasksPerHost;
+    }
+}
+
+- (void)setMaximumConcurrentTasksPerHost:(NSUInteger)maximumConcurrentTasksPerHost {
+    NSAssert(maximumConcurrentTasksPerHost > 0, @"At least a single task per host has to run");
+
+    @synchronized (self) {
+        _maximumConcurrentTasksPerHost = maximumConcurrentTasksPerHost;
+    }
+
+    [self pump];
+}
+
+#pragma mark - Public Methods
+
+- (void)enqueueTask:(NSURLSessionTask *)task priority:(OMHTTPPriority)priority {
+    NSInteger index = MAX(0, MIN(kPriorityClasses - 1, priority - OMHTTPPriorityLow));
+
+    @synchronized (self) {
+        [_queues[index] addObject:task];
+    }
+
+    [self pump];
+}
+
+- (BOOL)dequeueTask:(NSURLSessionTask *)task {
+    @synchronized (self) {
+        for (NSUInteger i = 0; i < kPriorityClasses; ++i) {
+            NSUInteger index = [_queues[i] indexOfObjectIdenticalTo:task];
+            if (index != NSNotFound) {
+                [_queues[i] removeObjectAtIndex:index];
+                return YES;
+            }
+        }
+    }
+
+    return NO;
+}
+
+- (void)taskCompleted:(NSURLSessionTask *)task {
+    @synchronized (self) {
+        if (![_running containsObject:task]) {
+            return;
+        }
+
+        [_running removeObject:task];
+        [_runningHosts removeObject:OMHostOfTask(task)];
+    }
+
+    [self pump];
+}
+
+#pragma mark - Private Methods
+
+/** Resumes queued tasks as long as there are free slots.
+ */
+- (void)pump {
+    NSMutableArray *ready = [NSMutableArray array];
+
+    @synchronized (self) {
+        for (NSInteger i = kPriorityClasses - 1; i >= 0 && _running.count < _maximumConcurrentTasks; --i) {
+            NSMutableArray *queue = _queues[i];
+            NSMutableSet *saturated = [NSMutableSet set];
+
+            for (NSUInteger j = 0; j < queue.count && _running.count < _maximumConcurrentTasks; ) {
+                NSURLSessionTask *task = queue[j];
+                NSString *host = OMHostOfTask(task);
+
+                // later tasks of a saturated host keep their place
+                if ([saturated containsObject:host] ||
+                    [_runningHosts countForObject:host] >= _maximumConcurrentTasksPerHost)
+                {
+                    [saturated addObject:host];
+                    j += 1;
+                    continue;
+                }
+
+                [queue removeObjectAtIndex:j];
+                [_running addObject:task];
+                [_runningHosts addObject:host];
+                [ready addObject:task];
+            }
+        }
+    }
+
+    for (NSURLSessionTask *task in ready) {
+        [task resume];
+    }
+}
+
+@end
@@ -0,0 +1,57 @@
+//
+// OMJSONParser.h
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** A push parser building the same objects as NSJSONSerialization, while being fed
+ with the data in chunks of any size.
+
+ Each chunk is parsed right away, thus only the remainder is left once the last
+ chunk arrived. Top level fragments, like a single string, are accepted as well.
+ Errors are reported in the OMPromisesHTTPErrorDomain as
+ OMPromisesHTTPSerializationError.
+ */
+@interface OMJSONParser : NSObject
+
+/** Parse the next chunk of data.
+
+ @param chunk The data following the previous chunk.
+ @param error Set to the reason if the data is malformed.
+ @return NO if the data is malformed, the parser stays failed afterwards.
+ */
+- (BOOL)parse:(NSData *)chunk error:(NSError **)error;
+
+/** Complete parsing once all data was passed.
+
+ @param error Set to the reason if the data is malformed or incomplete.
+ @return The parsed object or nil.
+ */
+- (nullable id)finish:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,476 @@
+//
+// OMJSONParser.m
+// OMPromises
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMJSONParser.h"
+
+#import "OMHTTPRequest.h"
+
+/** The tokens of the grammar the parser waits for next.
+ */
+typedef NS_ENUM(NSInteger, OMJSONExpectation) {
+    OMJSONExpectValue,
+    OMJSONExpectValueOrEnd,
+    OMJSONExpectKey,
+    OMJSONExpectKeyOrEnd,
+    OMJSONExpectColon,
+    OMJSONExpectCommaOrEnd,
+    OMJSONExpectNothing
+};
+
+/** Scalar tokens possibly spanning several chunks.
+ */
+typedef NS_ENUM(NSInteger, OMJSONToken) {
+    OMJSONTokenNone,
+    OMJSONTokenString,
+    OMJSONTokenNumber,
+    OMJSONTokenLiteral
+};
+
+static inline BOOL OMJSONIsWhitespace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline BOOL OMJSONIsNumberCharacter(uint8_t c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static inline int OMJSONHexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+@implementation OMJSONParser {
+    OMJSONExpectation _expectation;
+    OMJSONToken _token;
+    NSUInteger _offset;
+    NSError *_error;
+    id _result;
+
+    /** Open arrays and dictionaries, along with the pending key of each. */
+    NSMutableArray *_containers;
+    NSMutableArray *_keys;
+
+    /** UTF-8 bytes of the current string or number. */
+    NSMutableData *_text;
+    BOOL _isKey;
+    BOOL _escaped;
+    int _unicodeDigits;
+    uint32_t _unicode;
+    uint32_t _highSurrogate;
+
+    const char *_literal;
+    NSUInteger _literalIndex;
+    id _literalValue;
+}
+
+#pragma mark - Init
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _expectation = OMJSONExpectValue;
+        _containers = [NSMutableArray array];
+        _keys = [NSMutableArray array];
+        _text = [NSMutableData dataWithCapacity:64];
+    }
+    return self;
+}
+
+#pragma mark - Public Methods
+
+- (BOOL)parse:(NSData *)chunk error:(NSError **)error {
+    if (_error == nil) {
+        // chunks backed by several regions aren't flattened
+        [chunk enumerateByteRangesUsingBlock:^(const void *bytes, NSRange range, BOOL *stop) {
+            *stop = ![self parseBytes:bytes length:range.length];
+        }];
+    }
+
+    if (_error != nil && error != NULL) {
+        *error = _error;
+    }
+
+    return _error == nil;
+}
+
+- (id)finish:(NSError **)error {
+    if (_error == nil && _token == OMJSONTokenNumber) {
+        [self finishNumber];
+    }
+
+    if (_error == nil && (_token != OMJSONTokenNone || _expectation != OMJSONExpectNothing)) {
+        [self failWithReason:@"Unexpected end of data"];
+    }
+
+    if (_error != nil) {
+        if (error != NULL) {
+            *error = _error;
+        }
+        return nil;
+    }
+
+    return _result;
+}
+
+#pragma mark - Private Methods
+
+- (BOOL)parseBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    for (NSUInteger i = 0; i < length; ++i, ++_offset) {
+        uint8_t c = bytes[i];
+
+        switch (_token) {
+            case OMJSONTokenString:
+                if (![self consumeStringByte:c]) {
+                    return NO;
+                }
+                continue;
+
+            case OMJSONTokenNumber:
+                if (OMJSONIsNumberCharacter(c)) {
+                    [_text appendBytes:&c length:1];
+                    continue;
+                }
+
+                // the byte terminating the number is part of the structure
+                if (![self finishNumber]) {
+                    return NO;
+                }
+                break;
+
+            case OMJSONTokenLiteral:
+                if (c != (uint8_t)_literal[_literalIndex]) {
+                    return [self failWithReason:@"Invalid literal"];
+                }
+
+                if (_literal[++_literalIndex] == '\0') {
+                    _token = OMJSONTokenNone;
+                    [self emit:_literalValue];
+                }
+                continue;
+
+            case OMJSONTokenNone:
+                break;
+        }
+
+        if (![self consumeStructuralByte:c]) {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL)consumeStructuralByte:(uint8_t)c {
+    if (OMJSONIsWhitespace(c)) {
+        return YES;
+    }
+
+    BOOL inArray = [_containers.lastObject isKindOfClass:NSArray.class];
+
+    switch (_expectation) {
+        case OMJSONExpectValueOrEnd:
+            if (c == ']') {
+                return [self closeContainer];
+            }
+            return [self beginValue:c];
+
+        case OMJSONExpectValue:
+            return [self beginValue:c];
+
+        case OMJSONExpectKeyOrEnd:
+            if (c == '}') {
+                return [self closeContainer];
+            }
+            // fall through
+
+        case OMJSONExpectKey:
+            if (c != '"') {
+                return [self failWithReason:@"Expected a key"];
+            }
+            [self beginStringAsKey:YES];
+            return YES;
+
+        case OMJSONExpectColon:
+            if (c != ':') {
+                return [self failWithReason:@"Expected a colon"];
+            }
+            _expectation = OMJSONExpectValue;
+            return YES;
+
+        case OMJSONExpectCommaOrEnd:
+            if (c == ',') {
+                _expectation = inArray ? OMJSONExpectValue : OMJSONExpectKey;
+                return YES;
+            } else if ((c == ']' && inArray) || (c == '}' && !inArray)) {
+                return [self closeContainer];
+            }
+            return [self failWithReason:@"Expected a comma or the end of the container"];
+
+        case OMJSONExpectNothing:
+            return [self failWithReason:@"Unexpected data after the root object"];
+    }
+}
+
+- (BOOL)beginValue:(uint8_t)c {
+    switch (c) {
+        case '{':
+            [_containers addObject:[NSMutableDictionary dictionary]];
+            [_keys addObject:[NSNull null]];
+            _expectation = OMJSONExpectKeyOrEnd;
+            return YES;
+
+        case '[':
+            [_containers addObject:[NSMutableArray array]];
+            [_keys addObject:[NSNull null]];
+            _expectation = OMJSONExpectValueOrEnd;
+            return YES;
+
+        case '"':
+            [self beginStringAsKey:NO];
+            return YES;
+
+        case 't':
+            [self beginLiteral:"true" value:@YES];
+            return YES;
+
+        case 'f':
+            [self beginLiteral:"false" value:@NO];
+            return YES;
+
+        case 'n':
+            [self beginLiteral:"null" value:[NSNull null]];
+            return YES;
+
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                _token = OMJSONTokenNumber;
+                _text.length = 0;
+                [_text appendBytes:&c length:1];
+                return YES;
+            }
+            return [self failWithReason:@"Expected a value"];
+    }
+}
+
+- (void)beginStringAsKey:(BOOL)isKey {
+    _token = OMJSONTokenString;
+    _text.length = 0;
+    _isKey = isKey;
+    _escaped = NO;
+    _unicodeDigits = 0;
+    _highSurrogate = 0;
+}
+
+- (void)beginLiteral:(const char *)literal value:(id)value {
+    _token = OMJSONTokenLiteral;
+    _literal = literal;
+    _literalIndex = 1;
+    _literalValue = value;
+}
+
+- (BOOL)consumeStringByte:(uint8_t)c {
+    if (_unicodeDigits > 0) {
+        int value = OMJSONHexValue(c);
+        if (value < 0) {
+            return [self failWithReason:@"Invalid unicode escape sequence"];
+        }
+
+        _unicode = _unicode << 4 | (uint32_t)value;
+        return --_unicodeDigits > 0 || [self appendUnicode];
+    }
+
+    // a high surrogate has to be followed by the escaped low one
+    if (_highSurrogate != 0 && !(_escaped ? c == 'u' : c == '\\')) {
+        return [self failWithReason:@"Unpaired surrogate"];
+    }
+
+    if (_escaped) {
+        _escaped = NO;
+
+        uint8_t unescaped;
+        switch (c) {
+            case '"': case '\\': case '/': unescaped = c; break;
+            case 'b': unescaped = '\b'; break;
+            case 'f': unescaped = '\f'; break;
+            case 'n': unescaped = '\n'; break;
+            case 'r': unescaped = '\r'; break;
+            case 't': unescaped = '\t'; break;
+            case 'u':
+                _unicodeDigits = 4;
+                _unicode = 0;
+                return YES;
+            default:
+                return [self failWithReason:@"Invalid escape sequence"];
+        }
+
+        [_text appendBytes:&unescaped length:1];
+        return YES;
+    }
+
+    if (c == '\\') {
+        _escaped = YES;
+        return YES;
+    } else if (c == '"') {
+        return [self finishString];
+    } else if (c < 0x20) {
+        return [self failWithReason:@"Unescaped control character"];
+    }
+
+    [_text appendBytes:&c length:1];
+    return YES;
+}
+
+- (BOOL)appendUnicode {
+    uint32_t codePoint = _unicode;
+
+    if (_highSurrogate != 0) {
+        if (codePoint < 0xDC00 || codePoint > 0xDFFF) {
+            return [self failWithReason:@"Unpaired surrogate"];
+        }
+        codePoint = 0x10000 + ((_highSurrogate - 0xD800) << 10) + (codePoint - 0xDC00);
+        _highSurrogate = 0;
+    } else if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+        _highSurrogate = codePoint;
+        return YES;
+    } else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+        return [self failWithReason:@"Unpaired surrogate"];
+    }
+
+    uint8_t utf8[4];
+    NSUInteger length;
+    if (codePoint < 0x80) {
+        utf8[0] = (uint8_t)codePoint;
+        length = 1;
+    } else if (codePoint < 0x800) {
+        utf8[0] = (uint8_t)(0xC0 | codePoint >> 6);
+        utf8[1] = (uint8_t)(0x80 | (codePoint & 0x3F));
+        length = 2;
+    } else if (codePoint < 0x10000) {
+        utf8[0] = (uint8_t)(0xE0 | codePoint >> 12);
+        utf8[1] = (uint8_t)(0x80 | (codePoint >> 6 & 0x3F));
+        utf8[2] = (uint8_t)(0x80 | (codePoint & 0x3F));
+        length = 3;
+    } else {
+        utf8[0] = (uint8_t)(0xF0 | codePoint >> 18);
+        utf8[1] = (uint8_t)(0x80 | (codePoint >> 12 & 0x3F));
+        utf8[2] = (uint8_t)(0x80 | (codePoint >> 6 & 0x3F));
+        utf8[3] = (uint8_t)(0x80 | (codePoint & 0x3F));
+        length = 4;
+    }
+
+    [_text appendBytes:utf8 length:length];
+    return YES;
+}
+
+- (BOOL)finishString {
+    _token = OMJSONTokenNone;
+
+    NSString *string = [[NSString alloc] initWithBytes:_text.bytes length:_text.length encoding:NSUTF8StringEncoding];
+    if (string == nil) {
+        return [self failWithReason:@"Invalid UTF-8 data"];
+    }
+
+    if (_isKey) {
+        _keys[_keys.count - 1] = string;
+        _expectation = OMJSONExpectColon;
+        return YES;
+    }
+
+    return [self emit:string];
+}
+
+- (BOOL)finishNumber {
+    _token = OMJSONTokenNone;
+
+    uint8_t terminator = '\0';
+    [_text appendBytes:&terminator length:1];
+
+    const char *text = _text.bytes;
+    char *end = NULL;
+    NSNumber *number = nil;
+
+    if (strpbrk(text, ".eE") == NULL) {
+        errno = 0;
+        long long value = strtoll(text, &end, 10);
+        if (errno != ERANGE) {
+            number = @(value);
+        }
+    }
+
+    if (number == nil) {
+        double value = strtod(text, &end);
+        number = @(value);
+    }
+
+    if (end != text + _text.length - 1 || !isfinite(number.doubleValue)) {
+        return [self failWithReason:@"Invalid number"];
+    }
+
+    return [self emit:number];
+}
+
+- (BOOL)closeContainer {
+    id container = _containers.lastObject;
+
+    [_containers removeLastObject];
+    [_keys removeLastObject];
+
+    return [self emit:container];
+}
+
+- (BOOL)emit:(id)value {
+    id container = _containers.lastObject;
+
+    if (container == nil) {
+        _result = value;
+        _expectation = OMJSONExpectNothing;
+    } else if ([container isKindOfClass:NSArray.class]) {
+        [container addObject:value];
+        _expectation = OMJSONExpectCommaOrEnd;
+    } else {
+        container[_keys.lastObject] = value;
+        _expectation = OMJSONExpectCommaOrEnd;
+    }
+
+    return YES;
+}
+
+- (BOOL)failWithReason:(NSString *)reason {
+    _error = [NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                                 code:OMPromisesHTTPSerializationError
+                             userInfo:@{
+                                 NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to deserialize %@ data: %@ at offset %@.",
+                                     @"JSON", reason, @(_offset)]
+                             }];
+    return NO;
+}
+
+@end
@@ -35,6 +35,18 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (OMPromise *)httpParseJSON __deprecated;
 
+/** Convert an OMHTTPResponse containing JSON to the proper native data, without
+ blocking the thread the promise is delivered on.
+
+ The Content-Type is checked against a matcher compiled once, and the body is
+ decoded using [OMPromise globalTaskQueue]. If the body is streamed, see
+ OMHTTPStreamBody, each chunk is parsed as it arrives, thus only the last chunk
+ remains to be parsed once the response completed.
+
+ @return The promise yields an id type describing the parsed JSON.
+ */
+- (OMPromise *)httpDecodeJSON;
+
 @end
 
 NS_ASSUME_NONNULL_END
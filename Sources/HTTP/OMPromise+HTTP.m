@@ -25,50 +25,141 @@
 
 #import "OMPromise+HTTP.h"
 
+#import "OMDeferred.h"
 #import "OMHTTPRequest.h"
 #import "OMHTTPResponse.h"
+#import "OMJSONParser.h"
+
+/** Number of chunks of a streamed body requested ahead of parsing.
+ */
+static const NSUInteger kJSONChunkWindow = 4;
+
+/** Matches the media types of JSON, including vendor specific ones. Compiled once
+ and used concurrently, which is safe for NSRegularExpression.
+ */
+static BOOL OMIsJSONContentType(NSString *contentType) {
+    static NSRegularExpression *regex = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        regex = [NSRegularExpression regularExpressionWithPattern:@"application/(?:(vnd\\.[0-9a-zA-Z\\.]+)\\+)?json(?:;.*)?"
+                                                          options:NSRegularExpressionCaseInsensitive
+                                                            error:nil];
+    });
+
+    return contentType != nil &&
+        [regex firstMatchInString:contentType options:0 range:NSMakeRange(0, contentType.length)] != nil;
+}
+
+static NSError *OMContentTypeError(NSString *contentType) {
+    return [NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                               code:OMPromisesHTTPContentTypeError
+                           userInfo:@{
+                               NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Found Content-Type %@ but expected %@.",
+                                   contentType, @"application/json"]
+                           }];
+}
+
+static NSError *OMSerializationError(NSError *error) {
+    return [NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                               code:OMPromisesHTTPSerializationError
+                           userInfo:@{
+                               NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to deserialize %@ data: %@",
+                                   @"JSON", error],
+                               NSUnderlyingErrorKey: error
+                           }];
+}
+
+/** Decodes the JSON of the body as a whole.
+ */
+static id OMDecodeJSONBody(OMHTTPResponse *response) {
+    // there is not data contained, ignoring everything
+    if (response.statusCode == 204) {
+        return nil;
+    }
+
+    NSString *contentType = response.headers[@"Content-Type"];
+
+    // check content type
+    if (!OMIsJSONContentType(contentType)) {
+        return OMContentTypeError(contentType);
+    }
+
+    NSError *error = nil;
+    id data = [NSJSONSerialization JSONObjectWithData:response.body options:0 error:&error];
+
+    return error ? OMSerializationError(error) : data;
+}
+
+/** Feeds the chunks of the body to a parser as they arrive, one after another on
+ a serial queue targeting the global task queue.
+ */
+static OMPromise *OMDecodeJSONStream(OMStream *stream) {
+    OMDeferred *deferred = [OMDeferred new];
+    OMJSONParser *parser = [OMJSONParser new];
+
+    dispatch_queue_t queue = dispatch_queue_create("de.reaktor42.OMPromises.JSON", DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(queue, [OMPromise globalTaskQueue]);
+
+    [stream values:^(NSData *chunk) {
+        NSError *error = nil;
+        if ([parser parse:chunk error:&error]) {
+            [stream request:1];
+        } else {
+            [deferred tryFail:error];
+            [stream cancel];
+        }
+    } on:queue];
+
+    // delivered after the last chunk got parsed, using the same queue
+    [stream.completion always:^(OMPromiseState state, id result, NSError *error) {
+        if (state == OMPromiseStateFailed) {
+            [deferred tryFail:error];
+            return;
+        }
+
+        NSError *parseError = nil;
+        id object = [parser finish:&parseError];
+
+        if (parseError) {
+            [deferred tryFail:parseError];
+        } else {
+            [deferred tryFulfil:object];
+        }
+    } on:queue];
+
+    [deferred cancelled:^(OMDeferred *_) {
+        [stream cancel];
+    }];
+
+    [stream request:kJSONChunkWindow];
+
+    return deferred.promise;
+}
 
 @implementation OMPromise (HTTP)
 
 - (OMPromise *)httpParseJSON {
     return [self then:^id(OMHTTPResponse *response) {
-        // there is not data contained, ignoring everything
-        if (response.statusCode == 204) {
-            return nil;
-        }
+        return OMDecodeJSONBody(response);
+    }];
+}
 
-        NSString *pattern = @"application/(?:(vnd\\.[0-9a-zA-Z\\.]+)\\+)?json(?:;.*)?";
-        NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:pattern
-                                                                               options:NSRegularExpressionCaseInsensitive
-                                                                                 error:nil];
+- (OMPromise *)httpDecodeJSON {
+    return [self then:^id(OMHTTPResponse *response) {
+        if (response.bodyStream == nil) {
+            return OMDecodeJSONBody(response);
+        }
 
         NSString *contentType = response.headers[@"Content-Type"];
 
-        // check content type
-        if ([regex firstMatchInString:contentType options:0 range:NSMakeRange(0, contentType.length)] == nil) {
-            return [NSError errorWithDomain:OMPromisesHTTPErrorDomain
-                                       code:OMPromisesHTTPContentTypeError
-                                   userInfo:@{
-                                       NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Found Content-Type %@ but expected %@.",
-                                           contentType, @"application/json"]
-                                   }];
+        if (response.statusCode == 204 || !OMIsJSONContentType(contentType)) {
+            // nobody is going to consume the body
+            [response.bodyStream cancel];
+            return response.statusCode == 204 ? nil : OMContentTypeError(contentType);
         }
 
-        NSError *error = nil;
-        id data = [NSJSONSerialization JSONObjectWithData:response.body options:0 error:&error];
-
-        if (error) {
-            return [NSError errorWithDomain:OMPromisesHTTPErrorDomain
-                                       code:OMPromisesHTTPSerializationError
-                                   userInfo:@{
-                                       NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Failed to deserialize %@ data: %@",
-                                           @"JSON", error],
-                                       NSUnderlyingErrorKey: error
-                                   }];
-        }
-
-        return data;
-    }];
+        return OMDecodeJSONStream(response.bodyStream);
+    } on:[OMPromise globalTaskQueue]];
 }
 
 @end
@@ -25,4 +25,6 @@
 
 #import "OMHTTPRequest.h"
 #import "OMHTTPResponse.h"
+#import "OMHTTPResponseCache.h"
+#import "OMHTTPRoute.h"
 #import "OMPromise+HTTP.h"
@@ -180,6 +180,30 @@
     XCTAssertFalse([deferred tryProgress:.5f], @"TryProgress should do nothing if fulfilled");
 }
 
+- (void)testTryFulfilConcurrently {
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block _Atomic int succeeded = 0, called = 0;
+
+    dispatch_apply(64, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        [deferred.promise fulfilled:^(id result) {
+            atomic_fetch_add(&called, 1);
+        }];
+
+        if (i % 2 == 0 ? [deferred tryFulfil:@(i)] : [deferred tryFail:nil]) {
+            atomic_fetch_add(&succeeded, 1);
+        }
+    });
+
+    XCTAssertEqual(atomic_load(&succeeded), 1, @"Exactly one state change should have succeeded");
+
+    if (deferred.promise.state == OMPromiseStateFulfilled) {
+        XCTAssertEqual(atomic_load(&called), 64, @"Each fulfilled-block should have been called once");
+    } else {
+        XCTAssertEqual(atomic_load(&called), 0, @"No fulfilled-block should have been called");
+    }
+}
+
 - (void)testCancelled {
     OMDeferred *deferred = [OMDeferred new];
     OMPromise *promise = deferred.promise;
@@ -0,0 +1,186 @@
+//
+// OMPromiseCacheTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMPromiseCache.h"
+
+@interface OMPromiseCacheTests : XCTestCase
+@end
+
+@implementation OMPromiseCacheTests
+
+- (void)testSingleFlight {
+    OMPromiseCache *cache = [OMPromiseCache new];
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block int called = 0;
+    OMPromise *(^task)(void) = ^{
+        called += 1;
+        return deferred.promise;
+    };
+
+    OMPromise *first = [cache promiseForKey:@"key" task:task];
+    OMPromise *second = [cache promiseForKey:@"key" task:task];
+
+    XCTAssertEqual(called, 1, @"Task should be shared while in flight");
+    XCTAssertNotEqual(first, second, @"Each caller should get a promise of its own");
+
+    [deferred fulfil:@1];
+    XCTAssertEqualObjects(first.result, @1);
+    XCTAssertEqualObjects(second.result, @1);
+
+    XCTAssertEqualObjects([cache promiseForKey:@"key" task:task].result, @1, @"Result should be cached");
+    XCTAssertEqual(called, 1);
+}
+
+- (void)testTimeToLive {
+    OMPromiseCache *cache = [OMPromiseCache new];
+    cache.timeToLive = .05;
+
+    __block int called = 0;
+    OMPromise *(^task)(void) = ^{
+        called += 1;
+        return [OMPromise promiseWithResult:@(called)];
+    };
+
+    XCTAssertEqualObjects([cache promiseForKey:@"key" task:task].result, @1);
+    XCTAssertEqualObjects([cache promiseForKey:@"key" task:task].result, @1, @"Result should still be valid");
+
+    WAIT_FOR(.1);
+
+    XCTAssertNil([cache promiseForKey:@"key"], @"Result should have expired");
+    XCTAssertEqualObjects([cache promiseForKey:@"key" task:task].result, @2);
+}
+
+- (void)testFailureTimeToLive {
+    OMPromiseCache *cache = [OMPromiseCache new];
+    NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:0 userInfo:nil];
+
+    __block int called = 0;
+    OMPromise *(^task)(void) = ^{
+        called += 1;
+        return [OMPromise promiseWithError:error];
+    };
+
+    [cache promiseForKey:@"key" task:task];
+    [cache promiseForKey:@"key" task:task];
+    XCTAssertEqual(called, 2, @"Failures shouldn't be kept by default");
+
+    cache.failureTimeToLive = 10.;
+    [cache promiseForKey:@"key" task:task];
+    XCTAssertEqual([cache promiseForKey:@"key" task:task].error, error);
+    XCTAssertEqual(called, 3, @"Failure should be kept");
+}
+
+- (void)testLeastRecentlyUsedEviction {
+    OMPromiseCache *cache = [OMPromiseCache new];
+    cache.countLimit = 2;
+
+    OMPromise *(^task)(void) = ^{
+        return [OMPromise promiseWithResult:nil];
+    };
+
+    [cache promiseForKey:@1 task:task];
+    [cache promiseForKey:@2 task:task];
+    [cache promiseForKey:@1];
+    [cache promiseForKey:@3 task:task];
+
+    XCTAssertEqual(cache.count, 2U);
+    XCTAssertNotNil([cache promiseForKey:@1], @"Recently used entry should be kept");
+    XCTAssertNil([cache promiseForKey:@2], @"Least recently used entry should be evicted");
+    XCTAssertNotNil([cache promiseForKey:@3]);
+}
+
+- (void)testCostEviction {
+    OMPromiseCache *cache = [OMPromiseCache new];
+    cache.totalCostLimit = 10;
+    cache.costOfResult = ^NSUInteger(NSData *data) {
+        return data.length;
+    };
+
+    [cache promiseForKey:@1 task:^OMPromise *{
+        return [OMPromise promiseWithResult:[NSMutableData dataWithLength:6]];
+    }];
+    XCTAssertEqual(cache.totalCost, 6U);
+
+    [cache promiseForKey:@2 task:^OMPromise *{
+        return [OMPromise promiseWithResult:[NSMutableData dataWithLength:6]];
+    }];
+
+    XCTAssertEqual(cache.count, 1U, @"Oldest entry should be evicted to meet the limit");
+    XCTAssertEqual(cache.totalCost, 6U);
+    XCTAssertNotNil([cache promiseForKey:@2]);
+}
+
+- (void)testInvalidate {
+    OMPromiseCache *cache = [OMPromiseCache new];
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block int called = 0;
+    OMPromise *(^task)(void) = ^{
+        called += 1;
+        return deferred.promise;
+    };
+
+    OMPromise *promise = [cache promiseForKey:@"key" task:task];
+    [cache invalidateKey:@"key"];
+    XCTAssertNil([cache promiseForKey:@"key"]);
+
+    [cache promiseForKey:@"key" task:task];
+    XCTAssertEqual(called, 2, @"Invalidated operations should no longer be shared");
+
+    [deferred fulfil:@1];
+    XCTAssertEqualObjects(promise.result, @1, @"Operation in flight should be unaffected");
+
+    [cache invalidateAll];
+    XCTAssertEqual(cache.count, 0U);
+    XCTAssertEqual(cache.totalCost, 0U);
+}
+
+- (void)testCancelOnceAllCallersCancelled {
+    OMPromiseCache *cache = [OMPromiseCache new];
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [deferred cancelled:^(OMDeferred *_) {
+        cancelled += 1;
+    }];
+
+    OMPromise *first = [cache promiseForKey:@"key" task:^OMPromise *{
+        return deferred.promise;
+    }];
+    OMPromise *second = [cache promiseForKey:@"key"];
+
+    [first cancel];
+    XCTAssertEqual(cancelled, 0, @"Another caller is still waiting");
+    XCTAssertEqual(second.state, OMPromiseStateUnfulfilled);
+
+    [second cancel];
+    XCTAssertEqual(cancelled, 1, @"Operation should be cancelled");
+    XCTAssertNil([cache promiseForKey:@"key"], @"Cancelled operations shouldn't be kept");
+}
+
+@end
@@ -0,0 +1,277 @@
+//
+// OMPromisePerformanceTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2013,2014 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import <malloc/malloc.h>
+
+static const NSUInteger kContentionPromises = 2048;
+static const NSUInteger kChainLength = 1024;
+static const NSUInteger kFanOut = 1024;
+static const NSUInteger kCombinedPromises = 100000;
+
+/** The derived promise and its deferred. The handler is a global block and its
+ continuation is stored inline, the fraction left covers the rare growth of the weak
+ reference table due to the upstream reference.
+
+ Before handlers were kept in a single inline continuation list, each link cost
+ eight allocations: the promise and its deferred, three handler blocks capturing the
+ deferred and three handler arrays.
+ */
+static const double kMaximumAllocationsPerLink = 2.1;
+
+@interface OMPromisePerformanceTests : XCTestCase
+@end
+
+@implementation OMPromisePerformanceTests
+
+#pragma mark - Contention
+
+- (void)testContentionWith1Thread {
+    [self measureContentionWithThreads:1];
+}
+
+- (void)testContentionWith4Threads {
+    [self measureContentionWithThreads:4];
+}
+
+- (void)testContentionWith16Threads {
+    [self measureContentionWithThreads:16];
+}
+
+- (void)testContentionWith64Threads {
+    [self measureContentionWithThreads:64];
+}
+
+#pragma mark - Chains
+
+- (void)testAllocationsPerLink {
+    [self measureAllocationsPerLinkTrackingProgress:YES];
+}
+
+- (void)testAllocationsPerLinkWithoutProgress {
+    [self measureAllocationsPerLinkTrackingProgress:NO];
+}
+
+- (void)testProgressThroughChain {
+    int invocations = [self measureProgressThroughChainTrackingProgress:YES];
+    XCTAssertGreaterThan(invocations, 0, @"Progress should be delivered along the chain");
+}
+
+- (void)testProgressThroughChainWithoutProgress {
+    int invocations = [self measureProgressThroughChainTrackingProgress:NO];
+    XCTAssertEqual(invocations, 0, @"Progress shouldn't be delivered along an untracked chain");
+}
+
+- (void)testChainThroughput {
+    [self measureBlock:^{
+        OMDeferred *deferred = [OMDeferred new];
+        OMPromise *promise = deferred.promise;
+
+        for (NSUInteger i = 0; i < kChainLength; ++i) {
+            promise = [[[promise
+                then:^id(id result) {
+                    return result;
+                } on:nil]
+                rescue:^id(NSError *error) {
+                    return error;
+                } on:nil]
+                always:^(OMPromiseState state, id result, NSError *error) {} on:nil];
+        }
+
+        [deferred fulfil:@1];
+        XCTAssertEqualObjects(promise.result, @1, @"Result should be passed along the chain");
+    }];
+}
+
+- (void)testImmediateChainThroughput {
+    [self measureBlock:^{
+        OMDeferred *deferred = [OMDeferred new];
+        OMPromise *promise = deferred.promise;
+
+        for (NSUInteger i = 0; i < kChainLength; ++i) {
+            promise = [promise then:^id(id result) {
+                return result;
+            } on:[OMPromise immediateQueue]];
+        }
+
+        [deferred fulfil:@1];
+        XCTAssertEqualObjects(promise.result, @1, @"Result should be passed along the chain");
+    }];
+}
+
+#pragma mark - Fan-Out
+
+- (void)testFanOutOnSingleQueue {
+    dispatch_queue_t queue = dispatch_queue_create("de.reaktor42.OMPromisesTests.fanout", DISPATCH_QUEUE_SERIAL);
+
+    [self measureBlock:^{
+        OMDeferred *deferred = [OMDeferred new];
+        dispatch_group_t group = dispatch_group_create();
+
+        for (NSUInteger i = 0; i < kFanOut; ++i) {
+            dispatch_group_enter(group);
+            [deferred.promise fulfilled:^(id result) {
+                dispatch_group_leave(group);
+            } on:queue];
+        }
+
+        [deferred fulfil:@1];
+
+        XCTAssertEqual(dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC)), 0L,
+                       @"All handlers should have been called");
+    }];
+}
+
+#pragma mark - Combinators
+
+- (void)testAllWithManyPromises {
+    [self measureBlock:^{
+        NSMutableArray *deferreds = [NSMutableArray arrayWithCapacity:kCombinedPromises];
+        NSMutableArray *promises = [NSMutableArray arrayWithCapacity:kCombinedPromises];
+        for (NSUInteger i = 0; i < kCombinedPromises; ++i) {
+            OMDeferred *deferred = [OMDeferred new];
+            [deferreds addObject:deferred];
+            [promises addObject:deferred.promise];
+        }
+
+        OMPromise *all = [OMPromise all:promises];
+
+        for (OMDeferred *deferred in deferreds) {
+            [deferred progress:.5f];
+            [deferred fulfil:@1];
+        }
+
+        XCTAssertEqual(all.state, OMPromiseStateFulfilled, @"All promises should have been fulfilled");
+        XCTAssertEqual([all.result count], kCombinedPromises, @"Each result should have been collected");
+    }];
+}
+
+#pragma mark - Helper
+
+/** Lets each thread register handlers at and race for the resolution of the very
+ same set of promises, thus every promise is contended by all threads.
+ */
+- (void)measureContentionWithThreads:(NSUInteger)threads {
+    [self measureBlock:^{
+        NSMutableArray *deferreds = [NSMutableArray arrayWithCapacity:kContentionPromises];
+        for (NSUInteger i = 0; i < kContentionPromises; ++i) {
+            [deferreds addObject:[OMDeferred new]];
+        }
+
+        __block _Atomic int fulfilled = 0;
+
+        [self runOnThreads:threads block:^(NSUInteger thread) {
+            for (OMDeferred *deferred in deferreds) {
+                [[deferred.promise
+                    progressed:^(float progress) {}]
+                    fulfilled:^(id result) {}];
+
+                [deferred tryProgress:.5f];
+
+                if ([deferred tryFulfil:@(thread)]) {
+                    atomic_fetch_add(&fulfilled, 1);
+                }
+            }
+        }];
+
+        XCTAssertEqual(atomic_load(&fulfilled), (int)kContentionPromises, @"Each promise should get fulfilled exactly once");
+    }];
+}
+
+- (void)measureAllocationsPerLinkTrackingProgress:(BOOL)tracksProgress {
+    OMDeferred *deferred = [OMDeferred new];
+    deferred.promise.tracksProgress = tracksProgress;
+    OMPromise *promise = deferred.promise;
+
+    malloc_statistics_t before, after;
+    malloc_zone_statistics(NULL, &before);
+
+    for (NSUInteger i = 0; i < kChainLength; ++i) {
+        promise = [promise then:^id(id result) {
+            return result;
+        } on:nil];
+    }
+
+    malloc_zone_statistics(NULL, &after);
+
+    double allocations = ((double)after.blocks_in_use - before.blocks_in_use) / kChainLength;
+    XCTAssertLessThanOrEqual(allocations, kMaximumAllocationsPerLink, @"Too many allocations per then: link");
+
+    [deferred fulfil:@1];
+    XCTAssertEqualObjects(promise.result, @1, @"Result should be passed along the chain");
+}
+
+/** Returns the handler invocations caused by progress updates at the head of a chain.
+ */
+- (int)measureProgressThroughChainTrackingProgress:(BOOL)tracksProgress {
+    __block _Atomic int invocations = 0;
+
+    [self measureBlock:^{
+        OMDeferred *deferred = [OMDeferred new];
+        deferred.promise.tracksProgress = tracksProgress;
+        OMPromise *promise = deferred.promise;
+
+        for (NSUInteger i = 0; i < kChainLength; ++i) {
+            promise = [[promise then:^id(id result) {
+                return result;
+            } on:nil] progressed:^(float progress) {
+                atomic_fetch_add(&invocations, 1);
+            } on:nil];
+        }
+
+        for (int i = 1; i < 100; ++i) {
+            [deferred progress:i / 100.f];
+        }
+
+        [deferred fulfil:@1];
+    }];
+
+    return atomic_load(&invocations);
+}
+
+- (void)runOnThreads:(NSUInteger)threads block:(void (^)(NSUInteger thread))block {
+    dispatch_group_t group = dispatch_group_create();
+
+    // dedicated threads, a dispatch queue would limit the width to the number of cores
+    for (NSUInteger i = 0; i < threads; ++i) {
+        dispatch_group_enter(group);
+
+        void (^work)() = ^{
+            block(i);
+            dispatch_group_leave(group);
+        };
+
+        [[[NSThread alloc] initWithTarget:self selector:@selector(runThread:) object:work] start];
+    }
+
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+}
+
+- (void)runThread:(void (^)())work {
+    work();
+}
+
+@end
@@ -25,6 +25,8 @@
 
 #import "OMTests.h"
 
+#import "OMLazyPromise.h"
+
 @interface OMPromisesTests : XCTestCase
 
 @property id result;
@@ -45,6 +47,7 @@
 
 - (void)tearDown {
     [OMPromise setGlobalDefaultQueue:nil];
+    [OMPromise setGlobalTracksProgress:YES];
     [super tearDown];
 }
 
@@ -105,6 +108,66 @@
     XCTAssertEqual(promise.defaultQueue, mainQueue, @"defalultQueue should be set by on:");
 }
 
+- (void)testImmediateQueue {
+    OMDeferred *deferred = [OMDeferred new];
+    OMPromise *promise = deferred.promise;
+
+    __block int called = 0;
+    for (int i = 0; i < 10000; ++i) {
+        promise = [promise then:^id(NSNumber *result) {
+            called += 1;
+            return @(result.intValue + 1);
+        } on:[OMPromise immediateQueue]];
+    }
+
+    [deferred fulfil:@0];
+
+    XCTAssertEqual(called, 10000, @"All blocks should have been called right away");
+    XCTAssertEqualObjects(promise.result, @10000, @"Result should have been passed along the chain");
+}
+
+- (void)testNilQueueRunsInline {
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block BOOL called = NO;
+    OMPromise *promise = [deferred.promise then:^id(NSNumber *result) {
+        called = YES;
+        return @(result.intValue + 1);
+    } on:nil];
+
+    [deferred fulfil:@0];
+
+    XCTAssertTrue(called, @"Block without a queue should have been called right away");
+    XCTAssertEqualObjects(promise.result, @1, @"Result should have been passed along");
+}
+
+- (void)testSameQueueRunsInline {
+    OMDeferred *deferred = [OMDeferred new];
+    OMPromise *promise = deferred.promise;
+
+    dispatch_queue_t queue = dispatch_queue_create("de.reaktor42.OMPromisesTests", DISPATCH_QUEUE_SERIAL);
+
+    __block int called = 0;
+    for (int i = 0; i < 10000; ++i) {
+        promise = [promise then:^id(NSNumber *result) {
+            called += 1;
+            return @(result.intValue + 1);
+        } on:queue];
+    }
+
+    [promise fulfilled:^(id result) {
+        XCTAssertEqual(called, 10000, @"All blocks should have been called within a single dispatch");
+    } on:queue];
+
+    // the first block gets dispatched, all successive ones are called within it
+    dispatch_suspend(queue);
+    [deferred fulfil:@0];
+    dispatch_resume(queue);
+
+    WAIT_UNTIL(promise.state == OMPromiseStateFulfilled, 2, @"Not fulfilled within 2 secs");
+    XCTAssertEqualObjects(promise.result, @10000, @"Result should have been passed along the chain");
+}
+
 #pragma mark - Return
 
 - (void)testTaskPromise {
@@ -163,6 +226,49 @@
     XCTAssertEqualWithAccuracy(promise.progress, 0.f, FLT_EPSILON, @"Progress should be 0");
 }
 
+- (void)testHandlersOnSettledPromises {
+    __block int called = 0;
+
+    [[[[OMPromise promiseWithResult:self.result]
+        fulfilled:^(id result) {
+            called += 1;
+        } on:nil]
+        progressed:^(float progress) {
+            called += 1;
+        } on:nil]
+        always:^(OMPromiseState state, id result, NSError *error) {
+            called += 1;
+        } on:nil];
+
+    [[[OMPromise promiseWithError:self.error]
+        failed:^(NSError *error) {
+            called += 1;
+        } on:nil]
+        always:^(OMPromiseState state, id result, NSError *error) {
+            called += 1;
+        } on:nil];
+
+    // fills the inline records first, further ones are allocated
+    OMPromise *promise = [OMPromise promiseWithResult:self.result];
+    for (int i = 0; i < 4; ++i) {
+        [promise fulfilled:^(id result) {
+            called += 1;
+        } on:nil];
+    }
+
+    XCTAssertEqual(called, 9, @"Handlers of settled promises should have been called right away");
+}
+
+- (void)testDelayedPromiseWithoutRunLoop {
+    __block OMPromise *promise = nil;
+    dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        promise = [OMPromise promiseWithResult:self.result after:.05];
+    });
+
+    XCTAssertEqual(promise.state, OMPromiseStateUnfulfilled, @"Promise should be unfulfilled yet");
+    XCTAssertEqual([promise waitForResultWithin:1], self.result, @"Promise should be fulfilled without a run loop");
+}
+
 #pragma mark - Callbacks
 
 - (void)testBindOnAlreadyFulfilledPromise {
@@ -281,6 +387,94 @@
     XCTAssertEqual(called, 3, @"progressed-block should be called three times");
 }
 
+- (void)testProgressGranularity {
+    OMDeferred *deferred = [OMDeferred new];
+    deferred.promise.progressGranularity = .25f;
+
+    __block int called = 0;
+    [deferred.promise progressed:^(float progress) {
+        float values[] = {.3f, .6f, 1.f};
+        XCTAssertEqualWithAccuracy(values[called], progress, FLT_EPSILON, @"Unexpected progress");
+        called += 1;
+    }];
+
+    [deferred progress:.1f];
+    XCTAssertEqual(called, 0, @"Increase is too small");
+    [deferred progress:.3f];
+    XCTAssertEqual(called, 1, @"progressed-block should be called once");
+    [deferred progress:.5f];
+    XCTAssertEqual(called, 1, @"Increase is too small");
+    [deferred progress:.6f];
+    XCTAssertEqual(called, 2, @"progressed-block should be called twice");
+    [deferred progress:.7f];
+    [deferred fulfil:self.result];
+    XCTAssertEqual(called, 3, @"Final progress should always be delivered");
+}
+
+- (void)testProgressInterval {
+    OMDeferred *deferred = [OMDeferred new];
+    deferred.promise.progressInterval = .2;
+
+    __block int called = 0;
+    __block float last = 0.f;
+    [[deferred.promise then:^id(id result) {
+        return result;
+    }] progressed:^(float progress) {
+        last = progress;
+        called += 1;
+    }];
+
+    [deferred progress:.1f];
+    XCTAssertEqual(called, 1, @"First update should be delivered right away");
+
+    for (int i = 2; i < 10; ++i) {
+        [deferred progress:i / 10.f];
+    }
+    XCTAssertEqual(called, 1, @"Updates within the interval should be coalesced");
+
+    WAIT_UNTIL(called == 2, 1, @"Coalesced update should be delivered after the interval");
+    XCTAssertEqualWithAccuracy(last, .45f, FLT_EPSILON, @"Most recent progress should be delivered");
+
+    [deferred fulfil:self.result];
+    XCTAssertEqual(called, 3, @"Final progress should always be delivered");
+}
+
+- (void)testProgressFlushDoesNotRetainPromise {
+    __weak OMPromise *weakPromise = nil;
+    @autoreleasepool {
+        OMDeferred *deferred = [OMDeferred new];
+        deferred.promise.progressInterval = .2;
+        weakPromise = deferred.promise;
+
+        [deferred progress:.1f];
+        [deferred progress:.2f];
+    }
+
+    XCTAssertNil(weakPromise, @"Pending flush shouldn't keep the promise alive");
+}
+
+- (void)testTracksProgress {
+    OMDeferred *deferred = [OMDeferred new];
+    XCTAssertTrue(deferred.promise.tracksProgress, @"Should track progress by default");
+
+    deferred.promise.tracksProgress = NO;
+
+    __block int called = 0;
+    OMPromise *promise = [[deferred.promise then:^id(id result) {
+        return result;
+    }] progressed:^(float progress) {
+        called += 1;
+    }];
+
+    XCTAssertFalse(promise.tracksProgress, @"Derived promises should inherit tracksProgress");
+
+    [deferred progress:.5f];
+    [deferred fulfil:self.result];
+
+    XCTAssertEqual(called, 0, @"progressed-block should never be called");
+    XCTAssertEqual(promise.state, OMPromiseStateFulfilled, @"Derived promise should be fulfilled nonetheless");
+}
+
 - (void)testMultipleBindsOnNotAlreadyFulfilledPromise {
     OMDeferred *deferred = [OMDeferred new];
 
@@ -373,6 +567,36 @@
     WAIT_UNTIL(called == 1, 1, @"Not called within 1 sec");
 }
 
+- (void)testFulfilledQueueOrder {
+    OMDeferred *deferred = [OMDeferred new];
+
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0);
+    dispatch_queue_t serialQueue = dispatch_queue_create("de.reaktor42.OMPromisesTests", DISPATCH_QUEUE_SERIAL);
+
+    NSMutableArray *order = [NSMutableArray array];
+    NSMutableArray *serialOrder = [NSMutableArray array];
+
+    // handlers targeting a queue are delivered as a batch, even a concurrent queue keeps their order
+    for (int i = 0; i < 50; ++i) {
+        [[deferred.promise
+            fulfilled:^(id result) {
+                [order addObject:@(i)];
+            } on:queue]
+            fulfilled:^(id result) {
+                [serialOrder addObject:@(i)];
+            } on:serialQueue];
+    }
+
+    [deferred fulfil:self.result];
+
+    WAIT_UNTIL(order.count == 50 && serialOrder.count == 50, 1, @"Not called within 1 sec");
+
+    for (int i = 0; i < 50; ++i) {
+        XCTAssertEqualObjects(order[i], @(i), @"Should be called in registration order");
+        XCTAssertEqualObjects(serialOrder[i], @(i), @"Should be called in registration order");
+    }
+}
+
 - (void)testAlways {
     __block int called = 0;
 
@@ -450,6 +674,43 @@
     XCTAssertEqual(promise.result, self.result2, @"Result should be from inner promise");
 }
 
+- (void)testThenReturnAlreadyFailedPromise {
+    OMDeferred *deferred = [OMDeferred new];
+
+    OMPromise *promise = [deferred.promise then:^id(id _) {
+        return [OMPromise promiseWithError:self.error];
+    }];
+
+    [deferred fulfil:self.result];
+    XCTAssertEqual(promise.state, OMPromiseStateFailed, @"Promise should have failed");
+    XCTAssertEqual(promise.error, self.error, @"Error should be from inner promise");
+}
+
+- (void)testThenReturnPromiseRecursively {
+    NSPointerArray *promises = [NSPointerArray weakObjectsPointerArray];
+
+    __block OMPromise *(^poll)(int);
+    poll = ^(int remaining) {
+        OMPromise *promise = [[OMPromise promiseWithResult:@(remaining) after:0] then:^id(NSNumber *n) {
+            return n.intValue == 0 ? self.result : poll(n.intValue - 1);
+        }];
+
+        [promises addPointer:(__bridge void *)promise];
+        return promise;
+    };
+
+    OMPromise *promise = poll(100);
+
+    WAIT_UNTIL(promise.state == OMPromiseStateFulfilled, 2, @"Not fulfilled within 2 secs");
+    XCTAssertEqual(promise.result, self.result, @"Result should be from the innermost promise");
+
+    poll = nil;
+
+    // intermediate promises are not kept alive by the adopting outermost one
+    [promises compact];
+    XCTAssertLessThan(promises.count, 10, @"Intermediate promises should have been released");
+}
+
 - (void)testThenReturnValue {
     OMDeferred *deferred = [OMDeferred new];
 
@@ -699,6 +960,151 @@
     XCTAssertEqual(failed, 1, @"failed-block should have been called once");
 }
 
+- (void)testCancelDerived {
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [deferred cancelled:^(OMDeferred *d) {
+        cancelled += 1;
+    }];
+
+    OMPromise *promise = [[deferred.promise
+        then:^id(id result) {
+            XCTFail(@"then-block shouldn't be called");
+            return result;
+        } on:nil]
+        rescue:^id(NSError *error) {
+            return error;
+        } on:nil];
+
+    XCTAssertTrue(promise.cancellable, @"Derived promises should be cancellable");
+
+    [promise cancel];
+
+    XCTAssertEqual(cancelled, 1, @"Cancellation should have propagated upstream");
+    XCTAssertEqual(deferred.promise.state, OMPromiseStateFailed, @"Upstream promise should have been cancelled");
+    XCTAssertEqual(promise.error.code, OMPromisesCancelledError, @"Error code should be cancelled");
+}
+
+- (void)testCancelSharedOnceAllConsumersCancelled {
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [deferred cancelled:^(OMDeferred *d) {
+        cancelled += 1;
+    }];
+
+    OMPromise *promise1 = [deferred.promise then:^id(id result) { return result; } on:nil];
+    OMPromise *promise2 = [OMPromise all:@[deferred.promise]];
+
+    [promise1 cancel];
+    XCTAssertEqual(cancelled, 0, @"Shared promise has still got an interested consumer");
+    XCTAssertEqual(deferred.promise.state, OMPromiseStateUnfulfilled, @"Shared promise should still be unfulfilled");
+
+    [promise2 cancel];
+    XCTAssertEqual(cancelled, 1, @"Shared promise should have been cancelled by its last consumer");
+    XCTAssertEqual(deferred.promise.state, OMPromiseStateFailed, @"Shared promise should have been cancelled");
+}
+
+- (void)testCancelAdopted {
+    OMDeferred *deferred = [OMDeferred new];
+    OMDeferred *inner = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [inner cancelled:^(OMDeferred *d) {
+        cancelled += 1;
+    }];
+
+    OMPromise *promise = [[deferred.promise then:^id(id result) {
+        return inner.promise;
+    } on:nil] then:^id(id result) {
+        return result;
+    } on:nil];
+
+    [deferred fulfil:nil];
+    [promise cancel];
+
+    XCTAssertEqual(cancelled, 1, @"Returned promise should have been cancelled");
+    XCTAssertEqual(promise.error.code, OMPromisesCancelledError, @"Error code should be cancelled");
+}
+
+- (void)testCancelAdoptedShared {
+    OMDeferred *deferred = [OMDeferred new];
+    OMDeferred *inner = [OMDeferred new];
+
+    // another consumer keeps the returned promise going
+    OMPromise *other = [inner.promise then:^id(id result) {
+        return result;
+    } on:nil];
+
+    OMPromise *promise = [deferred.promise then:^id(id result) {
+        return inner.promise;
+    } on:nil];
+
+    __block int fulfilled = 0;
+    [promise fulfilled:^(id result) {
+        fulfilled += 1;
+    } on:nil];
+
+    [deferred fulfil:nil];
+
+    __block int failed = 0;
+    [promise failed:^(NSError *error) {
+        XCTAssertEqual(error.code, OMPromisesCancelledError, @"Error code should be cancelled");
+        failed += 1;
+    } on:nil];
+
+    [promise cancel];
+
+    XCTAssertEqual(failed, 1, @"failed-block should have been called right away");
+    XCTAssertEqual(inner.promise.state, OMPromiseStateUnfulfilled, @"Shared promise has still got an interested consumer");
+
+    [inner fulfil:@1];
+
+    XCTAssertEqual(fulfilled, 0, @"fulfilled-block shouldn't be called once cancelled");
+    XCTAssertEqual(failed, 1, @"failed-block should have been called once");
+    XCTAssertEqualObjects(other.result, @1, @"Other consumer should get the result");
+}
+
+- (void)testCancelLazyBeforeStart {
+    OMLazyPromise *lazy = [OMLazyPromise promiseWithTask:^id{
+        XCTFail(@"Task shouldn't be started");
+        return nil;
+    }];
+
+    XCTAssertTrue(lazy.cancellable, @"Lazy promises should be cancellable");
+
+    [lazy cancel];
+    [lazy start];
+
+    XCTAssertFalse(lazy.started, @"Cancelled lazy promise shouldn't start");
+    XCTAssertEqual(lazy.state, OMPromiseStateFailed, @"Lazy promise should have been cancelled");
+}
+
+- (void)testCancelLazyWhileRunning {
+    __block OMDeferred *running = nil;
+    OMLazyPromise *lazy = [OMLazyPromise promiseWithDetailedTask:^(OMDeferred *deferred) {
+        running = deferred;
+    }];
+
+    [lazy start];
+    WAIT_UNTIL(running != nil, 1, @"Task should have been started");
+
+    XCTAssertFalse(lazy.cancellable, @"Running task doesn't support cancellation");
+
+    OMPromise *derived = [lazy then:^id(id result) {
+        return result;
+    } on:nil];
+    [derived cancel];
+
+    XCTAssertEqual(derived.error.code, OMPromisesCancelledError, @"Derived promise should have been cancelled");
+    XCTAssertEqual(lazy.state, OMPromiseStateUnfulfilled, @"Running task should keep going");
+
+    [running fulfil:self.result];
+
+    XCTAssertEqual(lazy.state, OMPromiseStateFulfilled, @"Task should settle its promise regularly");
+}
+
 #pragma mark - Combinators & Transformers
 
 - (void)testJoinOnlyOneLevel {
@@ -1031,6 +1437,127 @@
     XCTAssertEqual(any.error.code, OMPromisesCombinatorAnyNonFulfilledError, @"Error should be combinator specific");
 }
 
+- (void)testAnyCancellingOthers {
+    OMDeferred *deferred1 = [OMDeferred new];
+    OMDeferred *deferred2 = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [deferred2 cancelled:^(OMDeferred *d) {
+        cancelled += 1;
+    }];
+
+    OMPromise *any = [OMPromise anyCancellingOthers:@[deferred1.promise, deferred2.promise]];
+
+    [deferred1 fulfil:self.result];
+    XCTAssertEqual(any.state, OMPromiseStateFulfilled, @"Any should be fulfilled");
+    XCTAssertEqual(any.result, self.result, @"Result should be from the fulfilled promise");
+    XCTAssertEqual(cancelled, 1, @"Other promise should have been cancelled");
+    XCTAssertEqual(deferred2.promise.state, OMPromiseStateFailed, @"Other promise should have been cancelled");
+}
+
+- (void)testRaceEmptyArray {
+    OMPromise *race = [OMPromise race:@[]];
+    XCTAssertEqual(race.state, OMPromiseStateFailed, @"Race without any promise should have failed");
+    XCTAssertTrue([race.error.domain isEqualToString:OMPromisesErrorDomain], @"Error should be combinator specific");
+    XCTAssertEqual(race.error.code, OMPromisesCombinatorRaceEmptyError, @"Error should be combinator specific");
+}
+
+- (void)testRaceFulfil {
+    OMDeferred *deferred1 = [OMDeferred new];
+    OMDeferred *deferred2 = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [deferred1 cancelled:^(OMDeferred *d) {
+        cancelled += 1;
+    }];
+
+    OMPromise *race = [OMPromise race:@[deferred1.promise, deferred2.promise]];
+
+    [deferred1 progress:.5f];
+    XCTAssertEqualWithAccuracy(race.progress, .5f, FLT_EPSILON, @"Race should be half way done");
+
+    [deferred2 fulfil:self.result];
+    XCTAssertEqual(race.state, OMPromiseStateFulfilled, @"Race should be fulfilled");
+    XCTAssertEqual(race.result, self.result, @"Result should be from the first promise");
+    XCTAssertEqual(cancelled, 1, @"Loser should have been cancelled");
+}
+
+- (void)testRaceFail {
+    OMDeferred *deferred1 = [OMDeferred new];
+    OMDeferred *deferred2 = [OMDeferred new];
+
+    OMPromise *race = [OMPromise race:@[deferred1.promise, deferred2.promise]];
+
+    [deferred1 fail:self.error];
+    XCTAssertEqual(race.state, OMPromiseStateFailed, @"Race should have failed");
+    XCTAssertEqual(race.error, self.error, @"Error should be from the first promise");
+
+    [deferred2 fulfil:self.result];
+    XCTAssertEqual(race.state, OMPromiseStateFailed, @"Outcome shouldn't change anymore");
+}
+
+- (void)testRaceDetachesLosers {
+    OMDeferred *deferred1 = [OMDeferred new];
+    OMDeferred *deferred2 = [OMDeferred new];
+    OMPromise *shared = deferred1.promise;
+
+    __weak OMPromise *weakRace = nil;
+    @autoreleasepool {
+        OMPromise *race = [OMPromise race:@[shared, deferred2.promise]];
+        weakRace = race;
+
+        [deferred2 fulfil:self.result];
+        XCTAssertEqual(race.state, OMPromiseStateFulfilled, @"Race should be fulfilled");
+        XCTAssertEqualWithAccuracy(race.progress, 1.f, FLT_EPSILON, @"Race should be done");
+    }
+
+    // the loser can't be cancelled, yet it must not keep the decided race alive
+    XCTAssertEqual(shared.state, OMPromiseStateUnfulfilled, @"Loser should still be unfulfilled");
+    XCTAssertNil(weakRace, @"Race should have been released");
+
+    [deferred1 progress:.5f];
+    [deferred1 fulfil:self.result2];
+    XCTAssertEqual(shared.state, OMPromiseStateFulfilled, @"Loser should be fulfilled");
+}
+
+- (void)testSomeFulfil {
+    OMDeferred *deferred1 = [OMDeferred new];
+    OMDeferred *deferred2 = [OMDeferred new];
+    OMDeferred *deferred3 = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [deferred1 cancelled:^(OMDeferred *d) {
+        cancelled += 1;
+    }];
+
+    OMPromise *some = [OMPromise some:@[deferred1.promise, deferred2.promise, deferred3.promise] count:2];
+
+    [deferred3 fulfil:self.result];
+    XCTAssertEqual(some.state, OMPromiseStateUnfulfilled, @"Some should be unfulfilled");
+    [deferred2 fulfil:nil];
+    XCTAssertEqual(some.state, OMPromiseStateFulfilled, @"Some should be fulfilled");
+    XCTAssertEqualObjects(some.result, (@[self.result, NSNull.null]), @"Results should be in order of fulfilment");
+    XCTAssertEqual(cancelled, 1, @"Remaining promise should have been cancelled");
+}
+
+- (void)testSomeFail {
+    OMDeferred *deferred1 = [OMDeferred new];
+    OMDeferred *deferred2 = [OMDeferred new];
+    OMDeferred *deferred3 = [OMDeferred new];
+
+    OMPromise *some = [OMPromise some:@[deferred1.promise, deferred2.promise, deferred3.promise] count:2];
+
+    [deferred1 fulfil:self.result];
+    [deferred2 fail:self.error];
+    XCTAssertEqual(some.state, OMPromiseStateUnfulfilled, @"Some should be unfulfilled");
+    [deferred3 fail:self.error];
+    XCTAssertEqual(some.state, OMPromiseStateFailed, @"Some should have failed");
+    XCTAssertEqual(some.error.code, OMPromisesCombinatorSomeNotEnoughFulfilledError, @"Error should be combinator specific");
+
+    XCTAssertEqual([OMPromise some:@[deferred1.promise] count:2].state, OMPromiseStateFailed,
+                   @"Should fail if there are too few promises");
+}
+
 - (void)testAllEmptyArray {
     OMPromise *all = [OMPromise all:@[]];
     XCTAssertEqual(all.state, OMPromiseStateFulfilled, @"An empty set of promises should lead to fulfilled");
@@ -1104,6 +1631,124 @@
     XCTAssertTrue([collected.result isEqualToArray:(@[self.error, self.result, NSNull.null])], @"Collected should cumulate all results");
 }
 
+- (void)testMapEmpty {
+    OMPromise *mapped = [OMPromise map:@[] concurrency:2 task:^OMPromise *(id item) {
+        XCTFail(@"Task shouldn't be called");
+        return nil;
+    }];
+
+    XCTAssertEqual(mapped.state, OMPromiseStateFulfilled, @"Mapped should be fulfilled");
+    XCTAssertTrue([mapped.result isEqualToArray:@[]], @"Mapped should contain no results");
+}
+
+- (void)testMapConcurrency {
+    NSMutableArray *deferreds = [NSMutableArray array];
+
+    OMPromise *mapped = [OMPromise map:@[@0, @1, @2, @3] concurrency:2 task:^OMPromise *(NSNumber *item) {
+        OMDeferred *deferred = [OMDeferred new];
+        [deferreds addObject:deferred];
+        return deferred.promise;
+    }];
+
+    XCTAssertEqual(deferreds.count, 2U, @"Only two tasks should be in flight");
+
+    [deferreds[1] fulfil:@1];
+    XCTAssertEqual(deferreds.count, 3U, @"Next task should have been started");
+    XCTAssertEqualWithAccuracy(mapped.progress, 1/4.f, FLT_EPSILON, @"Progress by number of settled promises");
+
+    [deferreds[0] fulfil:nil];
+    [deferreds[3] fulfil:@3];
+    XCTAssertEqual(deferreds.count, 4U, @"All tasks should have been started");
+    XCTAssertEqual(mapped.state, OMPromiseStateUnfulfilled, @"Mapped should still be unfulfilled");
+
+    [deferreds[2] fulfil:@2];
+    XCTAssertEqual(mapped.state, OMPromiseStateFulfilled, @"Mapped should be fulfilled");
+    XCTAssertTrue([mapped.result isEqualToArray:(@[NSNull.null, @1, @2, @3])], @"Results should be in order of the items");
+}
+
+- (void)testMapFail {
+    NSMutableArray *deferreds = [NSMutableArray array];
+    __block int cancelled = 0;
+
+    OMPromise *mapped = [OMPromise map:@[@0, @1, @2] concurrency:2 task:^OMPromise *(NSNumber *item) {
+        OMDeferred *deferred = [OMDeferred new];
+        [deferred cancelled:^(OMDeferred *d) {
+            cancelled += 1;
+        }];
+        [deferreds addObject:deferred];
+        return deferred.promise;
+    }];
+
+    [deferreds[0] fail:self.error];
+
+    XCTAssertEqual(mapped.state, OMPromiseStateFailed, @"Mapped should have failed");
+    XCTAssertEqual(mapped.error, self.error, @"Mapped should have the error of the failed promise");
+    XCTAssertEqual(deferreds.count, 2U, @"No further task should have been started");
+    XCTAssertEqual(cancelled, 1, @"Promise in flight should have been cancelled");
+}
+
+- (void)testForEachEnumerator {
+    NSMutableArray *items = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 10000; ++i) {
+        [items addObject:@(i)];
+    }
+
+    __block NSUInteger called = 0;
+
+    OMPromise *promise = [OMPromise forEach:items.objectEnumerator concurrency:4 task:^OMPromise *(NSNumber *item) {
+        XCTAssertEqual(item.unsignedIntegerValue, called, @"Items should be pulled in order");
+        called += 1;
+        return [OMPromise promiseWithResult:item];
+    }];
+
+    XCTAssertEqual(called, items.count, @"Task should have been called for each item");
+    XCTAssertEqual(promise.state, OMPromiseStateFulfilled, @"Promise should be fulfilled");
+    XCTAssertNil(promise.result, @"Results shouldn't be kept");
+}
+
+- (void)testTimeout {
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block int cancelled = 0;
+    [deferred cancelled:^(OMDeferred *d) {
+        cancelled += 1;
+    }];
+
+    OMPromise *promise = [deferred.promise timeout:.05];
+
+    NSError *error = [promise waitForErrorWithin:1];
+    XCTAssertEqual(error.domain, OMPromisesErrorDomain, @"Error domain incorrect");
+    XCTAssertEqual(error.code, OMPromisesTimeoutError, @"Promise should have timed out");
+
+    WAIT_UNTIL(cancelled == 1, 1, @"Timed out promise should have been cancelled");
+}
+
+- (void)testTimeoutSettledInTime {
+    OMDeferred *deferred = [OMDeferred new];
+
+    OMPromise *promise = [deferred.promise timeout:.05];
+    [deferred fulfil:self.result];
+
+    XCTAssertEqual(promise.state, OMPromiseStateFulfilled, @"Promise should be fulfilled");
+
+    WAIT_FOR(.1);
+    XCTAssertEqual(promise.result, self.result, @"Deadline shouldn't change the outcome anymore");
+}
+
+- (void)testDelay {
+    OMDeferred *deferred = [OMDeferred new];
+
+    OMPromise *promise = [deferred.promise delay:.05];
+
+    [deferred progress:.5f];
+    XCTAssertEqualWithAccuracy(promise.progress, .5f, FLT_EPSILON, @"Progress should be passed along right away");
+
+    [deferred fulfil:self.result];
+    XCTAssertEqual(promise.state, OMPromiseStateUnfulfilled, @"Outcome should be postponed");
+
+    XCTAssertEqual([promise waitForResultWithin:1], self.result, @"Outcome should be taken over");
+}
+
 - (void)testRelay {
     OMDeferred *from = [OMDeferred new];
     OMDeferred *to = [OMDeferred new];
@@ -1131,6 +1776,64 @@
     XCTAssertNil(to.promise.error, @"Should not change nor crash");
 }
 
+#pragma mark - Awaiting
+
+- (void)testAwaitOnWorkerThread {
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block id result = nil;
+    __block NSError *error = nil;
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        result = [deferred.promise await:&error];
+        dispatch_semaphore_signal(done);
+    });
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(.05 * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [deferred fulfil:self.result];
+    });
+
+    XCTAssertEqual(dispatch_semaphore_wait(done, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC)), 0L,
+                   @"Awaiting thread should have been woken up");
+    XCTAssertEqual(result, self.result, @"Should return the result");
+    XCTAssertNil(error, @"There shouldn't be an error");
+}
+
+- (void)testAwaitOnMainThread {
+    OMDeferred *deferred = [OMDeferred new];
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [deferred fail:self.error];
+    });
+
+    NSError *error = nil;
+    XCTAssertNil([deferred.promise await:&error], @"There shouldn't be a result");
+    XCTAssertEqual(error, self.error, @"Should return the error");
+}
+
+- (void)testAwaitWithinTimeout {
+    OMDeferred *deferred = [OMDeferred new];
+
+    NSError *error = nil;
+    XCTAssertNil([deferred.promise awaitWithin:.05 error:&error], @"There shouldn't be a result");
+    XCTAssertEqual(error.domain, OMPromisesErrorDomain, @"Error domain incorrect");
+    XCTAssertEqual(error.code, OMPromisesTimeoutError, @"Should have timed out");
+}
+
+- (void)testAwaitAll {
+    NSArray *promises = @[
+        [OMPromise promiseWithResult:@1 after:.01],
+        [OMPromise promiseWithTask:^id{ return @2; }],
+        [OMPromise promiseWithResult:@3]
+    ];
+
+    NSError *error = nil;
+    XCTAssertEqualObjects([OMPromise awaitAll:promises error:&error], (@[@1, @2, @3]), @"Should return all results");
+    XCTAssertNil(error, @"There shouldn't be an error");
+}
+
 #pragma mark - Testing
 
 - (void)testWaitForResultWithin {
@@ -0,0 +1,234 @@
+//
+// OMStreamTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMDeferredStream.h"
+
+@interface OMStreamTests : XCTestCase
+@end
+
+@implementation OMStreamTests
+
+- (void)testBackpressure {
+    OMDeferredStream *deferred = [[OMDeferredStream alloc] initWithCapacity:2];
+    NSMutableArray *values = [NSMutableArray array];
+
+    [deferred.stream values:^(id value) {
+        [values addObject:value];
+    }];
+
+    XCTAssertEqual(deferred.demand, 2U, @"Buffer should be empty");
+    XCTAssertTrue([deferred push:@1]);
+    XCTAssertTrue([deferred push:@2]);
+    XCTAssertFalse([deferred push:@3], @"Buffer should be full");
+    XCTAssertEqual(deferred.demand, 0U);
+    XCTAssertEqual(values.count, 0U, @"Nothing should be delivered without demand");
+
+    __block NSUInteger requested = 0;
+    [deferred requested:^(NSUInteger count) {
+        requested += count;
+    }];
+
+    [deferred.stream request:3];
+    XCTAssertEqual(requested, 3U, @"Producer should be notified about the demand");
+    XCTAssertEqualObjects(values, (@[@1, @2]), @"Buffered values should be delivered");
+    XCTAssertEqual(deferred.demand, 3U, @"One requested value and an empty buffer");
+
+    XCTAssertTrue([deferred push:@3]);
+    XCTAssertEqualObjects(values, (@[@1, @2, @3]), @"Requested values should be delivered right away");
+
+    [deferred complete];
+    XCTAssertEqual(deferred.stream.completion.state, OMPromiseStateFulfilled, @"Stream should be drained");
+    XCTAssertFalse([deferred push:@4], @"Completed streams should not accept values");
+}
+
+- (void)testCompleteAfterDrained {
+    OMDeferredStream *deferred = [OMDeferredStream new];
+
+    [deferred push:@1];
+    [deferred complete];
+    XCTAssertEqual(deferred.stream.completion.state, OMPromiseStateUnfulfilled, @"A value is still buffered");
+
+    OMPromise *collected = [deferred.stream collect];
+    XCTAssertEqualObjects(collected.result, @[@1], @"Buffered value should be collected");
+}
+
+- (void)testFail {
+    OMDeferredStream *deferred = [OMDeferredStream new];
+    NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:0 userInfo:nil];
+
+    OMPromise *collected = [deferred.stream collect];
+    [deferred push:@1];
+    [deferred fail:error];
+
+    XCTAssertEqual(collected.state, OMPromiseStateFailed);
+    XCTAssertEqual(collected.error, error, @"Error should be passed along");
+}
+
+- (void)testCancel {
+    OMDeferredStream *deferred = [OMDeferredStream new];
+
+    __block int cancelled = 0;
+    [deferred cancelled:^{
+        cancelled += 1;
+    }];
+
+    OMPromise *collected = [[deferred.stream map:^id(id value) {
+        return value;
+    }] collect];
+
+    [deferred push:@1];
+    [collected cancel];
+
+    XCTAssertEqual(cancelled, 1, @"Producer should be notified once");
+    XCTAssertEqual(deferred.stream.completion.error.code, OMPromisesCancelledError);
+    XCTAssertFalse([deferred push:@2], @"Cancelled streams should not accept values");
+}
+
+- (void)testMapFilter {
+    OMDeferredStream *deferred = [[OMDeferredStream alloc] initWithCapacity:1];
+
+    __block NSUInteger produced = 0;
+    [deferred requested:^(NSUInteger count) {
+        while (produced < 10 && [deferred push:@(produced)]) {
+            produced += 1;
+        }
+        if (produced == 10) {
+            [deferred complete];
+        }
+    }];
+
+    OMPromise *collected = [[[deferred.stream
+        filter:^BOOL(NSNumber *value) {
+            return value.integerValue % 2 == 0;
+        }]
+        map:^id(NSNumber *value) {
+            return @(value.integerValue * 10);
+        }]
+        collect];
+
+    XCTAssertEqualObjects(collected.result, (@[@0, @20, @40, @60, @80]));
+}
+
+- (void)testBuffer {
+    OMDeferredStream *deferred = [OMDeferredStream new];
+    NSMutableArray *batches = [NSMutableArray array];
+
+    OMStream *stream = [[deferred.stream buffer:2] values:^(NSArray *batch) {
+        [batches addObject:batch];
+    }];
+
+    __block NSUInteger requested = 0;
+    [deferred requested:^(NSUInteger count) {
+        requested += count;
+    }];
+
+    [stream request:1];
+    XCTAssertEqual(requested, 2U, @"Demand should be scaled by the batch size");
+
+    for (int i = 0; i < 3; ++i) {
+        [deferred push:@(i)];
+    }
+    [deferred complete];
+
+    XCTAssertEqualObjects(batches, (@[@[@0, @1]]), @"Only a single batch has been requested");
+
+    [stream request:1];
+    XCTAssertEqualObjects(batches, (@[@[@0, @1], @[@2]]), @"Partial batch should be flushed");
+    XCTAssertEqual(stream.completion.state, OMPromiseStateFulfilled);
+}
+
+- (void)testFlatMapConcurrency {
+    OMDeferredStream *deferred = [OMDeferredStream new];
+    NSMutableArray *deferreds = [NSMutableArray array];
+
+    __block NSUInteger requested = 0;
+    [deferred requested:^(NSUInteger count) {
+        requested += count;
+    }];
+
+    OMPromise *collected = [[deferred.stream flatMap:^OMPromise *(id value) {
+        OMDeferred *inner = [OMDeferred new];
+        [deferreds addObject:inner];
+        return inner.promise;
+    } concurrency:2] collect];
+
+    XCTAssertEqual(requested, 2U, @"At most two values should be requested");
+
+    [deferred push:@1];
+    [deferred push:@2];
+    XCTAssertEqual(deferreds.count, 2U);
+
+    [deferreds[1] fulfil:@"b"];
+    XCTAssertEqual(requested, 3U, @"Another value should be requested once a slot is free");
+
+    [deferred push:@3];
+    [deferred complete];
+    [deferreds[0] fulfil:@"a"];
+    XCTAssertEqual(collected.state, OMPromiseStateUnfulfilled, @"A promise is still in flight");
+
+    [deferreds[2] fulfil:@"c"];
+    XCTAssertEqualObjects(collected.result, (@[@"b", @"a", @"c"]), @"Results should be in fulfilment order");
+}
+
+- (void)testFlatMapFail {
+    OMDeferredStream *deferred = [OMDeferredStream new];
+    NSError *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:0 userInfo:nil];
+
+    __block int cancelled = 0;
+    [deferred cancelled:^{
+        cancelled += 1;
+    }];
+
+    OMPromise *collected = [[deferred.stream flatMap:^OMPromise *(id value) {
+        return [OMPromise promiseWithError:error];
+    } concurrency:1] collect];
+
+    [deferred push:@1];
+
+    XCTAssertEqual(collected.error, error, @"Error should be passed along");
+    XCTAssertEqual(cancelled, 1, @"Upstream should get cancelled");
+}
+
+- (void)testReduceOnProducerThread {
+    OMDeferredStream *deferred = [OMDeferredStream new];
+
+    OMPromise *sum = [deferred.stream reduce:^id(NSNumber *accumulator, NSNumber *value) {
+        return @(accumulator.integerValue + value.integerValue);
+    } initial:@0];
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for (int i = 1; i <= 100; ++i) {
+            [deferred push:@(i)];
+        }
+        [deferred complete];
+    });
+
+    WAIT_UNTIL(sum.state == OMPromiseStateFulfilled, 1, @"Stream should be reduced");
+    XCTAssertEqualObjects(sum.result, @5050);
+}
+
+@end
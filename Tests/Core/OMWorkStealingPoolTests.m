@@ -0,0 +1,124 @@
+//
+// OMWorkStealingPoolTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMWorkStealingPool.h"
+
+@interface OMCountingExecutor : NSObject <OMExecutor>
+
+@property(nonatomic, readonly) int executed;
+
+@end
+
+@implementation OMCountingExecutor {
+    _Atomic int _executed;
+}
+
+- (int)executed {
+    return atomic_load(&_executed);
+}
+
+- (void)execute:(dispatch_function_t)function context:(void *)context {
+    atomic_fetch_add(&_executed, 1);
+    dispatch_async_f(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), context, function);
+}
+
+@end
+
+@interface OMWorkStealingPoolTests : XCTestCase
+@end
+
+@implementation OMWorkStealingPoolTests
+
+- (void)tearDown {
+    [OMPromise setGlobalTaskQueue:nil];
+
+    [super tearDown];
+}
+
+- (void)testQueueWithExecutor {
+    OMCountingExecutor *executor = [OMCountingExecutor new];
+    dispatch_queue_t queue = [OMPromise queueWithExecutor:executor];
+
+    OMDeferred *deferred = [OMDeferred new];
+
+    __block BOOL called = NO;
+    [deferred.promise fulfilled:^(id result) {
+        called = YES;
+    } on:queue];
+
+    [deferred fulfil:nil];
+
+    WAIT_UNTIL(called, 1, @"fulfilled-block should have been called");
+    XCTAssertEqual(executor.executed, 1, @"The executor should have run the block");
+}
+
+- (void)testTasks {
+    dispatch_queue_t queue = [OMWorkStealingPool sharedPool].queue;
+
+    NSMutableArray *promises = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 1000; ++i) {
+        [promises addObject:[OMPromise promiseWithTask:^id{
+            return @(i);
+        } on:queue]];
+    }
+
+    OMPromise *all = [OMPromise all:promises];
+
+    WAIT_UNTIL(all.state == OMPromiseStateFulfilled, 1, @"All tasks should have been run");
+    XCTAssertEqualObjects([all.result lastObject], @999, @"Results should be in order");
+}
+
+- (void)testContinuations {
+    dispatch_queue_t queue = [OMWorkStealingPool sharedPool].queue;
+
+    OMPromise *promise = [OMPromise promiseWithTask:^id{
+        return @0;
+    } on:queue];
+
+    for (NSUInteger i = 0; i < 100; ++i) {
+        promise = [promise then:^id(NSNumber *result) {
+            XCTAssertFalse([NSThread isMainThread], @"Should run on a worker");
+            return @(result.integerValue + 1);
+        } on:queue];
+    }
+
+    WAIT_UNTIL(promise.state == OMPromiseStateFulfilled, 1, @"Chain should have been run");
+    XCTAssertEqualObjects(promise.result, @100, @"Each continuation should have been run once");
+}
+
+- (void)testGlobalTaskQueue {
+    [OMPromise setGlobalTaskQueue:[OMWorkStealingPool sharedPool].queue];
+
+    OMPromise *promise = [OMPromise promiseWithTask:^id{
+        return @([NSThread isMainThread]);
+    }];
+
+    WAIT_UNTIL(promise.state == OMPromiseStateFulfilled, 1, @"Task should have been run");
+    XCTAssertEqualObjects(promise.result, @NO, @"Task should have been run on a worker");
+}
+
+@end
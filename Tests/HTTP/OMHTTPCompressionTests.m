@@ -0,0 +1,89 @@
+//
+// OMHTTPCompressionTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import <zlib.h>
+
+#import "OMHTTPCompression.h"
+#import "OMHTTPRequest.h"
+
+@interface OMHTTPCompressionTests : XCTestCase
+@end
+
+@implementation OMHTTPCompressionTests
+
+- (void)testGzip {
+    NSData *data = [self repetitiveData];
+    NSData *compressed = OMCompressedData(data, OMHTTPCompressionGzip);
+
+    XCTAssertLessThan(compressed.length, data.length / 5);
+    XCTAssertEqual(((const uint8_t *)compressed.bytes)[0], (uint8_t)0x1f, @"Should start with the gzip magic number");
+    XCTAssertEqual(((const uint8_t *)compressed.bytes)[1], (uint8_t)0x8b, @"Should start with the gzip magic number");
+    XCTAssertEqualObjects([self inflate:compressed], data);
+}
+
+- (void)testDeflate {
+    NSData *data = [self repetitiveData];
+    NSData *compressed = OMCompressedData(data, OMHTTPCompressionDeflate);
+
+    XCTAssertLessThan(compressed.length, data.length / 5);
+    XCTAssertEqual(((const uint8_t *)compressed.bytes)[0] & 0x0f, 8, @"Should use the zlib format");
+    XCTAssertEqualObjects([self inflate:compressed], data);
+}
+
+- (void)testUnknownCoding {
+    XCTAssertNil(OMCompressedData([self repetitiveData], @"br"));
+}
+
+#pragma mark - Helper
+
+- (NSData *)repetitiveData {
+    NSMutableString *string = [NSMutableString string];
+    for (NSUInteger i = 0; i < 1000; ++i) {
+        [string appendFormat:@"{\"id\":%@,\"name\":\"item\"},", @(i % 10)];
+    }
+    return [string dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+/** Detects both formats by their header. */
+- (NSData *)inflate:(NSData *)data {
+    z_stream stream = {0};
+    inflateInit2(&stream, 15 + 32);
+
+    NSMutableData *inflated = [NSMutableData dataWithLength:1024 * 1024];
+    stream.next_in = (Bytef *)data.bytes;
+    stream.avail_in = (uInt)data.length;
+    stream.next_out = inflated.mutableBytes;
+    stream.avail_out = (uInt)inflated.length;
+
+    int status = inflate(&stream, Z_FINISH);
+    inflated.length = stream.total_out;
+    inflateEnd(&stream);
+
+    return status == Z_STREAM_END ? inflated : nil;
+}
+
+@end
@@ -0,0 +1,302 @@
+//
+// OMHTTPRequestTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMHTTPRequest+Internal.h"
+#import "OMHTTPResponse.h"
+
+/** Host answered by OMHTTPStubProtocol, all other requests are left alone.
+ */
+static NSString *const kStubHost = @"stub.omhttp.test";
+
+/** Answers requests to kStubHost using the responder registered for their path,
+ requests without one never get an answer.
+ */
+@interface OMHTTPStubProtocol : NSURLProtocol
+
++ (void)stubPath:(NSString *)path responder:(void (^)(OMHTTPStubProtocol *stub))responder;
++ (NSUInteger)hitsForPath:(NSString *)path;
++ (void)reset;
+
+/** Sends the response, each chunk as a separate load, and finishes unless the
+ error is given.
+ */
+- (void)respondWithStatus:(NSInteger)statusCode chunks:(NSArray<NSData *> *)chunks error:(NSError *)error;
+
+@end
+
+@implementation OMHTTPStubProtocol
+
++ (NSMutableDictionary *)responders {
+    static NSMutableDictionary *responders = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        responders = [NSMutableDictionary dictionary];
+    });
+
+    return responders;
+}
+
++ (NSMutableDictionary *)hits {
+    static NSMutableDictionary *hits = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        hits = [NSMutableDictionary dictionary];
+    });
+
+    return hits;
+}
+
++ (void)stubPath:(NSString *)path responder:(void (^)(OMHTTPStubProtocol *stub))responder {
+    @synchronized (self) {
+        self.responders[path] = [responder copy];
+    }
+}
+
++ (NSUInteger)hitsForPath:(NSString *)path {
+    @synchronized (self) {
+        return [self.hits[path] unsignedIntegerValue];
+    }
+}
+
++ (void)reset {
+    @synchronized (self) {
+        [self.responders removeAllObjects];
+        [self.hits removeAllObjects];
+    }
+}
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+    return [request.URL.host isEqualToString:kStubHost];
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+    return request;
+}
+
+- (void)startLoading {
+    NSString *path = self.request.URL.path;
+    void (^responder)(OMHTTPStubProtocol *) = nil;
+
+    @synchronized (OMHTTPStubProtocol.class) {
+        OMHTTPStubProtocol.hits[path] = @([OMHTTPStubProtocol.hits[path] unsignedIntegerValue] + 1);
+        responder = OMHTTPStubProtocol.responders[path];
+    }
+
+    if (responder) {
+        responder(self);
+    }
+}
+
+- (void)stopLoading {
+}
+
+- (void)respondWithStatus:(NSInteger)statusCode chunks:(NSArray<NSData *> *)chunks error:(NSError *)error {
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:self.request.URL
+                                                              statusCode:statusCode
+                                                             HTTPVersion:@"HTTP/1.1"
+                                                            headerFields:@{@"Content-Type": @"application/octet-stream"}];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+
+    for (NSData *chunk in chunks) {
+        [self.client URLProtocol:self didLoadData:chunk];
+    }
+
+    if (error) {
+        [self.client URLProtocol:self didFailWithError:error];
+    } else {
+        [self.client URLProtocolDidFinishLoading:self];
+    }
+}
+
+@end
+
+@interface OMHTTPRequestTests : XCTestCase
+@end
+
+@implementation OMHTTPRequestTests
+
+- (void)setUp {
+    [super setUp];
+
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        [OMHTTPRequest setProtocolClasses:@[OMHTTPStubProtocol.class]];
+    });
+}
+
+- (void)tearDown {
+    [OMHTTPStubProtocol reset];
+    [OMHTTPRequest setMaximumConcurrentRequestsPerHost:4];
+
+    [super tearDown];
+}
+
+#pragma mark - Streamed Body
+
+- (void)testStreamedBodyToSlowConsumer {
+    // more chunks than the stream buffers, thus reading has to pause
+    NSArray *chunks = [self chunks:40];
+    [OMHTTPStubProtocol stubPath:@"/slow" responder:^(OMHTTPStubProtocol *stub) {
+        [stub respondWithStatus:200 chunks:chunks error:nil];
+    }];
+
+    OMHTTPResponse *response = [[self get:@"/slow" options:@{OMHTTPStreamBody: @YES}] waitForResultWithin:1.];
+    XCTAssertNotNil(response.bodyStream, @"The body should be streamed");
+    XCTAssertNil(response.body, @"The body shouldn't be kept in memory");
+
+    OMStream *stream = response.bodyStream;
+    NSMutableData *body = [NSMutableData data];
+    __block NSUInteger lengthAtCompletion = 0;
+
+    [stream values:^(NSData *chunk) {
+        [body appendData:chunk];
+    } on:dispatch_get_main_queue()];
+    [stream.completion fulfilled:^(id _) {
+        lengthAtCompletion = body.length;
+    } on:dispatch_get_main_queue()];
+
+    WAIT_FOR(.1);
+    XCTAssertEqual(body.length, 0U, @"Nothing should be delivered without demand");
+    XCTAssertEqual(stream.completion.state, OMPromiseStateUnfulfilled, @"The stream should wait for its consumer");
+
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:2.];
+    while (stream.completion.state == OMPromiseStateUnfulfilled && [deadline timeIntervalSinceNow] > 0) {
+        [stream request:1];
+        WAIT_FOR(.01);
+    }
+
+    WAIT_UNTIL(lengthAtCompletion > 0, 1, @"The stream should have completed");
+    XCTAssertEqualObjects(body, [self join:chunks], @"All chunks should be delivered in order");
+    XCTAssertEqual(lengthAtCompletion, body.length, @"The stream should complete after its last chunk");
+}
+
+- (void)testStreamedBodyFailure {
+    NSError *lost = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil];
+    [OMHTTPStubProtocol stubPath:@"/lost" responder:^(OMHTTPStubProtocol *stub) {
+        [stub respondWithStatus:200 chunks:[self chunks:4] error:lost];
+    }];
+
+    OMHTTPResponse *response = [[self get:@"/lost" options:@{OMHTTPStreamBody: @YES}] waitForResultWithin:1.];
+    XCTAssertNotNil(response.bodyStream, @"The headers arrived before the connection got lost");
+
+    [response.bodyStream values:^(NSData *chunk) {} on:nil];
+    [response.bodyStream request:NSUIntegerMax];
+
+    NSError *error = [response.bodyStream.completion waitForErrorWithin:1.];
+    XCTAssertEqualObjects(error.domain, OMPromisesHTTPErrorDomain, @"The stream should fail along with the request");
+    XCTAssertEqual(error.code, OMPromisesHTTPRequestError, @"The stream should fail along with the request");
+    XCTAssertEqual([error.userInfo[NSUnderlyingErrorKey] code], NSURLErrorNetworkConnectionLost);
+}
+
+- (void)testStreamedBodyStatusError {
+    [OMHTTPStubProtocol stubPath:@"/missing" responder:^(OMHTTPStubProtocol *stub) {
+        [stub respondWithStatus:404 chunks:[self chunks:1] error:nil];
+    }];
+
+    NSError *error = [[self get:@"/missing" options:@{OMHTTPStreamBody: @YES}] waitForErrorWithin:1.];
+    XCTAssertEqual(error.code, OMPromisesHTTPStatusError, @"Failed responses shouldn't be streamed");
+    XCTAssertEqual([error.userInfo[OMHTTPResponseKey] statusCode], 404U);
+}
+
+#pragma mark - Download To File
+
+- (void)testDownloadToFile {
+    NSArray *chunks = [self chunks:8];
+    [OMHTTPStubProtocol stubPath:@"/file" responder:^(OMHTTPStubProtocol *stub) {
+        [stub respondWithStatus:200 chunks:chunks error:nil];
+    }];
+
+    OMHTTPResponse *response = [[self get:@"/file" options:@{OMHTTPDownloadToFile: @YES}] waitForResultWithin:1.];
+    XCTAssertNotNil(response.bodyURL, @"The body should have been written to a file");
+    XCTAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:response.bodyURL.path], @"The file should be kept");
+    XCTAssertEqualObjects(response.body, [self join:chunks], @"The file should contain the body");
+
+    [[NSFileManager defaultManager] removeItemAtURL:response.bodyURL error:nil];
+}
+
+- (void)testDownloadToFileFailure {
+    NSError *lost = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil];
+    [OMHTTPStubProtocol stubPath:@"/partial" responder:^(OMHTTPStubProtocol *stub) {
+        [stub respondWithStatus:200 chunks:[self chunks:2] error:lost];
+    }];
+
+    NSError *error = [[self get:@"/partial" options:@{OMHTTPDownloadToFile: @YES}] waitForErrorWithin:1.];
+    XCTAssertEqualObjects(error.domain, OMPromisesHTTPErrorDomain);
+    XCTAssertEqual(error.code, OMPromisesHTTPRequestError, @"The download should fail along with the connection");
+}
+
+#pragma mark - Scheduling
+
+- (void)testCancelWhileQueued {
+    [OMHTTPRequest setMaximumConcurrentRequestsPerHost:1];
+
+    // never answered, thus occupies the only slot of the host
+    OMPromise *blocking = [self get:@"/blocking" options:nil];
+    OMPromise *queued = [self get:@"/queued" options:nil];
+
+    WAIT_UNTIL([OMHTTPStubProtocol hitsForPath:@"/blocking"] == 1, 1, @"The first request should have started");
+
+    [queued cancel];
+    XCTAssertEqual([queued waitForErrorWithin:1.].code, OMPromisesCancelledError, @"The request should be cancelled");
+
+    [blocking cancel];
+    [blocking waitForErrorWithin:1.];
+    WAIT_FOR(.1);
+
+    XCTAssertEqual([OMHTTPStubProtocol hitsForPath:@"/queued"], 0U, @"The queued request should never have started");
+}
+
+#pragma mark - Helper
+
+- (OMPromise *)get:(NSString *)path options:(NSDictionary *)options {
+    NSMutableDictionary *merged = [NSMutableDictionary dictionaryWithObject:@NO forKey:OMHTTPCoalesce];
+    [merged addEntriesFromDictionary:options];
+
+    NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://%@%@", kStubHost, path]];
+    return [OMHTTPRequest requestWithMethod:@"GET" url:url parameters:nil options:merged];
+}
+
+- (NSArray<NSData *> *)chunks:(NSUInteger)count {
+    NSMutableArray *chunks = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; ++i) {
+        NSString *chunk = [NSString stringWithFormat:@"chunk %lu;", (unsigned long)i];
+        [chunks addObject:[chunk dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    return chunks;
+}
+
+- (NSData *)join:(NSArray<NSData *> *)chunks {
+    NSMutableData *data = [NSMutableData data];
+    for (NSData *chunk in chunks) {
+        [data appendData:chunk];
+    }
+
+    return data;
+}
+
+@end
@@ -0,0 +1,220 @@
+//
+// OMHTTPResponseCacheTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMHTTPResponse.h"
+#import "OMHTTPResponseCache+Internal.h"
+
+@interface OMHTTPResponseCacheTests : XCTestCase
+
+@property(nonatomic) NSURL *directory;
+@property(nonatomic) NSURLRequest *request;
+
+@end
+
+@implementation OMHTTPResponseCacheTests
+
+- (void)setUp {
+    [super setUp];
+
+    NSString *name = [NSString stringWithFormat:@"OMHTTPResponseCacheTests-%@", [NSUUID UUID].UUIDString];
+    self.directory = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+    self.request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/resource"]];
+}
+
+- (void)tearDown {
+    [[NSFileManager defaultManager] removeItemAtURL:self.directory error:nil];
+
+    [super tearDown];
+}
+
+- (void)testFreshResponse {
+    OMHTTPResponseCache *cache = [OMHTTPResponseCache new];
+    __block _Atomic int requests = 0;
+
+    OMPromise *(^perform)(NSURLRequest *) = ^OMPromise *(NSURLRequest *request) {
+        atomic_fetch_add(&requests, 1);
+        return [OMPromise promiseWithResult:[self response:200 headers:@{@"Cache-Control": @"max-age=60"} body:@"a"]];
+    };
+
+    OMHTTPResponse *first = [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:perform] waitForResultWithin:1.];
+    OMHTTPResponse *second = [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:perform] waitForResultWithin:1.];
+
+    XCTAssertEqualObjects(first.body, second.body);
+    XCTAssertEqual(atomic_load(&requests), 1, @"Fresh responses should be served from the cache");
+}
+
+- (void)testRevalidation {
+    OMHTTPResponseCache *cache = [OMHTTPResponseCache new];
+    __block NSURLRequest *revalidation = nil;
+
+    [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:^OMPromise *(NSURLRequest *request) {
+        return [OMPromise promiseWithResult:[self response:200 headers:@{@"ETag": @"\"v1\"", @"Cache-Control": @"no-cache"} body:@"a"]];
+    }] waitForResultWithin:1.];
+
+    OMHTTPResponse *response = [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:^OMPromise *(NSURLRequest *request) {
+        revalidation = request;
+        return [OMPromise promiseWithResult:[self response:304 headers:@{@"ETag": @"\"v1\""} body:nil]];
+    }] waitForResultWithin:1.];
+
+    XCTAssertEqualObjects([revalidation valueForHTTPHeaderField:@"If-None-Match"], @"\"v1\"");
+    XCTAssertEqual(response.statusCode, (NSUInteger)200, @"Not modified responses should be answered from the cache");
+    XCTAssertEqualObjects(response.body, [@"a" dataUsingEncoding:NSUTF8StringEncoding]);
+}
+
+- (void)testNoStore {
+    OMHTTPResponseCache *cache = [OMHTTPResponseCache new];
+    __block _Atomic int requests = 0;
+
+    OMPromise *(^perform)(NSURLRequest *) = ^OMPromise *(NSURLRequest *request) {
+        atomic_fetch_add(&requests, 1);
+        return [OMPromise promiseWithResult:[self response:200 headers:@{@"Cache-Control": @"no-store, max-age=60"} body:@"a"]];
+    };
+
+    [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:perform] waitForResultWithin:1.];
+    [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:perform] waitForResultWithin:1.];
+
+    XCTAssertEqual(atomic_load(&requests), 2, @"No-store responses must not be kept");
+}
+
+- (void)testStaleWhileRevalidate {
+    OMHTTPResponseCache *cache = [OMHTTPResponseCache new];
+
+    [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:^OMPromise *(NSURLRequest *request) {
+        return [OMPromise promiseWithResult:[self response:200 headers:@{@"ETag": @"\"v1\""} body:@"a"]];
+    }] waitForResultWithin:1.];
+
+    OMDeferred *refresh = [OMDeferred new];
+    OMHTTPResponse *stale = [[cache responseForRequest:self.request staleWhileRevalidate:YES perform:^OMPromise *(NSURLRequest *request) {
+        return refresh.promise;
+    }] waitForResultWithin:1.];
+
+    XCTAssertEqualObjects(stale.body, [@"a" dataUsingEncoding:NSUTF8StringEncoding],
+                          @"The stale response should be returned without waiting");
+
+    [refresh fulfil:[self response:200 headers:@{@"Cache-Control": @"max-age=60"} body:@"b"]];
+
+    OMHTTPResponse *refreshed = [[cache responseForRequest:self.request staleWhileRevalidate:YES perform:^OMPromise *(NSURLRequest *request) {
+        XCTFail(@"The refreshed response should be fresh");
+        return nil;
+    }] waitForResultWithin:1.];
+
+    XCTAssertEqualObjects(refreshed.body, [@"b" dataUsingEncoding:NSUTF8StringEncoding]);
+}
+
+- (void)testStaleWhileRevalidateHonorsDirectives {
+    OMHTTPResponseCache *cache = [OMHTTPResponseCache new];
+
+    NSArray *headers = @[
+        @{@"ETag": @"\"v1\"", @"Cache-Control": @"no-cache"},
+        @{@"ETag": @"\"v1\"", @"Cache-Control": @"max-age=0, must-revalidate"},
+        @{@"ETag": @"\"v1\"", @"Cache-Control": @"max-age=0, stale-while-revalidate=0"}
+    ];
+
+    for (NSDictionary *header in headers) {
+        [cache removeAllResponses];
+
+        [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:^OMPromise *(NSURLRequest *request) {
+            return [OMPromise promiseWithResult:[self response:200 headers:header body:@"a"]];
+        }] waitForResultWithin:1.];
+
+        OMHTTPResponse *response = [[cache responseForRequest:self.request staleWhileRevalidate:YES perform:^OMPromise *(NSURLRequest *request) {
+            return [OMPromise promiseWithResult:[self response:200 headers:header body:@"b"]];
+        }] waitForResultWithin:1.];
+
+        XCTAssertEqualObjects(response.body, [@"b" dataUsingEncoding:NSUTF8StringEncoding],
+                              @"The stale response must not be served for %@", header[@"Cache-Control"]);
+    }
+}
+
+- (void)testUnsafeRequestInvalidates {
+    OMHTTPResponseCache *cache = [OMHTTPResponseCache new];
+    __block _Atomic int requests = 0;
+
+    OMPromise *(^perform)(NSURLRequest *) = ^OMPromise *(NSURLRequest *request) {
+        atomic_fetch_add(&requests, 1);
+        return [OMPromise promiseWithResult:[self response:200 headers:@{@"Cache-Control": @"max-age=60"} body:@"a"]];
+    };
+
+    [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:perform] waitForResultWithin:1.];
+
+    NSMutableURLRequest *post = self.request.mutableCopy;
+    post.HTTPMethod = @"POST";
+    [[cache responseForUnsafeRequest:post perform:^OMPromise *(NSURLRequest *request) {
+        return [OMPromise promiseWithResult:[self response:201 headers:nil body:nil]];
+    }] waitForResultWithin:1.];
+
+    [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:perform] waitForResultWithin:1.];
+
+    XCTAssertEqual(atomic_load(&requests), 2, @"A successful POST should have invalidated the cached response");
+}
+
+- (void)testDiskPersistence {
+    OMHTTPResponseCache *cache = [[OMHTTPResponseCache alloc] initWithDirectory:self.directory];
+
+    [[cache responseForRequest:self.request staleWhileRevalidate:NO perform:^OMPromise *(NSURLRequest *request) {
+        return [OMPromise promiseWithResult:[self response:200 headers:@{@"Cache-Control": @"max-age=60"} body:@"a"]];
+    }] waitForResultWithin:1.];
+
+    WAIT_UNTIL([[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory.path error:nil].count == 1, 1.,
+               @"The response should have been written to disk");
+
+    OMHTTPResponseCache *restored = [[OMHTTPResponseCache alloc] initWithDirectory:self.directory];
+    OMHTTPResponse *response = [[restored responseForRequest:self.request staleWhileRevalidate:NO perform:^OMPromise *(NSURLRequest *request) {
+        XCTFail(@"The response should have been read from disk");
+        return nil;
+    }] waitForResultWithin:1.];
+
+    XCTAssertEqualObjects(response.body, [@"a" dataUsingEncoding:NSUTF8StringEncoding]);
+}
+
+- (void)testDiskCapacity {
+    OMHTTPResponseCache *cache = [[OMHTTPResponseCache alloc] initWithDirectory:self.directory];
+    NSString *body = [@"" stringByPaddingToLength:4096 withString:@"a" startingAtIndex:0];
+
+    for (NSUInteger i = 0; i < 4; ++i) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://example.com/resource/%lu", (unsigned long)i]];
+        [[cache responseForRequest:[NSURLRequest requestWithURL:url] staleWhileRevalidate:NO perform:^OMPromise *(NSURLRequest *request) {
+            return [OMPromise promiseWithResult:[self response:200 headers:@{@"Cache-Control": @"max-age=60"} body:body]];
+        }] waitForResultWithin:1.];
+
+        // leave room for a single response only from now on
+        cache.diskCapacity = 6 * 1024;
+    }
+
+    WAIT_UNTIL([[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory.path error:nil].count == 1, 1.,
+               @"Only the most recent response should have been kept on disk");
+}
+
+#pragma mark - Helper
+
+- (OMHTTPResponse *)response:(NSUInteger)statusCode headers:(NSDictionary *)headers body:(NSString *)body {
+    return [[OMHTTPResponse alloc] initWithCode:statusCode
+                                        headers:headers
+                                           body:[body dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+@end
@@ -0,0 +1,162 @@
+//
+// OMHTTPRetryPolicyTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMHTTPRequest.h"
+#import "OMHTTPResponse.h"
+#import "OMHTTPRetryPolicy.h"
+
+@interface OMHTTPRetryPolicyTests : XCTestCase
+@end
+
+@implementation OMHTTPRetryPolicyTests
+
+- (void)testPolicyForMethod {
+    XCTAssertNil([OMHTTPRetryPolicy policyForMethod:@"GET" options:nil], @"Requests are attempted once by default");
+    XCTAssertNil([OMHTTPRetryPolicy policyForMethod:@"POST" options:@{OMHTTPRetryAttempts: @3}],
+                 @"Non-idempotent requests must not be retried");
+
+    OMHTTPRetryPolicy *policy = [OMHTTPRetryPolicy policyForMethod:@"PUT" options:@{OMHTTPRetryAttempts: @3}];
+    XCTAssertEqual(policy.maximumAttempts, (NSUInteger)3);
+    XCTAssertEqualWithAccuracy(policy.baseDelay, .5, DBL_EPSILON);
+    XCTAssertTrue([policy.statusCodes containsObject:@503]);
+}
+
+- (void)testShouldRetryAfterError {
+    OMHTTPRetryPolicy *policy = [OMHTTPRetryPolicy policyForMethod:@"GET" options:@{OMHTTPRetryAttempts: @3}];
+
+    XCTAssertTrue([policy shouldRetryAfterError:[self statusError:503 headers:nil]]);
+    XCTAssertFalse([policy shouldRetryAfterError:[self statusError:404 headers:nil]]);
+    XCTAssertTrue([policy shouldRetryAfterError:[self requestError:NSURLErrorTimedOut]]);
+    XCTAssertTrue([policy shouldRetryAfterError:[self requestError:NSURLErrorNetworkConnectionLost]]);
+    XCTAssertFalse([policy shouldRetryAfterError:[self requestError:NSURLErrorBadURL]]);
+    XCTAssertFalse([policy shouldRetryAfterError:[NSError errorWithDomain:OMPromisesErrorDomain
+                                                                      code:OMPromisesCancelledError
+                                                                  userInfo:nil]],
+                   @"Cancellation must not be retried");
+}
+
+- (void)testDelayBeforeAttempt {
+    OMHTTPRetryPolicy *policy = [OMHTTPRetryPolicy policyForMethod:@"GET" options:@{
+        OMHTTPRetryAttempts: @10,
+        OMHTTPRetryDelay: @1.
+    }];
+
+    NSError *error = [self statusError:503 headers:nil];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        XCTAssertLessThanOrEqual([policy delayBeforeAttempt:2 error:error], 1.);
+        XCTAssertLessThanOrEqual([policy delayBeforeAttempt:4 error:error], 4.);
+        XCTAssertLessThanOrEqual([policy delayBeforeAttempt:10 error:error], 30., @"Delay should be capped");
+    }
+
+    NSError *throttled = [self statusError:429 headers:@{@"Retry-After": @"5"}];
+    XCTAssertGreaterThanOrEqual([policy delayBeforeAttempt:2 error:throttled], 5., @"Retry-After should be respected");
+
+    NSError *stalled = [self statusError:503 headers:@{@"Retry-After": @"3600"}];
+    XCTAssertLessThanOrEqual([policy delayBeforeAttempt:2 error:stalled], 30., @"Retry-After should be capped");
+}
+
+- (void)testPerformRetriesTransientFailures {
+    OMHTTPRetryPolicy *policy = [OMHTTPRetryPolicy policyForMethod:@"GET" options:@{
+        OMHTTPRetryAttempts: @3,
+        OMHTTPRetryDelay: @.01
+    }];
+
+    __block _Atomic int attempts = 0;
+    OMPromise *promise = [policy perform:^OMPromise *{
+        if (atomic_fetch_add(&attempts, 1) + 1 < 3) {
+            return [OMPromise promiseWithError:[self statusError:503 headers:nil]];
+        }
+        return [OMPromise promiseWithResult:@"ok"];
+    }];
+
+    XCTAssertEqualObjects([promise waitForResultWithin:1.], @"ok");
+    XCTAssertEqual(atomic_load(&attempts), 3);
+}
+
+- (void)testPerformGivesUp {
+    OMHTTPRetryPolicy *policy = [OMHTTPRetryPolicy policyForMethod:@"GET" options:@{
+        OMHTTPRetryAttempts: @2,
+        OMHTTPRetryDelay: @.01
+    }];
+
+    __block _Atomic int attempts = 0;
+    NSError *error = [self statusError:503 headers:nil];
+    OMPromise *promise = [policy perform:^OMPromise *{
+        atomic_fetch_add(&attempts, 1);
+        return [OMPromise promiseWithError:error];
+    }];
+
+    XCTAssertEqual([promise waitForErrorWithin:1.], error, @"The error of the last attempt should be passed on");
+    XCTAssertEqual(atomic_load(&attempts), 2);
+
+    atomic_store(&attempts, 0);
+    NSError *permanent = [self statusError:404 headers:nil];
+    promise = [policy perform:^OMPromise *{
+        atomic_fetch_add(&attempts, 1);
+        return [OMPromise promiseWithError:permanent];
+    }];
+
+    XCTAssertEqual([promise waitForErrorWithin:1.], permanent);
+    XCTAssertEqual(atomic_load(&attempts), 1, @"Permanent failures shouldn't be retried");
+}
+
+- (void)testCancelWhileWaiting {
+    OMHTTPRetryPolicy *policy = [OMHTTPRetryPolicy policyForMethod:@"GET" options:@{
+        OMHTTPRetryAttempts: @2,
+        OMHTTPRetryDelay: @.1
+    }];
+
+    __block _Atomic int attempts = 0;
+    OMPromise *promise = [policy perform:^OMPromise *{
+        atomic_fetch_add(&attempts, 1);
+        return [OMPromise promiseWithError:[self statusError:503 headers:nil]];
+    }];
+
+    [promise cancel];
+    WAIT_FOR(.3);
+
+    XCTAssertEqual(promise.error.code, OMPromisesCancelledError);
+    XCTAssertEqual(atomic_load(&attempts), 1, @"Cancelled promises shouldn't be attempted again");
+}
+
+#pragma mark - Helper
+
+- (NSError *)statusError:(NSUInteger)statusCode headers:(NSDictionary *)headers {
+    OMHTTPResponse *response = [[OMHTTPResponse alloc] initWithCode:statusCode headers:headers ?: @{} body:nil];
+
+    return [NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                               code:OMPromisesHTTPStatusError
+                           userInfo:@{OMHTTPResponseKey: response}];
+}
+
+- (NSError *)requestError:(NSInteger)code {
+    return [NSError errorWithDomain:OMPromisesHTTPErrorDomain
+                               code:OMPromisesHTTPRequestError
+                           userInfo:@{NSUnderlyingErrorKey: [NSError errorWithDomain:NSURLErrorDomain code:code userInfo:nil]}];
+}
+
+@end
@@ -0,0 +1,72 @@
+//
+// OMHTTPRouteTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMHTTPRoute.h"
+
+@interface OMHTTPRouteTests : XCTestCase
+@end
+
+@implementation OMHTTPRouteTests
+
+- (void)testParse {
+    OMHTTPRoute *route = [[OMHTTPRoute alloc] initWithTemplate:@" http://example.com/{user_id}/items/{id}{{x-y}} "];
+
+    XCTAssertEqualObjects(route.parameterNames, (@[@"user_id", @"id"]));
+    XCTAssertEqualObjects([route URLStringWithParameters:nil remainingParameters:NULL],
+                          @"http://example.com//items/{{x-y}}", @"Placeholders without value should be removed");
+}
+
+- (void)testExpand {
+    OMHTTPRoute *route = [[OMHTTPRoute alloc] initWithTemplate:@"http://example.com/{user}/items/{id}"];
+    NSDictionary *parameters = @{@"user": @"a b/c", @"id": @42, @"q": @"x"};
+    NSDictionary *remaining = nil;
+
+    NSString *urlString = [route URLStringWithParameters:parameters remainingParameters:&remaining];
+
+    XCTAssertEqualObjects(urlString, @"http://example.com/a%20b%2Fc/items/42", @"Values should be escaped");
+    XCTAssertEqualObjects(remaining, @{@"q": @"x"}, @"Used parameters should be removed");
+    XCTAssertEqual(parameters.count, (NSUInteger)3, @"The supplied parameters shouldn't be modified");
+}
+
+- (void)testUnusedParameters {
+    OMHTTPRoute *route = [[OMHTTPRoute alloc] initWithTemplate:@"http://example.com/{id}"];
+    NSDictionary *parameters = @{@"q": @"x"};
+    NSDictionary *remaining = nil;
+
+    [route URLWithParameters:parameters remainingParameters:&remaining];
+
+    XCTAssertEqual(remaining, parameters, @"Parameters shouldn't be copied if none got used");
+}
+
+- (void)testSharedRoutes {
+    NSString *urlTemplate = @"http://example.com/{id}";
+
+    XCTAssertEqual([OMHTTPRoute routeWithTemplate:urlTemplate], [OMHTTPRoute routeWithTemplate:urlTemplate],
+                   @"Recently used templates should be parsed only once");
+}
+
+@end
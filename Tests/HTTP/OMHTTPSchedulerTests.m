@@ -0,0 +1,123 @@
+//
+// OMHTTPSchedulerTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMHTTPScheduler.h"
+
+@interface OMHTTPSchedulerTests : XCTestCase
+
+@property(nonatomic) NSURLSession *session;
+@property(nonatomic) NSMutableArray *tasks;
+
+@end
+
+@implementation OMHTTPSchedulerTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration ephemeralSessionConfiguration]];
+    self.tasks = [NSMutableArray array];
+}
+
+- (void)tearDown {
+    for (NSURLSessionTask *task in self.tasks) {
+        [task cancel];
+    }
+    [self.session invalidateAndCancel];
+
+    [super tearDown];
+}
+
+- (void)testLimits {
+    OMHTTPScheduler *scheduler = [OMHTTPScheduler new];
+    scheduler.maximumConcurrentTasks = 3;
+    scheduler.maximumConcurrentTasksPerHost = 2;
+
+    NSURLSessionTask *a1 = [self enqueue:@"a" priority:OMHTTPPriorityNormal at:scheduler];
+    NSURLSessionTask *a2 = [self enqueue:@"a" priority:OMHTTPPriorityNormal at:scheduler];
+    NSURLSessionTask *a3 = [self enqueue:@"a" priority:OMHTTPPriorityNormal at:scheduler];
+    NSURLSessionTask *b1 = [self enqueue:@"b" priority:OMHTTPPriorityNormal at:scheduler];
+    NSURLSessionTask *b2 = [self enqueue:@"b" priority:OMHTTPPriorityNormal at:scheduler];
+
+    XCTAssertNotEqual(a1.state, NSURLSessionTaskStateSuspended);
+    XCTAssertNotEqual(a2.state, NSURLSessionTaskStateSuspended);
+    XCTAssertEqual(a3.state, NSURLSessionTaskStateSuspended, @"Host limit should be respected");
+    XCTAssertNotEqual(b1.state, NSURLSessionTaskStateSuspended, @"Other hosts shouldn't be blocked");
+    XCTAssertEqual(b2.state, NSURLSessionTaskStateSuspended, @"Global limit should be respected");
+
+    [scheduler taskCompleted:a1];
+    XCTAssertNotEqual(a3.state, NSURLSessionTaskStateSuspended, @"Oldest waiting task should start first");
+    XCTAssertEqual(b2.state, NSURLSessionTaskStateSuspended);
+}
+
+- (void)testPriorities {
+    OMHTTPScheduler *scheduler = [OMHTTPScheduler new];
+    scheduler.maximumConcurrentTasks = 1;
+
+    NSURLSessionTask *running = [self enqueue:@"a" priority:OMHTTPPriorityLow at:scheduler];
+    NSURLSessionTask *low = [self enqueue:@"a" priority:OMHTTPPriorityLow at:scheduler];
+    NSURLSessionTask *normal = [self enqueue:@"a" priority:OMHTTPPriorityNormal at:scheduler];
+    NSURLSessionTask *high = [self enqueue:@"a" priority:OMHTTPPriorityHigh at:scheduler];
+
+    [scheduler taskCompleted:running];
+    XCTAssertNotEqual(high.state, NSURLSessionTaskStateSuspended, @"Higher priority should start first");
+    XCTAssertEqual(normal.state, NSURLSessionTaskStateSuspended);
+
+    [scheduler taskCompleted:high];
+    XCTAssertNotEqual(normal.state, NSURLSessionTaskStateSuspended);
+    XCTAssertEqual(low.state, NSURLSessionTaskStateSuspended);
+}
+
+- (void)testDequeue {
+    OMHTTPScheduler *scheduler = [OMHTTPScheduler new];
+    scheduler.maximumConcurrentTasks = 1;
+
+    NSURLSessionTask *running = [self enqueue:@"a" priority:OMHTTPPriorityNormal at:scheduler];
+    NSURLSessionTask *queued = [self enqueue:@"a" priority:OMHTTPPriorityNormal at:scheduler];
+    NSURLSessionTask *next = [self enqueue:@"a" priority:OMHTTPPriorityNormal at:scheduler];
+
+    XCTAssertFalse([scheduler dequeueTask:running], @"Running tasks aren't queued anymore");
+    XCTAssertTrue([scheduler dequeueTask:queued]);
+
+    [scheduler taskCompleted:running];
+    XCTAssertEqual(queued.state, NSURLSessionTaskStateSuspended, @"Dequeued tasks should never be resumed");
+    XCTAssertNotEqual(next.state, NSURLSessionTaskStateSuspended);
+}
+
+#pragma mark - Helper
+
+- (NSURLSessionTask *)enqueue:(NSString *)host priority:(OMHTTPPriority)priority at:(OMHTTPScheduler *)scheduler {
+    NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"http://%@.invalid/%@", host, @(self.tasks.count)]];
+    NSURLSessionTask *task = [self.session dataTaskWithURL:url];
+
+    [self.tasks addObject:task];
+    [scheduler enqueueTask:task priority:priority];
+
+    return task;
+}
+
+@end
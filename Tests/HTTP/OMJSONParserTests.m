@@ -0,0 +1,88 @@
+//
+// OMJSONParserTests.m
+// OMPromisesTests
+//
+// Copyright (C) 2016 Oliver Mader
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "OMTests.h"
+
+#import "OMJSONParser.h"
+
+@interface OMJSONParserTests : XCTestCase
+@end
+
+@implementation OMJSONParserTests
+
+- (void)testMatchesNSJSONSerialization {
+    NSString *json = @"{\"a\": [1, -2.5, 3e2, true, false, null], \"b\": {\"c\": \"d\\\"\\n\\u00e4\\ud83d\\ude00\"}, "
+                     @"\"e\": [], \"f\": {}, \"g\": 123456789012, \"h\": \"ü\"}";
+    NSData *data = [json dataUsingEncoding:NSUTF8StringEncoding];
+    id expected = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+
+    XCTAssertNotNil(expected);
+
+    // split at every possible offset, such that each token spans two chunks once
+    for (NSUInteger split = 0; split <= data.length; ++split) {
+        OMJSONParser *parser = [OMJSONParser new];
+        NSError *error = nil;
+
+        XCTAssertTrue([parser parse:[data subdataWithRange:NSMakeRange(0, split)] error:&error]);
+        XCTAssertTrue([parser parse:[data subdataWithRange:NSMakeRange(split, data.length - split)] error:&error]);
+        XCTAssertEqualObjects([parser finish:&error], expected, @"Split at %@ should yield the same objects", @(split));
+        XCTAssertNil(error);
+    }
+}
+
+- (void)testByteByByte {
+    NSData *data = [@"[\"x\", 42]" dataUsingEncoding:NSUTF8StringEncoding];
+    OMJSONParser *parser = [OMJSONParser new];
+
+    for (NSUInteger i = 0; i < data.length; ++i) {
+        XCTAssertTrue([parser parse:[data subdataWithRange:NSMakeRange(i, 1)] error:NULL]);
+    }
+
+    XCTAssertEqualObjects([parser finish:NULL], (@[@"x", @42]));
+}
+
+- (void)testFragments {
+    OMJSONParser *parser = [OMJSONParser new];
+    [parser parse:[@"12" dataUsingEncoding:NSUTF8StringEncoding] error:NULL];
+    [parser parse:[@"34" dataUsingEncoding:NSUTF8StringEncoding] error:NULL];
+
+    XCTAssertEqualObjects([parser finish:NULL], @1234, @"Numbers at the end of data should be terminated");
+}
+
+- (void)testMalformed {
+    NSArray *inputs = @[@"[1,]", @"{\"a\" 1}", @"[1 2]", @"tru", @"\"\\ud83d\"", @"[1]]", @"\"\\x\"", @"-", @"{\"a\":1"];
+
+    for (NSString *input in inputs) {
+        OMJSONParser *parser = [OMJSONParser new];
+        NSError *error = nil;
+
+        [parser parse:[input dataUsingEncoding:NSUTF8StringEncoding] error:&error];
+        XCTAssertNil([parser finish:&error], @"%@ should be rejected", input);
+        XCTAssertEqualObjects(error.domain, OMPromisesHTTPErrorDomain);
+        XCTAssertEqual(error.code, OMPromisesHTTPSerializationError);
+    }
+}
+
+@end
@@ -24,6 +24,7 @@
 //
 
 #import <XCTest/XCTest.h>
+#import <stdatomic.h>
 
 #import "OMPromises.h"
 